@@ -0,0 +1,150 @@
+//--------------------------------------------------------------------------------
+// Scaling benchmark for the host build of ShowProc.
+//
+// Runs ShowProc ALL in each output format against synthetic systems of 10,
+// 1 000 and 100 000 tasks plus as many Shell/CLI processes, with the output
+// discarded. For each run it reports the time per row, the Write() calls and
+// the time spent between Forbid() and Permit(). The API line is the same
+// snapshot taken through SP_TakeSnapshot(), without starting ShowProc.
+//--------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "amiga_host.h"
+#include <proto/showproc.h>
+#include "ShowProc.h"
+
+#define BENCH_MIN_SECS		0.5		// Each case is repeated for at least this long
+#define BENCH_MIN_RUNS		3		// ...and at least this many times
+
+typedef struct BenchFormat {
+	const char*		name;					// Shown in the report
+	const char*		arg;					// Argument selecting the format
+} BenchFormat;
+
+static const BenchFormat formats[] = {
+	{ "FULL",		"FULL"				},
+	{ "TCB",		"TCB"				},
+	{ "SHORT",		"SHORT"				},
+	{ "COMMAND",	"COMMAND=nomatch#?"	},	// Never matches, so every CLI is tried
+};
+
+static const ULONG sizes[] = { 10, 1000, 100000 };
+
+#define COUNT(array)		(sizeof(array) / sizeof((array)[0]))
+
+
+//--------------------------------------------------------------------------------
+//	Runs one benchmark case and prints its line of the report.
+//--------------------------------------------------------------------------------
+static int RunCase(ULONG size, const BenchFormat* format)
+{
+	const char*	argv[] = { "ShowProc", "ALL", format->arg };
+	ULONG	cliRows;
+	ULONG	rows;
+	ULONG	runs = 0;
+	double	start;
+	double	secs;
+	int		rc;
+
+	// COMMAND only searches the Shell/CLI processes, the rest show both tables
+	cliRows = size + 1;
+	rows = format->arg == formats[3].arg ? cliRows : cliRows + size * 2 + 1;
+
+	HostArgs(COUNT(argv), argv);
+	HostResetStats();
+
+	start = HostSeconds();
+	do {
+		rc = ShowProcMain();
+		runs++;
+		secs = HostSeconds() - start;
+	} while (secs < BENCH_MIN_SECS || runs < BENCH_MIN_RUNS);
+
+	printf("%7lu %-8s %8lu %10.1f %10.3f %8lu %10lu %10.1f %10.1f %4d\n",
+		   size, format->name, rows,
+		   secs / runs / rows * 1e9,
+		   secs / runs * 1e3,
+		   hostStats.writeCalls / runs,
+		   hostStats.writeBytes / runs,
+		   hostStats.forbidSecs / runs * 1e6,
+		   hostStats.forbidMaxSecs * 1e6,
+		   rc);
+
+	return rc;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Times SP_TakeSnapshot() of both tables into a buffer that fits them, called
+//	through showproc.library as another program would, and prints its line of
+//	the report. Bytes is the size of the snapshot.
+//--------------------------------------------------------------------------------
+static int RunApiCase(ULONG size)
+{
+	void*	buffer;
+	LONG	needed;
+	ULONG	rows;
+	ULONG	runs = 0;
+	double	start;
+	double	secs;
+	int		rc = RETURN_OK;
+
+	if ((ShowProcBase = OpenLibrary(SHOWPROC_NAME, SHOWPROC_VERSION)) == NULL)
+		return RETURN_FAIL;
+
+	needed = SP_TakeSnapshot(NULL, 0, SP_SYSTEM | SP_CLI);
+	if (needed < 0 || (buffer = malloc(needed)) == NULL) {
+		CloseLibrary(ShowProcBase);
+		return RETURN_FAIL;
+	}
+
+	rows = (size + 1) + size * 2 + 1;
+	HostResetStats();
+
+	start = HostSeconds();
+	do {
+		if (SP_TakeSnapshot(buffer, needed, SP_SYSTEM | SP_CLI) != needed)
+			rc = RETURN_FAIL;
+		runs++;
+		secs = HostSeconds() - start;
+	} while (secs < BENCH_MIN_SECS || runs < BENCH_MIN_RUNS);
+
+	printf("%7lu %-8s %8lu %10.1f %10.3f %8lu %10ld %10.1f %10.1f %4d\n",
+		   size, "API", rows,
+		   secs / runs / rows * 1e9,
+		   secs / runs * 1e3,
+		   hostStats.writeCalls / runs,
+		   (long)needed,
+		   hostStats.forbidSecs / runs * 1e6,
+		   hostStats.forbidMaxSecs * 1e6,
+		   rc);
+
+	free(buffer);
+	CloseLibrary(ShowProcBase);
+	ShowProcBase = NULL;
+	return rc;
+}
+
+
+int main(void)
+{
+	size_t	i;
+	size_t	j;
+
+	printf("%7s %-8s %8s %10s %10s %8s %10s %10s %10s %4s\n",
+		   "Tasks", "Format", "Rows", "ns/row", "ms/run", "Writes", "Bytes",
+		   "Forbid us", "Max us", "RC");
+
+	HostQuiet(TRUE);
+
+	for (i = 0; i < COUNT(sizes); i++) {
+		HostSetup(sizes[i], sizes[i]);
+		for (j = 0; j < COUNT(formats); j++)
+			RunCase(sizes[i], &formats[j]);
+		RunApiCase(sizes[i]);
+	}
+
+	HostTeardown();
+	return 0;
+}
@@ -0,0 +1,1766 @@
+//--------------------------------------------------------------------------------
+// Synthetic exec/dos layer for the host build of ShowProc.
+//
+// Builds a fake system of tasks, processes and Shell/CLI processes, or one from
+// the Linux processes in /proc, and provides just enough of exec.library,
+// dos.library and timer.device for ShowProc.c to run against it. Output calls
+// and Forbid() hold times are counted in hostStats.
+//--------------------------------------------------------------------------------
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <time.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "amiga_host.h"
+#include <libraries/showproc.h>
+#include "ShowProc.h"
+
+//--------------------------------------------------------------------------------
+// Constants
+//--------------------------------------------------------------------------------
+#define HOST_LIB_VERSION	40		// Version reported for exec & dos
+#define HOST_STACK_SIZE		4096	// Size of the synthetic stacks
+#define HOST_STACKS			16		// Distinct stacks shared by all synthetic tasks
+#define HOST_NAME_SIZE		24		// Name buffer size of each synthetic task
+#define HOST_TIMER_SIG		16		// Signal bit of timer reply ports
+#define HOST_FREE_SIG		20		// Signal bit handed out by AllocSignal()
+#define HOST_SOFTINTS		50		// Sampler interrupts run per Wait()
+#define HOST_MAX_ARGS		64		// Most template items ReadArgs() can handle
+#define HOST_PAT_DEPTH		1000	// Deepest pattern recursion before giving up
+#define HOST_PROC_BUF_SIZE	8192	// Read buffer for /proc/<pid>/stat & status
+#define HOST_PROC_STACK_MAX	(8UL << 20)	// Stack size shown if the limit is higher
+#define HOST_PROC_KTHREAD	0x00200000	// PF_KTHREAD in the /proc/<pid>/stat flags
+#define HOST_PROC_RT_PRI	20		// Priority of real-time processes, plus rt_priority
+#define HOST_EPOCH_1978		252460800	// Unix time of the DateStamp() epoch
+#define HOST_CHIP_FREE		1536000	// AvailMem() of the synthetic system
+#define HOST_FAST_FREE		48000000
+#define HOST_FAST_CHUNKS	5000	// Most small free chunks of fast memory
+#define HOST_CLI_SLOTS		64		// Shell/CLI numbers in each CliProcList
+#define HOST_FLASH_DIV		4		// One short-lived task per this many tasks, each interval
+#define HOST_QUEUE_MSGS		3		// Most messages queued at a synthetic process's own port
+
+//--------------------------------------------------------------------------------
+// Library bases & state
+//--------------------------------------------------------------------------------
+static struct ExecBase	execBase = { { { 0 }, 0, 0, 0, 0, HOST_LIB_VERSION } };
+static struct RootNode	rootNode;
+static struct DosLibrary dosBase = { { { 0 }, 0, 0, 0, 0, HOST_LIB_VERSION }, &rootNode };
+
+struct ExecBase*	SysBase = &execBase;
+struct Library*		DOSBase = &dosBase.dl_lib;
+
+HostStats			hostStats;
+
+// Segment of a synthetic seglist: the size longword & the BPTR to the next one
+typedef struct HostSeg {
+	ULONG			size;
+	BPTR			next;
+} HostSeg;
+
+// One synthetic task. Processes & Shell/CLI processes use the whole record.
+typedef struct HostTask {
+	struct Process	proc;
+	struct CommandLineInterface cli;
+	char			name[HOST_NAME_SIZE];
+	char			command[HOST_NAME_SIZE + 1];	// BSTR, so must be longword aligned
+	long			globVec;
+	struct MemList	memList;				// Only entry of tc_MemEntry
+	HostSeg			segs[2];				// Seglist of the loaded command
+	struct Message	msgs[HOST_QUEUE_MSGS];	// Queued at pr_MsgPort
+	BOOL			hasTty;					// Linux process has a controlling tty
+	BOOL			foreground;				// ...and is in its foreground process group
+} HostTask;
+
+static HostTask*		hostTasks;				// All synthetic tasks, ours first
+static ULONG			hostTaskCount;
+static ULONG			hostTaskAlloc;			// Number of tasks hostTasks can hold
+static struct Process**	cliTable;				// Shell/CLI processes by number
+static ULONG			cliMax;
+static struct CliProcList* cliLists;			// rn_CliList, HOST_CLI_SLOTS numbers each
+static ULONG*			stacks;					// HOST_STACKS stacks, back to back
+
+static const char*		procRoot;				// /proc directory, or NULL if synthetic
+static ULONG			procStackSize;			// Stack size shown for Linux processes
+static char				procBuf[HOST_PROC_BUF_SIZE];	// Reused for every /proc file
+
+static int				hostArgc;
+static const char**		hostArgv;
+static LONG				ioErr;
+static BOOL				quiet;
+
+static ULONG			waitsLeft;				// Wait() calls before Ctrl-C is pressed
+static int				thenArgc;				// Command run when waitsLeft runs out
+static const char**		thenArgv;
+static int				thenRc = -1;			// Its return code, or -1 if it hasn't run
+static ULONG			churns;					// Synthetic tasks changed so far
+static HostTask			flashTask;				// Added & removed again each interval
+static ULONG			sigsPending;
+static struct IORequest* timerPending;			// Request waiting on a signal port
+static struct IORequest* softIntPending;		// Request replying to a PA_SOFTINT port
+static struct Node*		softIntNext;			// Next task to be "interrupted"
+
+// Synthetic libraries, devices & resources
+static const struct {
+	UBYTE			type;					// NT_LIBRARY, NT_DEVICE or NT_RESOURCE
+	const char*		name;
+	UWORD			version;
+	UWORD			revision;
+	UWORD			openCnt;
+} hostLibDefs[] = {
+	{ NT_LIBRARY,	"exec.library",			40, 10, 22 },
+	{ NT_LIBRARY,	"dos.library",			40,  3, 18 },
+	{ NT_LIBRARY,	"graphics.library",		40, 24, 11 },
+	{ NT_LIBRARY,	"intuition.library",	40, 85,  9 },
+	{ NT_LIBRARY,	"utility.library",		40,  1, 14 },
+	{ NT_DEVICE,	"timer.device",			40,  1,  6 },
+	{ NT_DEVICE,	"input.device",			40,  1,  3 },
+	{ NT_DEVICE,	"trackdisk.device",		40,  1,  1 },
+	{ NT_RESOURCE,	"ciaa.resource",		39,  1,  0 },
+	{ NT_RESOURCE,	"ciab.resource",		39,  1,  0 },
+	{ NT_RESOURCE,	"potgo.resource",		37,  4,  0 }
+};
+
+#define HOST_LIBS			(sizeof(hostLibDefs) / sizeof(hostLibDefs[0]))
+#define HOST_PORTS			4		// Synthetic public ports, one per PA_* action & a busy one
+#define HOST_MSGS			2		// Messages queued at the busy port
+
+static struct Library	hostLibs[HOST_LIBS];
+static struct MsgPort	hostPorts[HOST_PORTS];
+static struct Message	hostMsgs[HOST_MSGS];
+static struct MemHeader	hostMem[2];				// Chip & fast memory
+static struct MemChunk*	hostChunks;				// Free chunks of both
+
+static int				forbidNest;
+static double			forbidStart;
+
+
+//--------------------------------------------------------------------------------
+//	Returns a monotonic time in seconds.
+//--------------------------------------------------------------------------------
+double HostSeconds(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Adds a node to the end of a list.
+//--------------------------------------------------------------------------------
+static void AddTail(struct List* list, struct Node* node)
+{
+	node->ln_Succ = (struct Node*)&list->lh_Tail;
+	node->ln_Pred = list->lh_TailPred;
+	list->lh_TailPred->ln_Succ = node;
+	list->lh_TailPred = node;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Fills in the task part of a synthetic task. Each stack has been written to
+//	down to a different depth, for HIGHWATER.
+//--------------------------------------------------------------------------------
+static void SetupTask(HostTask* ht, UBYTE type, BYTE pri, UBYTE state, ULONG index)
+{
+	struct Task* task = &ht->proc.pr_Task;
+	char* 	stack = (char*)stacks + (index % HOST_STACKS) * HOST_STACK_SIZE;
+	ULONG	i;
+
+	task->tc_Node.ln_Type = type;
+	task->tc_Node.ln_Pri = pri;
+	task->tc_Node.ln_Name = ht->name;
+	task->tc_State = state;
+	task->tc_SPLower = stack;
+	task->tc_SPUpper = stack + HOST_STACK_SIZE;
+	task->tc_SPReg = stack + HOST_STACK_SIZE - 200 - (index % 7) * 40;
+
+	// Waiting tasks wait for the signal of their public port, if they have
+	// one, & processes for their own port too, which some have messages at
+	task->tc_SigWait = state == TS_WAIT ? (1UL << HOST_FREE_SIG) | SIGF_DOS : 0;
+	ht->proc.pr_MsgPort.mp_SigBit = SIGB_DOS;
+	ht->proc.pr_MsgPort.mp_SigTask = task;
+	NewList(&ht->proc.pr_MsgPort.mp_MsgList);
+	for (i = 0; type == NT_PROCESS && i < index % (HOST_QUEUE_MSGS + 1); i++) {
+		ht->msgs[i].mn_Node.ln_Type = NT_MESSAGE;
+		AddTail(&ht->proc.pr_MsgPort.mp_MsgList, &ht->msgs[i].mn_Node);
+	}
+
+	ht->memList.ml_NumEntries = 1;
+	ht->memList.ml_ME[0].me_Length = HOST_STACK_SIZE + (index % 5) * 1024;
+	NewList(&task->tc_MemEntry);
+	AddTail(&task->tc_MemEntry, &ht->memList.ml_Node);
+}
+
+
+//--------------------------------------------------------------------------------
+//	Attaches a Shell/CLI to a synthetic process. An empty command name means no
+//	command is loaded.
+//--------------------------------------------------------------------------------
+static void SetupCli(HostTask* ht, ULONG num, const char* command)
+{
+	size_t	len = strlen(command);
+
+	ht->command[0] = (char)len;
+	memmove(&ht->command[1], command, len);
+
+	ht->cli.cli_CommandName = MKBADDR(ht->command);
+	if (len > 0) {
+		ht->segs[0].size = 2048 + num * 64;
+		ht->segs[0].next = MKBADDR(&ht->segs[1].next);
+		ht->segs[1].size = 512;
+		ht->cli.cli_Module = MKBADDR(&ht->segs[0].next);
+	}
+	ht->cli.cli_FailLevel = 10;
+	ht->cli.cli_Background = (num % 3 == 0);
+	ht->cli.cli_DefaultStack = HOST_STACK_SIZE / 4;
+	ht->globVec = 150;
+
+	ht->proc.pr_CLI = MKBADDR(&ht->cli);
+	ht->proc.pr_TaskNum = num;
+	ht->proc.pr_MsgPort.mp_SigTask = &ht->proc.pr_Task;
+	ht->proc.pr_GlobVec = &ht->globVec;
+
+	cliTable[num] = &ht->proc;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Fills in a synthetic public port & adds it to the port list.
+//--------------------------------------------------------------------------------
+static void SetupPort(struct MsgPort* port, const char* name, UBYTE action, struct Task* task)
+{
+	port->mp_Node.ln_Type = NT_MSGPORT;
+	port->mp_Node.ln_Name = (char*)name;
+	port->mp_Flags = action;
+	port->mp_SigBit = HOST_FREE_SIG;
+	port->mp_SigTask = task;
+	NewList(&port->mp_MsgList);
+	AddTail(&execBase.PortList, &port->mp_Node);
+}
+
+
+//--------------------------------------------------------------------------------
+//	Builds the library, device & resource lists, and a public port for each
+//	PA_* action, plus one with messages waiting. Ports are signalled by task.
+//--------------------------------------------------------------------------------
+static void SetupExecLists(struct Task* task)
+{
+	struct 	List* list;
+	ULONG	i;
+
+	for (i = 0; i < HOST_LIBS; i++) {
+		hostLibs[i].lib_Node.ln_Type = hostLibDefs[i].type;
+		hostLibs[i].lib_Node.ln_Name = (char*)hostLibDefs[i].name;
+		hostLibs[i].lib_Version = hostLibDefs[i].version;
+		hostLibs[i].lib_Revision = hostLibDefs[i].revision;
+		hostLibs[i].lib_OpenCnt = hostLibDefs[i].openCnt;
+		list = hostLibDefs[i].type == NT_LIBRARY ? &execBase.LibList :
+			   hostLibDefs[i].type == NT_DEVICE ? &execBase.DeviceList : &execBase.ResourceList;
+		AddTail(list, &hostLibs[i].lib_Node);
+	}
+
+	SetupPort(&hostPorts[0], "REXX", PA_SIGNAL, task);
+	SetupPort(&hostPorts[1], "ConClip.rendezvous", PA_SIGNAL, task);
+	SetupPort(&hostPorts[2], "keyboard.softint", PA_SOFTINT, NULL);
+	SetupPort(&hostPorts[3], "idle.port", PA_IGNORE, NULL);
+	for (i = 0; i < HOST_MSGS; i++) {
+		hostMsgs[i].mn_Node.ln_Type = NT_MESSAGE;
+		AddTail(&hostPorts[0].mp_MsgList, &hostMsgs[i].mn_Node);
+	}
+}
+
+
+//--------------------------------------------------------------------------------
+//	Adds a memory region whose free memory is one chunk of half of it, plus
+//	count chunks of 8 bytes to 16K, with the rest in one more chunk.
+//--------------------------------------------------------------------------------
+static void SetupMemHeader(struct MemHeader* mh, const char* name, UWORD attributes,
+						   ULONG lower, ULONG free, struct MemChunk* chunks, ULONG count)
+{
+	ULONG	left = free - free / 2;
+	ULONG	i;
+
+	mh->mh_Node.ln_Type = NT_MEMORY;
+	mh->mh_Node.ln_Name = (char*)name;
+	mh->mh_Attributes = attributes;
+	mh->mh_Lower = (APTR)(size_t)lower;
+	mh->mh_Upper = (APTR)(size_t)(lower + free * 2);
+	mh->mh_Free = free;
+	mh->mh_First = &chunks[0];
+
+	chunks[0].mc_Bytes = free / 2;
+	for (i = 1; i <= count; i++) {
+		chunks[i].mc_Bytes = 8UL << (i % 12);
+		left -= chunks[i].mc_Bytes;
+	}
+	chunks[count + 1].mc_Bytes = left;
+
+	for (i = 0; i < count + 1; i++)
+		chunks[i].mc_Next = &chunks[i + 1];
+	chunks[count + 1].mc_Next = NULL;
+
+	AddTail(&execBase.MemList, &mh->mh_Node);
+}
+
+
+//--------------------------------------------------------------------------------
+//	Builds the memory list: chip memory with a few small free chunks, & fast
+//	memory with one per task, so MEMMAP has thousands to walk on a big system.
+//--------------------------------------------------------------------------------
+static void SetupMemList(ULONG tasks)
+{
+	ULONG	chip = 20;
+	ULONG	fast = 20 + (tasks < HOST_FAST_CHUNKS ? tasks : HOST_FAST_CHUNKS);
+
+	NewList(&execBase.MemList);
+
+	hostChunks = calloc(chip + fast + 4, sizeof(struct MemChunk));
+	if (hostChunks == NULL) {
+		fprintf(stderr, "Not enough memory for the free chunks\n");
+		exit(RETURN_FAIL);
+	}
+
+	SetupMemHeader(&hostMem[0], "chip memory", MEMF_CHIP | MEMF_PUBLIC, 0x400,
+				   HOST_CHIP_FREE, hostChunks, chip);
+	SetupMemHeader(&hostMem[1], "expansion memory", MEMF_FAST | MEMF_PUBLIC, 0x07000000,
+				   HOST_FAST_FREE, hostChunks + chip + 2, fast);
+}
+
+
+//--------------------------------------------------------------------------------
+//	Builds dos.library's rn_CliList from the Shell/CLI table, HOST_CLI_SLOTS
+//	numbers to each CliProcList like the ones dos.library adds as it runs out.
+//	The slots past the last process are left empty.
+//--------------------------------------------------------------------------------
+static void SetupCliList(void)
+{
+	struct 	CliProcList* list;
+	struct 	MsgPort** ports;
+	ULONG	count = cliMax / HOST_CLI_SLOTS + 1;
+	ULONG	i, j;
+	ULONG	num;
+
+	rootNode.rn_CliList.mlh_Head = (struct MinNode*)&rootNode.rn_CliList.mlh_Tail;
+	rootNode.rn_CliList.mlh_Tail = NULL;
+	rootNode.rn_CliList.mlh_TailPred = (struct MinNode*)&rootNode.rn_CliList.mlh_Head;
+
+	cliLists = calloc(count, sizeof(struct CliProcList) + (HOST_CLI_SLOTS + 1) * sizeof(struct MsgPort*));
+	if (cliLists == NULL) {
+		fprintf(stderr, "Not enough memory for %lu Shell/CLI processes\n", cliMax);
+		exit(RETURN_FAIL);
+	}
+
+	ports = (struct MsgPort**)(cliLists + count);
+	for (i = 0; i < count; i++, ports += HOST_CLI_SLOTS + 1) {
+		list = &cliLists[i];
+		list->cpl_First = i * HOST_CLI_SLOTS + 1;
+		list->cpl_Array = ports;
+		ports[0] = (struct MsgPort*)(size_t)HOST_CLI_SLOTS;
+		for (j = 1; j <= HOST_CLI_SLOTS; j++) {
+			num = list->cpl_First + j - 1;
+			if (num < cliMax && cliTable[num] != NULL)
+				ports[j] = &cliTable[num]->pr_MsgPort;
+		}
+
+		list->cpl_Node.mln_Succ = (struct MinNode*)&rootNode.rn_CliList.mlh_Tail;
+		list->cpl_Node.mln_Pred = rootNode.rn_CliList.mlh_TailPred;
+		rootNode.rn_CliList.mlh_TailPred->mln_Succ = &list->cpl_Node;
+		rootNode.rn_CliList.mlh_TailPred = &list->cpl_Node;
+	}
+
+	rootNode.rn_TaskArray = MKBADDR(cliLists[0].cpl_Array);
+}
+
+
+//--------------------------------------------------------------------------------
+//	Builds a system with our own Shell/CLI process (number 1), tasks other tasks
+//	& processes, and clis more Shell/CLI processes. Every third task is a plain
+//	task, every fifth is ready to run, and every fourth Shell/CLI process has no
+//	command loaded.
+//--------------------------------------------------------------------------------
+void HostSetup(ULONG tasks, ULONG clis)
+{
+	HostTask* ht;
+	ULONG	i;
+	ULONG	depth;
+
+	HostTeardown();
+
+	NewList(&execBase.TaskReady);
+	NewList(&execBase.TaskWait);
+	NewList(&execBase.LibList);
+	NewList(&execBase.DeviceList);
+	NewList(&execBase.ResourceList);
+	NewList(&execBase.PortList);
+
+	hostTaskCount = 1 + tasks + clis;
+	hostTasks = calloc(hostTaskCount, sizeof(HostTask));
+	cliMax = clis + 2;								// Last entry is always NULL
+	cliTable = calloc(cliMax + 1, sizeof(struct Process*));
+	stacks = calloc(HOST_STACKS, HOST_STACK_SIZE);
+	if (hostTasks == NULL || cliTable == NULL || stacks == NULL) {
+		fprintf(stderr, "Not enough memory for %lu tasks\n", hostTaskCount);
+		exit(RETURN_FAIL);
+	}
+
+	// Unused stack is zero, the rest has been written to
+	for (i = 0; i < HOST_STACKS; i++) {
+		depth = 256 + i * (HOST_STACK_SIZE - 512) / HOST_STACKS;
+		memset((char*)stacks + (i + 1) * HOST_STACK_SIZE - depth, 0xA5, depth);
+	}
+
+	// Our own process is running, so it isn't in either list
+	ht = &hostTasks[0];
+	strcpy(ht->name, "ShowProc");
+	SetupTask(ht, NT_PROCESS, 0, TS_RUN, 0);
+	SetupCli(ht, 1, "ShowProc");
+	execBase.ThisTask = &ht->proc.pr_Task;
+
+	for (i = 0; i < tasks; i++) {
+		ht = &hostTasks[1 + i];
+		sprintf(ht->name, "%s.%lu", i % 3 == 0 ? "task" : "proc", i);
+		SetupTask(ht, i % 3 == 0 ? NT_TASK : NT_PROCESS, (BYTE)(i % 7) - 3,
+				  i % 5 == 0 ? TS_READY : TS_WAIT, i + 1);
+		AddTail(i % 5 == 0 ? &execBase.TaskReady : &execBase.TaskWait,
+				&ht->proc.pr_Task.tc_Node);
+	}
+
+	for (i = 0; i < clis; i++) {
+		ht = &hostTasks[1 + tasks + i];
+		strcpy(ht->name, "Shell Process");
+		SetupTask(ht, NT_PROCESS, 0, TS_WAIT, tasks + i + 1);
+		sprintf(ht->command + 1, "C:Cmd%lu", i);		// Only used for the name below
+		SetupCli(ht, i + 2, i % 4 == 0 ? "" : ht->command + 1);
+		AddTail(&execBase.TaskWait, &ht->proc.pr_Task.tc_Node);
+	}
+
+	SetupExecLists(&hostTasks[tasks > 1 ? 2 : 0].proc.pr_Task);
+	SetupMemList(tasks);
+	SetupCliList();
+
+	softIntNext = NULL;
+	waitsLeft = 1;
+	HostResetStats();
+}
+
+
+//--------------------------------------------------------------------------------
+//	Frees the synthetic system.
+//--------------------------------------------------------------------------------
+void HostTeardown(void)
+{
+	free(hostTasks);
+	free(cliTable);
+	free(cliLists);
+	free(stacks);
+	free(hostChunks);
+	hostTasks = NULL;
+	cliTable = NULL;
+	cliLists = NULL;
+	stacks = NULL;
+	hostChunks = NULL;
+	hostTaskCount = 0;
+	hostTaskAlloc = 0;
+	cliMax = 0;
+	procRoot = NULL;
+}
+
+
+//--------------------------------------------------------------------------------
+// Linux /proc backend
+//
+// Each process in /proc becomes a task: kernel threads are plain tasks and the
+// rest are processes. The priority is the negated nice value (or above 20 for
+// real-time processes), and the state maps R to Ready (Run for ourselves), T to
+// Excpt, Z & X to Remvd and anything else to Wait. Processes with a controlling
+// tty are Shell/CLI processes, numbered in /proc order after our own, with the
+// comm name as their command name.
+//
+// The stack used is VmStk, and the stack size is our own stack limit. Every
+// task's stack points into one buffer: the stack limit's worth of zeroes, then
+// the same again of "used" stack. Starting VmStk bytes in, the bounds cover
+// the stack limit, and HIGHWATER finds VmStk as the peak, as Linux never
+// shrinks a stack.
+//--------------------------------------------------------------------------------
+
+//--------------------------------------------------------------------------------
+//	Reads a file relative to the /proc dirfd into procBuf. Returns its length,
+//	or -1 if the process has gone away.
+//--------------------------------------------------------------------------------
+static long ReadProcFile(int dirFd, const char* pid, const char* file)
+{
+	char	path[64];
+	long	len;
+	int		fd;
+
+	snprintf(path, sizeof(path), "%s/%s", pid, file);
+	if ((fd = openat(dirFd, path, O_RDONLY)) < 0)
+		return -1;
+
+	len = read(fd, procBuf, sizeof(procBuf) - 1);
+	close(fd);
+
+	procBuf[len > 0 ? len : 0] = '\0';
+	return len;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Returns the next free synthetic task, growing the array when it's full.
+//--------------------------------------------------------------------------------
+static HostTask* NewHostTask(void)
+{
+	HostTask* grown;
+
+	if (hostTaskCount == hostTaskAlloc) {
+		hostTaskAlloc = hostTaskAlloc ? hostTaskAlloc * 2 : 256;
+		grown = realloc(hostTasks, hostTaskAlloc * sizeof(HostTask));
+		if (grown == NULL) {
+			fprintf(stderr, "Not enough memory for %lu tasks\n", hostTaskAlloc);
+			exit(RETURN_FAIL);
+		}
+		hostTasks = grown;
+	}
+
+	memset(&hostTasks[hostTaskCount], 0, sizeof(HostTask));
+	return &hostTasks[hostTaskCount++];
+}
+
+
+//--------------------------------------------------------------------------------
+//	Fills in a synthetic task from /proc/<pid>/stat & status. Returns FALSE if
+//	the process has gone away or its stat line can't be parsed.
+//--------------------------------------------------------------------------------
+static BOOL LoadProcTask(HostTask* ht, int dirFd, const char* pid, BOOL own)
+{
+	struct Task* task = &ht->proc.pr_Task;
+	char*	p;
+	char*	end;
+	char	state;
+	long	field, value;
+	long	pgrp = 0, tty = 0, tpgid = 0, nice = 0, rtPri = 0;
+	ULONG	flags = 0;
+	ULONG	stack = 0;
+	size_t	len;
+
+	// pid (comm) state ppid pgrp session tty_nr tpgid flags ... The comm name
+	// can contain spaces and parentheses, so it ends at the last ')'.
+	if (ReadProcFile(dirFd, pid, "stat") <= 0 ||
+		(p = strchr(procBuf, '(')) == NULL || (end = strrchr(procBuf, ')')) == NULL ||
+		end[1] != ' ' || end[2] == '\0')
+		return FALSE;
+
+	len = end - p - 1;
+	if (len >= HOST_NAME_SIZE)
+		len = HOST_NAME_SIZE - 1;
+	memcpy(ht->name, p + 1, len);
+	ht->name[len] = '\0';
+
+	state = end[2];
+	p = end + 3;
+	for (field = 4; field <= 40 && *p != '\0'; field++) {
+		value = strtol(p, &end, 10);
+		if (end == p)
+			break;	// Exit the for loop
+		p = end;
+
+		switch (field)
+		{
+			case 5:		pgrp = value;				break;
+			case 7:		tty = value;				break;
+			case 8:		tpgid = value;				break;
+			case 9:		flags = (ULONG)value;		break;
+			case 19:	nice = value;				break;
+			case 40:	rtPri = value;				break;
+		}
+	}
+
+	// Kernel threads have no VmStk or VmRSS line
+	if (ReadProcFile(dirFd, pid, "status") > 0) {
+		if ((p = strstr(procBuf, "\nVmStk:")) != NULL)
+			stack = strtoul(p + 7, NULL, 10) * 1024;
+		if ((p = strstr(procBuf, "\nVmRSS:")) != NULL)
+			ht->memList.ml_ME[0].me_Length = strtoul(p + 7, NULL, 10) * 1024;
+	}
+	ht->memList.ml_NumEntries = 1;
+	if (stack > procStackSize)
+		stack = procStackSize;
+
+	task->tc_Node.ln_Type = (flags & HOST_PROC_KTHREAD) ? NT_TASK : NT_PROCESS;
+	task->tc_Node.ln_Pri = (BYTE)(rtPri > 0 ? HOST_PROC_RT_PRI + rtPri : -nice);
+	task->tc_Node.ln_Name = ht->name;
+	task->tc_SPLower = (char*)stacks + stack;
+	task->tc_SPUpper = (char*)stacks + procStackSize + stack;
+	task->tc_SPReg = (char*)stacks + procStackSize;
+
+	switch (state)
+	{
+		case 'R':	task->tc_State = own ? TS_RUN : TS_READY;	break;
+		case 'T':
+		case 't':	task->tc_State = TS_EXCEPT;					break;
+		case 'Z':
+		case 'X':	task->tc_State = TS_REMOVED;				break;
+		default:	task->tc_State = TS_WAIT;					break;
+	}
+
+	// Sleeping Linux processes are taken to be waiting on their own port
+	task->tc_SigWait = task->tc_State == TS_WAIT ? SIGF_DOS : 0;
+
+	ht->hasTty = (tty != 0);
+	ht->foreground = (tty != 0 && tpgid == pgrp);
+
+	return TRUE;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Builds the synthetic system from the processes in procRoot.
+//--------------------------------------------------------------------------------
+static void LoadProcfs(void)
+{
+	HostTask* ht;
+	DIR*	dir;
+	struct dirent* entry;
+	char	ownPid[24];
+	ULONG	i, num;
+	int		dirFd;
+
+	free(cliTable);
+	free(cliLists);
+	hostTaskCount = 0;
+	snprintf(ownPid, sizeof(ownPid), "%ld", (long)getpid());
+
+	if ((dir = opendir(procRoot)) == NULL) {
+		fprintf(stderr, "Can't open %s\n", procRoot);
+		exit(RETURN_FAIL);
+	}
+	dirFd = dirfd(dir);
+
+	// Our own process comes first, whether or not procRoot is the real /proc
+	ht = NewHostTask();
+	if (!LoadProcTask(ht, dirFd, ownPid, TRUE)) {
+		strcpy(ht->name, "ShowProc");
+		ht->proc.pr_Task.tc_Node.ln_Type = NT_PROCESS;
+		ht->proc.pr_Task.tc_Node.ln_Name = ht->name;
+		ht->proc.pr_Task.tc_State = TS_RUN;
+	}
+
+	while ((entry = readdir(dir)) != NULL) {
+		if (!isdigit((unsigned char)entry->d_name[0]) || strcmp(entry->d_name, ownPid) == 0)
+			continue;	// Not a process, or it's ours
+		if (!LoadProcTask(NewHostTask(), dirFd, entry->d_name, FALSE))
+			hostTaskCount--;
+	}
+	closedir(dir);
+
+	// The array has stopped moving, so the lists can be linked up
+	NewList(&execBase.TaskReady);
+	NewList(&execBase.TaskWait);
+	num = 0;
+	for (i = 0; i < hostTaskCount; i++) {
+		ht = &hostTasks[i];
+		ht->proc.pr_Task.tc_Node.ln_Name = ht->name;
+		NewList(&ht->proc.pr_Task.tc_MemEntry);
+		AddTail(&ht->proc.pr_Task.tc_MemEntry, &ht->memList.ml_Node);
+		ht->proc.pr_MsgPort.mp_SigBit = SIGB_DOS;
+		ht->proc.pr_MsgPort.mp_SigTask = &ht->proc.pr_Task;
+		NewList(&ht->proc.pr_MsgPort.mp_MsgList);
+		if (i > 0)
+			AddTail(ht->proc.pr_Task.tc_State == TS_READY ? &execBase.TaskReady
+														  : &execBase.TaskWait,
+					&ht->proc.pr_Task.tc_Node);
+		if (ht->hasTty)
+			num++;
+	}
+
+	cliMax = num + 1;								// Numbered from 1, like MaxCli()
+	cliTable = calloc(cliMax + 1, sizeof(struct Process*));
+	if (cliTable == NULL) {
+		fprintf(stderr, "Not enough memory for %lu Shell/CLI processes\n", num);
+		exit(RETURN_FAIL);
+	}
+
+	num = 0;
+	for (i = 0; i < hostTaskCount; i++) {
+		ht = &hostTasks[i];
+		if (!ht->hasTty)
+			continue;	// Go to next task
+		SetupCli(ht, ++num, ht->name);
+		ht->cli.cli_Background = !ht->foreground;
+		ht->cli.cli_FailLevel = 0;
+		ht->cli.cli_DefaultStack = procStackSize / 4;
+		ht->proc.pr_GlobVec = NULL;
+	}
+	SetupCliList();
+
+	execBase.ThisTask = &hostTasks[0].proc.pr_Task;
+	softIntNext = NULL;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Builds the system from the Linux processes in root (normally "/proc"). It's
+//	read again each time a WATCH refresh interval passes.
+//--------------------------------------------------------------------------------
+void HostSetupProcfs(const char* root)
+{
+	struct rlimit limit;
+
+	HostTeardown();
+
+	// Linux has no libraries, devices or resources, and only ShowProc's own
+	// public ports are shown
+	NewList(&execBase.LibList);
+	NewList(&execBase.DeviceList);
+	NewList(&execBase.ResourceList);
+	NewList(&execBase.PortList);
+	NewList(&execBase.MemList);
+
+	procStackSize = HOST_PROC_STACK_MAX;
+	if (getrlimit(RLIMIT_STACK, &limit) == 0 && limit.rlim_cur < procStackSize)
+		procStackSize = limit.rlim_cur & ~3UL;
+
+	// Zeroes for the unused stack, then "used" stack
+	stacks = calloc(2, procStackSize);
+	if (stacks == NULL) {
+		fprintf(stderr, "Not enough memory for the stacks\n");
+		exit(RETURN_FAIL);
+	}
+	memset((char*)stacks + procStackSize, 0xA5, procStackSize);
+
+	procRoot = root;
+	LoadProcfs();
+
+	waitsLeft = 1;
+	HostResetStats();
+}
+
+
+//--------------------------------------------------------------------------------
+//	Sets the command line ReadArgs() parses (argv[0] is skipped).
+//--------------------------------------------------------------------------------
+void HostArgs(int argc, const char** argv)
+{
+	hostArgc = argc;
+	hostArgv = argv;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Turns the output off, for benchmarks. Write() calls are still counted.
+//--------------------------------------------------------------------------------
+void HostQuiet(BOOL on)
+{
+	quiet = on;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Sets how many Wait() calls return normally before Ctrl-C is "pressed".
+//--------------------------------------------------------------------------------
+void HostWaits(ULONG waits)
+{
+	waitsLeft = waits;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Sets a second command line (argv[0] is skipped) to run when the Wait() budget
+//	runs out, just before Ctrl-C is "pressed". This lets DAEMON be checked by a
+//	command run while it is waiting.
+//--------------------------------------------------------------------------------
+void HostThen(int argc, const char** argv)
+{
+	thenArgc = argc;
+	thenArgv = argv;
+	thenRc = -1;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Returns the return code of the HostThen() command, or -1 if it hasn't run.
+//--------------------------------------------------------------------------------
+int HostThenRc(void)
+{
+	return thenRc;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Runs the HostThen() command in the middle of the current one.
+//--------------------------------------------------------------------------------
+static void RunThen(void)
+{
+	int		argc = hostArgc;
+	const char** argv = hostArgv;
+	struct IORequest* pending = timerPending;
+
+	hostArgc = thenArgc;
+	hostArgv = thenArgv;
+	thenArgv = NULL;
+	timerPending = NULL;
+
+	thenRc = ShowProcMain();
+
+	hostArgc = argc;
+	hostArgv = argv;
+	timerPending = pending;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Changes the stack & priority of the next synthetic task, so there is
+//	something new each time a timer request completes, and adds & removes a
+//	few short-lived ones.
+//--------------------------------------------------------------------------------
+static void ChurnTasks(void)
+{
+	struct Task* task;
+	ULONG	i;
+
+	if (hostTaskCount < 2)
+		return;
+
+	task = &hostTasks[1 + churns++ % (hostTaskCount - 1)].proc.pr_Task;
+	task->tc_SPReg = (char*)task->tc_SPReg - 8;
+	if ((char*)task->tc_SPReg <= (char*)task->tc_SPLower)
+		task->tc_SPReg = (char*)task->tc_SPUpper - 200;
+	task->tc_Node.ln_Pri ^= 1;
+
+	// Tasks that come & go between two intervals, which only TRACE sees.
+	// There are more of them on a bigger system.
+	strcpy(flashTask.name, "Flash Task");
+	for (i = 0; i <= hostTaskCount / HOST_FLASH_DIV; i++) {
+		task = &flashTask.proc.pr_Task;
+		task->tc_Node.ln_Name = flashTask.name;
+		task->tc_Node.ln_Type = i % 2 ? NT_PROCESS : NT_TASK;
+		task->tc_Node.ln_Pri = (BYTE)(i % 5);
+		AddTask(task, NULL, NULL);
+		RemTask(task);
+	}
+}
+
+
+//--------------------------------------------------------------------------------
+//	Clears hostStats.
+//--------------------------------------------------------------------------------
+void HostResetStats(void)
+{
+	memset(&hostStats, 0, sizeof(hostStats));
+}
+
+
+//--------------------------------------------------------------------------------
+// exec.library
+//--------------------------------------------------------------------------------
+void Forbid(void)
+{
+	if (forbidNest++ == 0)
+		forbidStart = HostSeconds();
+}
+
+void Permit(void)
+{
+	double	held;
+
+	if (--forbidNest > 0)
+		return;
+
+	held = HostSeconds() - forbidStart;
+	hostStats.forbids++;
+	hostStats.forbidSecs += held;
+	if (held > hostStats.forbidMaxSecs)
+		hostStats.forbidMaxSecs = held;
+}
+
+struct Task* FindTask(const char* name)
+{
+	return name == NULL ? &hostTasks[0].proc.pr_Task : NULL;
+}
+
+BYTE SetTaskPri(struct Task* task, LONG pri)
+{
+	BYTE	old = task->tc_Node.ln_Pri;
+
+	task->tc_Node.ln_Pri = (BYTE)pri;
+	return old;
+}
+
+//	The real AddTask() & RemTask(), which SetFunction() can replace. The
+//	synthetic tasks never remove themselves.
+static APTR HostAddTask(struct Task* task, APTR initPC, APTR finalPC, struct ExecBase* base)
+{
+	task->tc_State = TS_READY;
+	AddTail(&base->TaskReady, &task->tc_Node);
+	return task;
+}
+
+static void HostRemTask(struct Task* task, struct ExecBase* base)
+{
+	task->tc_Node.ln_Pred->ln_Succ = task->tc_Node.ln_Succ;
+	task->tc_Node.ln_Succ->ln_Pred = task->tc_Node.ln_Pred;
+	task->tc_State = TS_REMOVED;
+}
+
+static APTR				addTaskVector = (APTR)HostAddTask;
+static APTR				remTaskVector = (APTR)HostRemTask;
+
+//	A replaced vector is one of ShowProc's TRACE entry stubs. Their 68000 code
+//	can't run here, so AddTask() & RemTask() do what it does from the gate.
+APTR AddTask(struct Task* task, APTR initPC, APTR finalPC)
+{
+	TraceGate*	gate;
+	APTR		result;
+
+	if (addTaskVector == (APTR)HostAddTask)
+		return HostAddTask(task, initPC, finalPC, &execBase);
+
+	gate = (TraceGate*)((char*)addTaskVector - offsetof(TraceGate, addTask));
+	gate->users++;
+	if (gate->active)
+		result = ((APTR (*)(Tracer*, struct Task*, APTR, APTR, struct ExecBase*))gate->addTask.patch)
+			(gate->tracer, task, initPC, finalPC, &execBase);
+	else
+		result = ((APTR (*)(struct Task*, APTR, APTR, struct ExecBase*))gate->addTask.old)
+			(task, initPC, finalPC, &execBase);
+	gate->users--;
+	return result;
+}
+
+void RemTask(struct Task* task)
+{
+	TraceGate*	gate;
+
+	if (remTaskVector == (APTR)HostRemTask) {
+		HostRemTask(task, &execBase);
+		return;
+	}
+
+	gate = (TraceGate*)((char*)remTaskVector - offsetof(TraceGate, remTask));
+	gate->users++;
+	if (gate->active)
+		((void (*)(Tracer*, struct Task*, struct ExecBase*))gate->remTask.patch)
+			(gate->tracer, task, &execBase);
+	else
+		((void (*)(struct Task*, struct ExecBase*))gate->remTask.old)(task, &execBase);
+	gate->users--;
+}
+
+//	The stub's code can't run here, so each word of it is checked against the
+//	68000 code in ShowProc.h as it's put in a vector. Operands hold the low 32
+//	bits of the addresses, as BuildTraceStub() truncates them.
+#define HOST_HI(addr)	(UWORD)((ULONG)(addr) >> 16)
+#define HOST_LO(addr)	(UWORD)(ULONG)(addr)
+
+static void HostCheckTraceStub(const TraceGate* gate, const TraceStub* stub)
+{
+	const UWORD	expected[TRACE_STUB_WORDS] = {
+		0x52B9, HOST_HI(&gate->users), HOST_LO(&gate->users),
+		0x4A79, HOST_HI(&gate->active), HOST_LO(&gate->active),
+		0x6714,
+		0x2079, HOST_HI(&gate->tracer), HOST_LO(&gate->tracer),
+		0x4EB9, HOST_HI(stub->patch), HOST_LO(stub->patch),
+		0x53B9, HOST_HI(&gate->users), HOST_LO(&gate->users),
+		0x4E75,
+		0x53B9, HOST_HI(&gate->users), HOST_LO(&gate->users),
+		0x2079, HOST_HI(&stub->old), HOST_LO(&stub->old),
+		0x4ED0
+	};
+	int		i;
+
+	for (i = 0; i < TRACE_STUB_WORDS; i++) {
+		if (stub->code[i] != expected[i]) {
+			fprintf(stderr, "TRACE stub word %d is %04X, not %04X\n",
+					i, stub->code[i], expected[i]);
+			exit(RETURN_FAIL);
+		}
+	}
+}
+
+//	Only the exec vectors TRACE patches can be replaced
+APTR SetFunction(struct Library* library, LONG funcOffset, ULONG (*newFunction)())
+{
+	APTR*	vector;
+	APTR	old;
+
+	if (library == &execBase.LibNode && funcOffset == -282) {
+		vector = &addTaskVector;
+		if ((APTR)newFunction != (APTR)HostAddTask)
+			HostCheckTraceStub((TraceGate*)((char*)newFunction - offsetof(TraceGate, addTask)),
+							   (TraceStub*)newFunction);
+	}
+	else if (library == &execBase.LibNode && funcOffset == -288) {
+		vector = &remTaskVector;
+		if ((APTR)newFunction != (APTR)HostRemTask)
+			HostCheckTraceStub((TraceGate*)((char*)newFunction - offsetof(TraceGate, remTask)),
+							   (TraceStub*)newFunction);
+	}
+	else {
+		fprintf(stderr, "SetFunction() of an unknown vector %ld\n", (long)funcOffset);
+		exit(RETURN_FAIL);
+	}
+
+	old = *vector;
+	*vector = (APTR)newFunction;
+	return old;
+}
+
+//	showproc.library is linked in, see proto/showproc.h, so it's always there.
+//	Nothing else is opened.
+struct Library* OpenLibrary(const char* name, ULONG version)
+{
+	static struct Library showProcLib;
+
+	if (strcmp(name, SHOWPROC_NAME) != 0 || version > SHOWPROC_VERSION)
+		return NULL;
+
+	showProcLib.lib_Version = SHOWPROC_VERSION;
+	showProcLib.lib_OpenCnt++;
+	return &showProcLib;
+}
+
+void CloseLibrary(struct Library* library)
+{
+	if (library != NULL)
+		library->lib_OpenCnt--;
+}
+
+//	Nothing's cached between writing code & running it here
+void CacheClearU(void)
+{
+}
+
+//	The synthetic system has fixed amounts free, in blocks of at most half of
+//	it. With /proc, the host's available memory is fast memory.
+ULONG AvailMem(ULONG requirements)
+{
+	ULONG	free;
+
+	if (requirements & MEMF_CHIP)
+		free = procRoot != NULL ? 0 : HOST_CHIP_FREE;
+	else if (procRoot != NULL)
+		free = (ULONG)sysconf(_SC_AVPHYS_PAGES) * (ULONG)sysconf(_SC_PAGESIZE);
+	else
+		free = HOST_FAST_FREE;
+
+	return (requirements & MEMF_LARGEST) ? free / 2 : free;
+}
+
+APTR AllocVec(ULONG size, ULONG flags)
+{
+	return (flags & MEMF_CLEAR) ? calloc(1, size ? size : 1) : malloc(size ? size : 1);
+}
+
+void FreeVec(APTR memory)
+{
+	free(memory);
+}
+
+BYTE AllocSignal(LONG signalNum)
+{
+	return HOST_FREE_SIG;
+}
+
+void FreeSignal(LONG signalNum)
+{
+}
+
+void Signal(struct Task* task, ULONG signals)
+{
+	// Only our own signals are kept; the other tasks aren't running
+	if (task == FindTask(NULL))
+		sigsPending |= signals;
+}
+
+ULONG SetSignal(ULONG newSignals, ULONG signalMask)
+{
+	ULONG	old = sigsPending;
+
+	sigsPending = (sigsPending & ~signalMask) | (newSignals & signalMask);
+	return old;
+}
+
+void NewList(struct List* list)
+{
+	list->lh_Head = (struct Node*)&list->lh_Tail;
+	list->lh_Tail = NULL;
+	list->lh_TailPred = (struct Node*)&list->lh_Head;
+}
+
+void AddPort(struct MsgPort* port)
+{
+	AddTail(&execBase.PortList, &port->mp_Node);
+}
+
+void RemPort(struct MsgPort* port)
+{
+	port->mp_Node.ln_Pred->ln_Succ = port->mp_Node.ln_Succ;
+	port->mp_Node.ln_Succ->ln_Pred = port->mp_Node.ln_Pred;
+}
+
+struct MsgPort* FindPort(const char* name)
+{
+	struct Node* node;
+
+	for (node = execBase.PortList.lh_Head; node->ln_Succ != NULL; node = node->ln_Succ)
+		if (strcmp(node->ln_Name, name) == 0)
+			return (struct MsgPort*)node;
+	return NULL;
+}
+
+struct Message* GetMsg(struct MsgPort* port)
+{
+	return NULL;
+}
+
+struct MsgPort* CreateMsgPort(void)
+{
+	struct MsgPort* port = calloc(1, sizeof(struct MsgPort));
+
+	if (port != NULL) {
+		port->mp_SigBit = HOST_TIMER_SIG;
+		NewList(&port->mp_MsgList);
+	}
+	return port;
+}
+
+void DeleteMsgPort(struct MsgPort* port)
+{
+	free(port);
+}
+
+struct IORequest* CreateIORequest(struct MsgPort* port, ULONG size)
+{
+	struct IORequest* request = calloc(1, size);
+
+	if (request != NULL)
+		request->io_Message.mn_ReplyPort = port;
+	return request;
+}
+
+void DeleteIORequest(struct IORequest* request)
+{
+	free(request);
+}
+
+//	timer.device is the only device opened
+BYTE OpenDevice(const char* name, ULONG unit, struct IORequest* request, ULONG flags)
+{
+	static struct Device timerDevice;
+
+	request->io_Device = &timerDevice;
+	return 0;
+}
+
+void CloseDevice(struct IORequest* request)
+{
+}
+
+//	Requests replying to a PA_SOFTINT port run the interrupt from Wait(). Any
+//	other request completes at the next Wait().
+void SendIO(struct IORequest* request)
+{
+	struct MsgPort* port = request->io_Message.mn_ReplyPort;
+
+	if (port != NULL && port->mp_Flags == PA_SOFTINT)
+		softIntPending = request;
+	else
+		timerPending = request;
+}
+
+struct IORequest* CheckIO(struct IORequest* request)
+{
+	return request == timerPending ? NULL : request;
+}
+
+void AbortIO(struct IORequest* request)
+{
+	if (request == timerPending)
+		timerPending = NULL;
+}
+
+BYTE WaitIO(struct IORequest* request)
+{
+	if (request == timerPending)
+		timerPending = NULL;
+	return 0;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Runs pending sampler interrupts, each one "interrupting" the next task in
+//	the task lists so the samples are spread over the system.
+//--------------------------------------------------------------------------------
+static void RunSoftInts(int count)
+{
+	struct IORequest* request;
+	struct Interrupt* interrupt;
+	struct Task* task;
+	UBYTE	state;
+
+	while (count-- > 0 && softIntPending != NULL)
+	{
+		request = softIntPending;
+		softIntPending = NULL;
+		interrupt = request->io_Message.mn_ReplyPort->mp_SigTask;
+
+		if (softIntNext == NULL || softIntNext->ln_Succ == NULL)
+			softIntNext = execBase.TaskWait.lh_Head;
+
+		task = execBase.ThisTask;
+		if (softIntNext->ln_Succ != NULL) {
+			task = (struct Task*)softIntNext;
+			softIntNext = softIntNext->ln_Succ;
+		}
+
+		state = task->tc_State;
+		task->tc_State = TS_RUN;
+		execBase.ThisTask = task;
+
+		((void (*)(APTR))interrupt->is_Code)(interrupt->is_Data);
+
+		task->tc_State = state;
+		execBase.ThisTask = &hostTasks[0].proc.pr_Task;
+	}
+}
+
+
+//--------------------------------------------------------------------------------
+//	Returns pending signals at once. A pending timer request completes unless
+//	the Wait() budget set by HostWaits() has run out, which "presses" Ctrl-C.
+//--------------------------------------------------------------------------------
+ULONG Wait(ULONG signals)
+{
+	ULONG	received;
+
+	RunSoftInts(HOST_SOFTINTS);
+
+	if (sigsPending & signals) {
+		received = sigsPending & signals;
+		sigsPending &= ~received;
+		return received;
+	}
+
+	if (waitsLeft == 0 && thenArgv != NULL)
+		RunThen();
+
+	if (waitsLeft == 0 || timerPending == NULL)
+		return signals & SIGBREAKF_CTRL_C;
+
+	waitsLeft--;
+	timerPending = NULL;
+
+	// The interval has passed, so the processes may have changed
+	if (procRoot != NULL)
+		LoadProcfs();
+	else
+		ChurnTasks();
+
+	return signals & (1L << HOST_TIMER_SIG);
+}
+
+
+//--------------------------------------------------------------------------------
+// dos.library
+//--------------------------------------------------------------------------------
+LONG IoErr(void)
+{
+	return ioErr;
+}
+
+BOOL PrintFault(LONG code, const char* header)
+{
+	if (header != NULL)
+		Printf("%s: ", header);
+	Printf("Error %ld\n", code);
+	return TRUE;
+}
+
+LONG Printf(const char* format, ...)
+{
+	char	buffer[256];
+	va_list	args;
+	int		len;
+
+	va_start(args, format);
+	len = vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+
+	if (len >= (int)sizeof(buffer))
+		len = sizeof(buffer) - 1;
+
+	return Write(Output(), buffer, len);
+}
+
+BPTR Output(void)
+{
+	return (BPTR)1;
+}
+
+LONG Write(BPTR file, const void* buffer, LONG length)
+{
+	const char* p = buffer;
+	LONG	i;
+
+	if (file != Output()) {
+		if ((LONG)fwrite(buffer, 1, length, (FILE*)file) == length)
+			return length;
+		ioErr = ERROR_DISK_FULL;
+		return -1;
+	}
+
+	hostStats.writeCalls++;
+	hostStats.writeBytes += length;
+	for (i = 0; i < length; i++)
+		if (p[i] == '\n')
+			hostStats.writeLines++;
+
+	if (quiet)
+		return length;
+
+	return (LONG)fwrite(buffer, 1, length, stdout);
+}
+
+// Files are opened on the host. T: & RAM: are put in /tmp, so the test cases
+// can use them.
+BPTR Open(const char* name, LONG accessMode)
+{
+	char	path[256];
+	FILE*	file;
+
+	if (strnicmp(name, "T:", 2) == 0)
+		snprintf(path, sizeof(path), "/tmp/%s", name + 2);
+	else if (strnicmp(name, "RAM:", 4) == 0)
+		snprintf(path, sizeof(path), "/tmp/%s", name + 4);
+	else
+		snprintf(path, sizeof(path), "%s", name);
+
+	file = fopen(path, accessMode == MODE_NEWFILE ? "wb" : "rb");
+	if (file == NULL)
+		ioErr = ERROR_OBJECT_NOT_FOUND;
+	return (BPTR)file;
+}
+
+BOOL Close(BPTR file)
+{
+	return fclose((FILE*)file) == 0;
+}
+
+LONG Read(BPTR file, void* buffer, LONG length)
+{
+	return (LONG)fread(buffer, 1, length, (FILE*)file);
+}
+
+LONG Seek(BPTR file, LONG position, LONG mode)
+{
+	LONG	old = ftell((FILE*)file);
+
+	if (fseek((FILE*)file, position,
+			  mode == OFFSET_BEGINNING ? SEEK_SET : mode == OFFSET_END ? SEEK_END : SEEK_CUR) != 0) {
+		ioErr = ERROR_SEEK_ERROR;
+		return -1;
+	}
+	return old;
+}
+
+ULONG CheckSignal(ULONG mask)
+{
+	ULONG	received = sigsPending & mask;
+
+	sigsPending &= ~received;
+	return received;
+}
+
+BOOL SetProgramName(const char* name)
+{
+	return TRUE;
+}
+
+//	Nothing else runs while we wait
+void Delay(LONG ticks)
+{
+}
+
+struct Process* FindCliProc(ULONG num)
+{
+	return num < cliMax ? cliTable[num] : NULL;
+}
+
+ULONG MaxCli(void)
+{
+	return cliMax;
+}
+
+//	The host's wall clock, in UTC
+struct DateStamp* DateStamp(struct DateStamp* date)
+{
+	time_t	secs = time(NULL) - HOST_EPOCH_1978;
+
+	date->ds_Days = (LONG)(secs / 86400);
+	date->ds_Minute = (LONG)(secs % 86400 / 60);
+	date->ds_Tick = (LONG)(secs % 60 * TICKS_PER_SECOND);
+	return date;
+}
+
+
+//--------------------------------------------------------------------------------
+// ReadArgs() for /S, /K, /N and /M items. Keywords can be given as KEY=value or
+// KEY value, and anything else fills the next free non-keyword item.
+//--------------------------------------------------------------------------------
+typedef struct HostItem {
+	char			names[64];				// Names separated by '=', plus a trailing '='
+	char			mods[8];				// Modifier letters, upper case
+	BOOL			filled;
+} HostItem;
+
+struct RDArgs {
+	void**			mem;					// Memory to free with FreeArgs()
+	int				count;
+};
+
+static void* ArgsAlloc(struct RDArgs* rdargs, size_t size)
+{
+	void**	mem = realloc(rdargs->mem, (rdargs->count + 1) * sizeof(void*));
+
+	if (mem == NULL)
+		return NULL;
+	rdargs->mem = mem;
+	return rdargs->mem[rdargs->count++] = calloc(1, size);
+}
+
+static BOOL HasMod(const HostItem* item, char mod)
+{
+	return strchr(item->mods, mod) != NULL;
+}
+
+static int ParseTemplate(const char* argTemplate, HostItem* items)
+{
+	int		count = 0;
+	size_t	len;
+	const char* slash;
+
+	while (*argTemplate != '\0' && count < HOST_MAX_ARGS)
+	{
+		HostItem* item = &items[count++];
+
+		memset(item, 0, sizeof(HostItem));
+		len = strcspn(argTemplate, ",");
+		slash = memchr(argTemplate, '/', len);
+
+		memcpy(item->names, argTemplate, slash ? (size_t)(slash - argTemplate) : len);
+		strcat(item->names, "=");
+
+		for (; slash != NULL && slash < argTemplate + len; slash++)
+			if (*slash != '/' && strlen(item->mods) < sizeof(item->mods) - 1)
+				item->mods[strlen(item->mods)] = (char)toupper((unsigned char)*slash);
+
+		argTemplate += len;
+		if (*argTemplate == ',')
+			argTemplate++;
+	}
+
+	return count;
+}
+
+static int FindKeyword(HostItem* items, int count, const char* arg, size_t len)
+{
+	const char* name;
+	int		i;
+
+	for (i = 0; i < count; i++)
+		for (name = items[i].names; *name != '\0'; name += strcspn(name, "=") + 1)
+			if (strcspn(name, "=") == len && strncasecmp(name, arg, len) == 0)
+				return i;
+
+	return -1;
+}
+
+static BOOL SetArg(struct RDArgs* rdargs, HostItem* item, LONG* slot, const char* value)
+{
+	void**	array;
+	void*	arg = (void*)value;
+	char*	end;
+	int		n = 0;
+
+	if (HasMod(item, 'N')) {
+		if ((arg = ArgsAlloc(rdargs, sizeof(LONG))) == NULL)
+			return FALSE;
+		*(LONG*)arg = strtol(value, &end, 10);
+		if (*value == '\0' || *end != '\0') {
+			ioErr = ERROR_BAD_NUMBER;
+			return FALSE;
+		}
+	}
+
+	if (!HasMod(item, 'M')) {
+		*slot = (LONG)arg;
+		item->filled = TRUE;
+		return TRUE;
+	}
+
+	// Multiple values are kept in a NULL-terminated array
+	for (array = (void**)*slot; array != NULL && array[n] != NULL; n++)
+		;
+	if ((array = ArgsAlloc(rdargs, (n + 2) * sizeof(void*))) == NULL)
+		return FALSE;
+	if (*slot)
+		memcpy(array, (void**)*slot, n * sizeof(void*));
+	array[n] = arg;
+	*slot = (LONG)array;
+	return TRUE;
+}
+
+struct RDArgs* ReadArgs(const char* argTemplate, LONG* array, struct RDArgs* args)
+{
+	HostItem items[HOST_MAX_ARGS];
+	struct RDArgs* rdargs;
+	const char* arg;
+	const char* eq;
+	int		count = ParseTemplate(argTemplate, items);
+	int		i;
+	int		k;
+
+	if ((rdargs = calloc(1, sizeof(struct RDArgs))) == NULL) {
+		ioErr = ERROR_NO_FREE_STORE;
+		return NULL;
+	}
+
+	for (i = 1; i < hostArgc; i++)
+	{
+		arg = hostArgv[i];
+		eq = strchr(arg, '=');
+		k = FindKeyword(items, count, arg, eq ? (size_t)(eq - arg) : strlen(arg));
+
+		if (k >= 0 && HasMod(&items[k], 'S')) {
+			if (eq != NULL) {
+				ioErr = ERROR_BAD_TEMPLATE;
+				goto fail;
+			}
+			array[k] = -1;
+			continue;
+		}
+
+		if (k >= 0) {
+			if (eq == NULL && ++i >= hostArgc) {
+				ioErr = ERROR_REQUIRED_ARG_MISSING;
+				goto fail;
+			}
+			if (!SetArg(rdargs, &items[k], &array[k], eq ? eq + 1 : hostArgv[i]))
+				goto fail;
+			continue;
+		}
+
+		// Not a keyword, so it goes to the next free positional item
+		for (k = 0; k < count; k++)
+			if (!HasMod(&items[k], 'S') && !HasMod(&items[k], 'K') && !items[k].filled)
+				break;
+		if (k == count) {
+			ioErr = ERROR_TOO_MANY_ARGS;
+			goto fail;
+		}
+		if (!SetArg(rdargs, &items[k], &array[k], arg))
+			goto fail;
+	}
+
+	return rdargs;
+
+fail:
+	FreeArgs(rdargs);
+	return NULL;
+}
+
+void FreeArgs(struct RDArgs* args)
+{
+	int		i;
+
+	if (args == NULL)
+		return;
+	for (i = 0; i < args->count; i++)
+		free(args->mem[i]);
+	free(args->mem);
+	free(args);
+}
+
+
+//--------------------------------------------------------------------------------
+// AmigaDOS patterns, matched without case: ? #x #? (a|b) [a-z] [~a] % ~x 'x.
+// The "tokenized" form is simply a copy of the pattern.
+//--------------------------------------------------------------------------------
+static BOOL MatchHere(const char* pat, const char* str, int depth);
+
+// Returns the end of the single pattern element starting at pat
+static const char* ElementEnd(const char* pat)
+{
+	int		nest = 0;
+
+	switch (*pat)
+	{
+		case '\'':
+			return pat[1] ? pat + 2 : pat + 1;
+		case '[':
+			while (*pat != '\0' && *pat != ']')
+				pat++;
+			return *pat ? pat + 1 : pat;
+		case '(':
+			for (; *pat != '\0'; pat++) {
+				if (*pat == '(')
+					nest++;
+				else if (*pat == ')' && --nest == 0)
+					return pat + 1;
+			}
+			return pat;
+		default:
+			return pat + 1;
+	}
+}
+
+// Checks a single character against a [...] set
+static BOOL MatchSet(const char* set, char c)
+{
+	BOOL	negate = FALSE;
+	BOOL	found = FALSE;
+
+	c = (char)toupper((unsigned char)c);
+	if (*++set == '~') {
+		negate = TRUE;
+		set++;
+	}
+
+	for (; *set != '\0' && *set != ']'; set++) {
+		if (set[1] == '-' && set[2] != ']' && set[2] != '\0') {
+			if (c >= toupper((unsigned char)set[0]) && c <= toupper((unsigned char)set[2]))
+				found = TRUE;
+			set += 2;
+		}
+		else if (c == toupper((unsigned char)*set))
+			found = TRUE;
+	}
+
+	return found != negate;
+}
+
+// Matches the element at pat, followed by rest, against str
+static BOOL MatchElement(const char* pat, const char* end, const char* rest, const char* str, int depth)
+{
+	char	buffer[512];
+	const char* alt;
+	size_t	len;
+	int		nest;
+
+	switch (*pat)
+	{
+		case '?':
+			return *str && MatchHere(rest, str + 1, depth);
+		case '%':
+			return MatchHere(rest, str, depth);
+		case '[':
+			return *str && MatchSet(pat, *str) && MatchHere(rest, str + 1, depth);
+		case '\'':
+			pat++;
+			break;
+		case '(':
+			// Try each alternative followed by the rest of the pattern
+			for (alt = pat + 1; alt < end - 1; alt += len + 1) {
+				for (len = 0, nest = 0; alt + len < end - 1; len++) {
+					if (alt[len] == '(')
+						nest++;
+					else if (alt[len] == ')')
+						nest--;
+					else if (alt[len] == '|' && nest == 0)
+						break;
+				}
+				if (len + strlen(rest) >= sizeof(buffer))
+					return FALSE;
+				memcpy(buffer, alt, len);
+				strcpy(buffer + len, rest);
+				if (MatchHere(buffer, str, depth))
+					return TRUE;
+			}
+			return FALSE;
+	}
+
+	return *str && toupper((unsigned char)*pat) == toupper((unsigned char)*str) &&
+		   MatchHere(rest, str + 1, depth);
+}
+
+static BOOL MatchHere(const char* pat, const char* str, int depth)
+{
+	const char* end;
+
+	if (++depth > HOST_PAT_DEPTH)
+		return FALSE;
+
+	if (*pat == '\0')
+		return *str == '\0';
+
+	// ~x matches anything x doesn't
+	if (*pat == '~')
+		return !MatchHere(pat + 1, str, depth);
+
+	// #x matches zero or more x: either none, or one x followed by #x again
+	if (*pat == '#') {
+		end = ElementEnd(pat + 1);
+		if (MatchHere(end, str, depth))
+			return TRUE;
+		return *str != '\0' && MatchElement(pat + 1, end, pat, str, depth);
+	}
+
+	end = ElementEnd(pat);
+	return MatchElement(pat, end, end, str, depth);
+}
+
+LONG ParsePatternNoCase(const char* source, char* dest, LONG destLength)
+{
+	const char* p;
+	int		nest = 0;
+
+	if ((LONG)strlen(source) * 2 + 2 > destLength)
+		return -1;
+
+	for (p = source; *p != '\0'; p++) {
+		if (*p == '\'' && p[1] != '\0')
+			p++;
+		else if (*p == '(')
+			nest++;
+		else if (*p == ')' && --nest < 0)
+			return -1;
+	}
+	if (nest != 0)
+		return -1;
+
+	strcpy(dest, source);
+	return strpbrk(source, "#?()|~[]%'") != NULL ? 1 : 0;
+}
+
+BOOL MatchPatternNoCase(const char* pattern, const char* string)
+{
+	return MatchHere(pattern, string, 0);
+}
+
+
+//--------------------------------------------------------------------------------
+// timer.device
+//--------------------------------------------------------------------------------
+ULONG HostReadEClock(struct Device* timerBase, struct EClockVal* dest)
+{
+	if (timerBase == NULL) {
+		fprintf(stderr, "ReadEClock() through a NULL TimerBase\n");
+		exit(RETURN_FAIL);
+	}
+
+	unsigned long long ticks = (unsigned long long)(HostSeconds() * 709379.0);
+
+	dest->ev_hi = (ULONG)(ticks >> 32);
+	dest->ev_lo = (ULONG)(ticks & 0xffffffffUL);
+	return 709379;
+}
@@ -0,0 +1,448 @@
+#ifndef AMIGA_HOST_H
+#define AMIGA_HOST_H
+
+//--------------------------------------------------------------------------------
+// Stand-in for the AmigaOS headers, so ShowProc.c can be built and run on the
+// host against the synthetic exec/dos layer in host.c. Only what ShowProc uses
+// is declared. LONG/ULONG are host longs, as ShowProc casts pointers to them.
+//--------------------------------------------------------------------------------
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
+//--------------------------------------------------------------------------------
+// exec/types.h
+//--------------------------------------------------------------------------------
+typedef long			LONG;
+typedef unsigned long	ULONG;
+typedef short			WORD;
+typedef unsigned short	UWORD;
+typedef signed char		BYTE;
+typedef unsigned char	UBYTE;
+typedef short			BOOL;
+typedef void*			APTR;
+typedef char*			STRPTR;
+typedef void*			BPTR;					// Pointers on the host, so NULL checks compile
+typedef void*			BSTR;
+
+#define TRUE				1
+#define FALSE				0
+
+// SAS/C keywords & register specifiers
+#define __asm
+#define __saveds
+#define __a0
+#define __a1
+#define __a2
+#define __a3
+#define __d0
+#define __d1
+#define __a6
+
+// SAS/C string functions
+#define stricmp				strcasecmp
+#define strnicmp			strncasecmp
+
+//--------------------------------------------------------------------------------
+// exec lists, tasks, messages & libraries
+//--------------------------------------------------------------------------------
+struct Node {
+	struct Node*	ln_Succ;
+	struct Node*	ln_Pred;
+	UBYTE			ln_Type;
+	BYTE			ln_Pri;
+	char*			ln_Name;
+};
+
+struct List {
+	struct Node*	lh_Head;
+	struct Node*	lh_Tail;
+	struct Node*	lh_TailPred;
+	UBYTE			lh_Type;
+	UBYTE			l_pad;
+};
+
+struct MinNode {
+	struct MinNode*	mln_Succ;
+	struct MinNode*	mln_Pred;
+};
+
+struct MinList {
+	struct MinNode*	mlh_Head;
+	struct MinNode*	mlh_Tail;
+	struct MinNode*	mlh_TailPred;
+};
+
+#define NT_TASK				1
+#define NT_INTERRUPT		2
+#define NT_DEVICE			3
+#define NT_MSGPORT			4
+#define NT_MESSAGE			5
+#define NT_REPLYMSG			7
+#define NT_RESOURCE			8
+#define NT_LIBRARY			9
+#define NT_MEMORY			10
+#define NT_PROCESS			13
+
+#define TS_INVALID			0
+#define TS_ADDED			1
+#define TS_RUN				2
+#define TS_READY			3
+#define TS_WAIT				4
+#define TS_EXCEPT			5
+#define TS_REMOVED			6
+
+struct Task {
+	struct Node		tc_Node;
+	UBYTE			tc_Flags;
+	UBYTE			tc_State;
+	BYTE			tc_IDNestCnt;
+	BYTE			tc_TDNestCnt;
+	ULONG			tc_SigAlloc;
+	ULONG			tc_SigWait;
+	ULONG			tc_SigRecvd;
+	ULONG			tc_SigExcept;
+	UWORD			tc_TrapAlloc;
+	UWORD			tc_TrapAble;
+	APTR			tc_ExceptData;
+	APTR			tc_ExceptCode;
+	APTR			tc_TrapData;
+	APTR			tc_TrapCode;
+	APTR			tc_SPReg;
+	APTR			tc_SPLower;
+	APTR			tc_SPUpper;
+	void			(*tc_Switch)(void);
+	void			(*tc_Launch)(void);
+	struct List		tc_MemEntry;
+	APTR			tc_UserData;
+};
+
+#define PF_ACTION			3
+#define PA_SIGNAL			0
+#define PA_SOFTINT			1
+#define PA_IGNORE			2
+
+struct MsgPort {
+	struct Node		mp_Node;
+	UBYTE			mp_Flags;
+	UBYTE			mp_SigBit;
+	void*			mp_SigTask;
+	struct List		mp_MsgList;
+};
+
+struct Message {
+	struct Node		mn_Node;
+	struct MsgPort*	mn_ReplyPort;
+	UWORD			mn_Length;
+};
+
+struct Interrupt {
+	struct Node		is_Node;
+	APTR			is_Data;
+	void			(*is_Code)();
+};
+
+struct Library {
+	struct Node		lib_Node;
+	UBYTE			lib_Flags;
+	UBYTE			lib_pad;
+	UWORD			lib_NegSize;
+	UWORD			lib_PosSize;
+	UWORD			lib_Version;
+	UWORD			lib_Revision;
+	APTR			lib_IdString;
+	ULONG			lib_Sum;
+	UWORD			lib_OpenCnt;
+};
+
+struct Device {
+	struct Library	dd_Library;
+};
+
+struct ExecBase {
+	struct Library	LibNode;
+	struct Task*	ThisTask;
+	struct List		MemList;
+	struct List		ResourceList;
+	struct List		DeviceList;
+	struct List		IntrList;
+	struct List		LibList;
+	struct List		PortList;
+	struct List		TaskReady;
+	struct List		TaskWait;
+};
+
+#define MEMF_ANY			0
+#define MEMF_PUBLIC			(1L << 0)
+#define MEMF_CHIP			(1L << 1)
+#define MEMF_FAST			(1L << 2)
+#define MEMF_CLEAR			(1L << 16)
+#define MEMF_LARGEST		(1L << 17)
+
+struct MemEntry {
+	union {
+		ULONG		meu_Reqs;
+		APTR		meu_Addr;
+	}				me_Un;
+	ULONG			me_Length;
+};
+
+struct MemChunk {
+	struct MemChunk* mc_Next;
+	ULONG			mc_Bytes;
+};
+
+struct MemHeader {
+	struct Node		mh_Node;
+	UWORD			mh_Attributes;
+	struct MemChunk* mh_First;
+	APTR			mh_Lower;
+	APTR			mh_Upper;
+	ULONG			mh_Free;
+};
+
+struct MemList {
+	struct Node		ml_Node;
+	UWORD			ml_NumEntries;
+	struct MemEntry	ml_ME[1];
+};
+
+#define SIGB_DOS			8
+#define SIGF_DOS			(1L << 8)
+#define SIGBREAKF_CTRL_C	(1L << 12)
+#define SIGBREAKF_CTRL_D	(1L << 13)
+#define SIGBREAKF_CTRL_E	(1L << 14)
+#define SIGBREAKF_CTRL_F	(1L << 15)
+
+//--------------------------------------------------------------------------------
+// dos processes & Shell/CLIs
+//--------------------------------------------------------------------------------
+#define BADDR(bptr)			((void*)((uintptr_t)(bptr) << 2))
+#define MKBADDR(ptr)		((BPTR)((uintptr_t)(ptr) >> 2))
+
+struct Process {
+	struct Task		pr_Task;
+	struct MsgPort	pr_MsgPort;
+	WORD			pr_Pad;
+	BPTR			pr_SegList;
+	LONG			pr_StackSize;
+	APTR			pr_GlobVec;
+	LONG			pr_TaskNum;
+	BPTR			pr_StackBase;
+	LONG			pr_Result2;
+	BPTR			pr_CurrentDir;
+	BPTR			pr_CIS;
+	BPTR			pr_COS;
+	APTR			pr_ConsoleTask;
+	APTR			pr_FileSystemTask;
+	BPTR			pr_CLI;
+};
+
+struct CommandLineInterface {
+	LONG			cli_Result2;
+	BSTR			cli_SetName;
+	BPTR			cli_CommandDir;
+	LONG			cli_ReturnCode;
+	BSTR			cli_CommandName;
+	LONG			cli_FailLevel;
+	BSTR			cli_Prompt;
+	BPTR			cli_StandardInput;
+	BPTR			cli_CurrentInput;
+	BSTR			cli_CommandFile;
+	LONG			cli_Interactive;
+	LONG			cli_Background;
+	BPTR			cli_CurrentOutput;
+	LONG			cli_DefaultStack;
+	BPTR			cli_StandardOutput;
+	BPTR			cli_Module;
+};
+
+// One run of Shell/CLI numbers in RootNode->rn_CliList. cpl_Array[0] holds
+// the number of slots, & slot n the port of process cpl_First + n - 1.
+struct CliProcList {
+	struct MinNode	cpl_Node;
+	LONG			cpl_First;
+	struct MsgPort** cpl_Array;
+};
+
+struct RootNode {
+	BPTR			rn_TaskArray;			// cpl_Array of the first CliProcList
+	struct MinList	rn_CliList;
+};
+
+struct DosLibrary {
+	struct Library	dl_lib;
+	struct RootNode* dl_Root;
+};
+
+#define MODE_OLDFILE		1005
+#define MODE_NEWFILE		1006
+
+#define OFFSET_BEGINNING	-1
+#define OFFSET_CURRENT		0
+#define OFFSET_END			1
+
+#define RETURN_OK			0
+#define RETURN_WARN			5
+#define RETURN_ERROR		10
+#define RETURN_FAIL			20
+
+#define ERROR_NO_FREE_STORE			103
+#define ERROR_BAD_TEMPLATE			114
+#define ERROR_BAD_NUMBER			115
+#define ERROR_REQUIRED_ARG_MISSING	116
+#define ERROR_TOO_MANY_ARGS			118
+#define ERROR_OBJECT_NOT_FOUND		205
+#define ERROR_SEEK_ERROR			219
+#define ERROR_DISK_FULL				221
+#define ERROR_BREAK					304
+
+struct DateStamp {
+	LONG			ds_Days;				// Days since 1 Jan 1978
+	LONG			ds_Minute;				// Minutes past midnight
+	LONG			ds_Tick;				// Ticks past the minute
+};
+
+#define TICKS_PER_SECOND	50
+
+struct RDArgs;
+
+//--------------------------------------------------------------------------------
+// timer.device
+//--------------------------------------------------------------------------------
+#define TIMERNAME			"timer.device"
+#define UNIT_MICROHZ		0
+#define UNIT_VBLANK			1
+#define UNIT_ECLOCK			2
+#define TR_ADDREQUEST		9
+
+struct IORequest {
+	struct Message	io_Message;
+	struct Device*	io_Device;
+	struct Unit*	io_Unit;
+	UWORD			io_Command;
+	UBYTE			io_Flags;
+	BYTE			io_Error;
+};
+
+// Named apart from struct timeval so it doesn't clash with the host's
+struct HostTimeVal {
+	ULONG			tv_secs;
+	ULONG			tv_micro;
+};
+
+struct timerequest {
+	struct IORequest	tr_node;
+	struct HostTimeVal	tr_time;
+};
+
+struct EClockVal {
+	ULONG			ev_hi;
+	ULONG			ev_lo;
+};
+
+//--------------------------------------------------------------------------------
+// Library bases
+//--------------------------------------------------------------------------------
+extern struct ExecBase*	SysBase;
+extern struct Library*	DOSBase;
+extern struct Device*	TimerBase;
+
+//--------------------------------------------------------------------------------
+// exec.library
+//--------------------------------------------------------------------------------
+void 	Forbid(void);
+void 	Permit(void);
+struct Task* FindTask(const char* name);
+BYTE 	SetTaskPri(struct Task* task, LONG pri);
+APTR 	AddTask(struct Task* task, APTR initPC, APTR finalPC);
+void 	RemTask(struct Task* task);
+APTR 	SetFunction(struct Library* library, LONG funcOffset, ULONG (*newFunction)());
+void 	CacheClearU(void);
+struct Library* OpenLibrary(const char* name, ULONG version);
+void 	CloseLibrary(struct Library* library);
+APTR 	AllocVec(ULONG size, ULONG flags);
+void 	FreeVec(APTR memory);
+ULONG 	AvailMem(ULONG requirements);
+BYTE 	AllocSignal(LONG signalNum);
+void 	FreeSignal(LONG signalNum);
+void 	Signal(struct Task* task, ULONG signals);
+ULONG 	SetSignal(ULONG newSignals, ULONG signalMask);
+ULONG 	Wait(ULONG signals);
+void 	NewList(struct List* list);
+void 	AddPort(struct MsgPort* port);
+void 	RemPort(struct MsgPort* port);
+struct MsgPort* FindPort(const char* name);
+struct Message* GetMsg(struct MsgPort* port);
+struct MsgPort* CreateMsgPort(void);
+void 	DeleteMsgPort(struct MsgPort* port);
+struct IORequest* CreateIORequest(struct MsgPort* port, ULONG size);
+void 	DeleteIORequest(struct IORequest* request);
+BYTE 	OpenDevice(const char* name, ULONG unit, struct IORequest* request, ULONG flags);
+void 	CloseDevice(struct IORequest* request);
+void 	SendIO(struct IORequest* request);
+struct IORequest* CheckIO(struct IORequest* request);
+void 	AbortIO(struct IORequest* request);
+BYTE 	WaitIO(struct IORequest* request);
+
+//--------------------------------------------------------------------------------
+// dos.library
+//--------------------------------------------------------------------------------
+struct RDArgs* ReadArgs(const char* argTemplate, LONG* array, struct RDArgs* args);
+void 	FreeArgs(struct RDArgs* args);
+LONG 	IoErr(void);
+BOOL 	PrintFault(LONG code, const char* header);
+LONG 	Printf(const char* format, ...);
+BPTR 	Output(void);
+LONG 	Write(BPTR file, const void* buffer, LONG length);
+BPTR 	Open(const char* name, LONG accessMode);
+BOOL 	Close(BPTR file);
+LONG 	Read(BPTR file, void* buffer, LONG length);
+LONG 	Seek(BPTR file, LONG position, LONG mode);
+ULONG 	CheckSignal(ULONG mask);
+BOOL 	SetProgramName(const char* name);
+void 	Delay(LONG ticks);
+struct Process* FindCliProc(ULONG num);
+ULONG 	MaxCli(void);
+LONG 	ParsePatternNoCase(const char* source, char* dest, LONG destLength);
+BOOL 	MatchPatternNoCase(const char* pattern, const char* string);
+struct DateStamp* DateStamp(struct DateStamp* date);
+
+//--------------------------------------------------------------------------------
+// timer.device
+//--------------------------------------------------------------------------------
+// Goes through the TimerBase in scope, as the pragma does, so code that can't
+// reach the global has to bring its own
+#define ReadEClock(dest)	HostReadEClock(TimerBase, dest)
+ULONG 	HostReadEClock(struct Device* timerBase, struct EClockVal* dest);
+
+//--------------------------------------------------------------------------------
+// Host layer control (host.c)
+//--------------------------------------------------------------------------------
+
+// Counters kept by the host layer while ShowProc runs
+typedef struct HostStats {
+	ULONG			writeCalls;				// Number of Write() calls
+	ULONG			writeBytes;				// Bytes passed to Write()
+	ULONG			writeLines;				// Newlines passed to Write()
+	ULONG			forbids;				// Number of outermost Forbid()/Permit() pairs
+	double			forbidSecs;				// Total time spent between Forbid() & Permit()
+	double			forbidMaxSecs;			// Longest single Forbid()/Permit() hold
+} HostStats;
+
+extern HostStats	hostStats;
+
+void 	HostSetup(ULONG tasks, ULONG clis);
+void 	HostSetupProcfs(const char* root);
+void 	HostTeardown(void);
+void 	HostArgs(int argc, const char** argv);
+void 	HostQuiet(BOOL quiet);
+void 	HostWaits(ULONG waits);
+void 	HostThen(int argc, const char** argv);
+int 	HostThenRc(void);
+void 	HostResetStats(void);
+double 	HostSeconds(void);
+int 	ShowProcMain(void);
+
+#endif // AMIGA_HOST_H
@@ -0,0 +1,2 @@
+// Host stand-in, see amiga_host.h
+#include "amiga_host.h"
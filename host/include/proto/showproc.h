@@ -0,0 +1,12 @@
+// Host stand-in, see amiga_host.h. showproc.library's entry points only pass
+// their arguments on to ShowProc.c, so the calls go straight there.
+#include "amiga_host.h"
+#include <libraries/showproc.h>
+
+extern struct Library*	ShowProcBase;
+
+LONG 	TakeBinSnapshot(APTR buffer, ULONG size, ULONG flags);
+LONG 	FindCommandCli(const char** patterns);
+
+#define SP_TakeSnapshot(buffer, size, flags)	TakeBinSnapshot(buffer, size, flags)
+#define SP_FindCli(patterns)					FindCommandCli(patterns)
@@ -0,0 +1,50 @@
+//--------------------------------------------------------------------------------
+// Runs ShowProc on the host against a synthetic system, or the Linux processes.
+//
+// The system is taken from the environment:
+//	SHOWPROC_PROC	/proc directory to read the Linux processes from (default none)
+//	SHOWPROC_TASKS	Tasks & processes besides the Shell/CLI processes (default 12)
+//	SHOWPROC_CLIS	Shell/CLI processes besides our own (default 5)
+//	SHOWPROC_WAITS	Waits that complete before Ctrl-C is pressed (default 1)
+//
+// Arguments after a + are run as a second command just before Ctrl-C is
+// pressed, and its return code is returned, e.g. "daemon=1 + history".
+//--------------------------------------------------------------------------------
+#include <stdlib.h>
+#include <string.h>
+
+#include "amiga_host.h"
+
+//--------------------------------------------------------------------------------
+//	Returns the value of an environment variable, or def if it isn't set.
+//--------------------------------------------------------------------------------
+static ULONG EnvNum(const char* name, ULONG def)
+{
+	const char* value = getenv(name);
+
+	return value != NULL ? strtoul(value, NULL, 10) : def;
+}
+
+
+int main(int argc, const char** argv)
+{
+	int		split;
+	int		rc;
+
+	if (getenv("SHOWPROC_PROC") != NULL)
+		HostSetupProcfs(getenv("SHOWPROC_PROC"));
+	else
+		HostSetup(EnvNum("SHOWPROC_TASKS", 12), EnvNum("SHOWPROC_CLIS", 5));
+	HostWaits(EnvNum("SHOWPROC_WAITS", 1));
+
+	// The + takes the place of argv[0] for the second command
+	for (split = 1; split < argc && strcmp(argv[split], "+") != 0; split++)
+		;
+	if (split < argc)
+		HostThen(argc - split, argv + split);
+	HostArgs(split, argv);
+
+	rc = ShowProcMain();
+
+	return HostThenRc() >= 0 ? HostThenRc() : rc;
+}
@@ -0,0 +1,45 @@
+#!/bin/sh
+#--------------------------------------------------------------------------------
+# Runs the src/test_cases scenarios against the host build and checks their
+# return codes. The system size is taken from SHOWPROC_TASKS & SHOWPROC_CLIS,
+# so the same cases double as a throughput check on a large system. With
+# SHOWPROC_PROC set, the Linux processes are used instead.
+#
+# Usage: run_tests.sh <showproc binary> <test_cases file>
+#--------------------------------------------------------------------------------
+showproc=$1
+cases=$2
+pass=0
+fail=0
+
+# Patterns such as show#? must reach ShowProc as they are
+set -f
+
+start=$(date +%s.%N)
+
+while read -r cmd out num expected name args; do
+	[ "$cmd" = "test" ] || continue
+
+	"$showproc" $args >/dev/null 2>&1
+	rc=$?
+
+	if [ "$rc" -eq "$expected" ]; then
+		pass=$((pass + 1))
+	else
+		fail=$((fail + 1))
+		echo "Test case $num: $name $args: expected $expected, got $rc"
+	fi
+done < "$cases"
+
+end=$(date +%s.%N)
+
+if [ -n "$SHOWPROC_PROC" ]; then
+	system="$SHOWPROC_PROC"
+else
+	system="${SHOWPROC_TASKS:-12} tasks, ${SHOWPROC_CLIS:-5} CLIs"
+fi
+
+echo "$system: $pass passed, $fail failed" \
+	 "in $(awk "BEGIN { printf \"%.2f\", $end - $start }") s"
+
+[ "$fail" -eq 0 ]
@@ -6,10 +6,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 
 #include <proto/dos.h>
 #include <proto/exec.h>
-#include <proto/wb.h>
+#include <proto/timer.h>
+#include <proto/showproc.h>
+#include <devices/timer.h>
+#include <libraries/showproc.h>
 
 #include "ShowProc_rev.h"
 #include "ShowProc.h"
@@ -20,16 +24,297 @@ const char* version = VERSTAG;
 //--------------------------------------------------------------------------------
 // Function prototypes
 //--------------------------------------------------------------------------------
-int 	ParseCommandLineArgs(Mode* mode, OutFrmt* format, int* start, int* finish, char* cmd_pat);
+int 	ParseCommandLineArgs(Options* opts);
 BOOL 	SanitizeCommandName(char* cleanName, const char* dirtyName);
-int 	PrintShellProcesses(Mode mode, OutFrmt format, int start, int finish, char* cmd_pat);
-int 	PrintThisProcess(OutFrmt format, int* taskCount);
-int 	PrintTaskList(OutFrmt format, struct List* taskList, int* taskCount);
-BOOL 	CheckCommandMatch(const BSTR bstring, const char* cmd_pat);
+int 	CaptureTasks(Options* opts, Snapshot* snap);
+int 	TakeSnapshot(Snapshot* snap, Mode mode, int start, int finish);
+void 	FreeSnapshot(Snapshot* snap);
+void 	SortSnapshot(Snapshot* snap);
+TaskRec* NewTaskRec(Snapshot* snap);
+void 	KeepTaskRec(Snapshot* snap, TaskRec* rec);
+BOOL 	CheckAlerts(Snapshot* snap, TaskRec* rec);
+int 	SettleAlerts(Snapshot* snap);
+int 	CompareTaskRecs(const TaskRec* a, const TaskRec* b, SortKey sort);
+LONG 	StackDepth(const TaskRec* rec);
+LONG 	StackPercent(const TaskRec* rec);
+LONG 	StateRank(UBYTE state);
+void 	SiftUp(TaskRec* heap, ULONG i, SortKey sort);
+void 	SiftDown(TaskRec* heap, ULONG i, ULONG count, SortKey sort);
+void 	SortTaskRecs(TaskRec* recs, ULONG count, SortKey sort, BOOL isHeap);
+void 	SnapThisProcess(Snapshot* snap);
+void 	SnapTaskList(Snapshot* snap, struct List* taskList);
+void 	SnapExecLists(Snapshot* snap);
+void 	SnapExecList(Snapshot* snap, struct List* list, ExecList which);
+void 	SnapShellProcesses(Snapshot* snap, int start, int finish);
+void 	SnapMissingProcesses(Snapshot* snap, long start, long finish);
+void 	BreakShellProcesses(Snapshot* snap);
+void 	SetTaskPris(Snapshot* snap);
+void 	SnapShellProcess(Snapshot* snap, TaskRec* rec, long num, struct Process* process);
+void 	SnapProcess(Snapshot* snap, TaskRec* rec, struct Process* process);
+LONG 	StackHighWater(struct Task* task);
+LONG 	RecommendedStack(const TaskRec* rec);
+LONG 	TaskMemory(struct Task* task);
+LONG 	SegListSize(BPTR segList);
+UWORD 	CountMessages(struct MsgPort* port, ULONG max);
+void 	SnapWaitPort(Snapshot* snap, TaskRec* rec, struct Task* task);
+int 	PrintShellProcesses(Options* opts, Snapshot* snap);
+int 	PrintTaskList(Options* opts, Snapshot* snap);
+int 	PrintExecLists(Options* opts, Snapshot* snap);
+void 	PrintSectionHeader(Options* opts, const char* heading, const Column* columns);
+void 	PrintTableHeader(const Column* columns, ULONG show);
+void 	PrintRecord(const Column* columns, ULONG show, const TaskRec* rec, long num);
+const char* RecordError(const TaskRec* rec);
+void 	PrintRow(const Column* columns, ULONG show, const TaskRec* rec, long num);
+BOOL 	ShowColumn(const Column* col, ULONG show);
+void 	PrintCell(const Column* column, const TaskRec* rec, long num);
+void 	EncodeStart(Options* opts);
+void 	EncodeEnd(Options* opts, Snapshot* snap);
+void 	EncodeTableStart(Options* opts, const char* key, ULONG tag, const Column* columns, ULONG count);
+void 	EncodeTableEnd(Options* opts);
+void 	EncodeRecord(Options* opts, const Column* columns, const TaskRec* rec, long num, BOOL first);
+void 	EncodeBinRecord(const TaskRec* rec, long num);
+void 	FillBinRec(BinRec* bin, const TaskRec* rec, long num);
+void 	EncodeCell(Options* opts, const Column* col, const TaskRec* rec, long num);
+const char* FieldKey(Field field);
+void 	EncodeKey(const char* key);
+void 	EncodeStr(Options* opts, const char* str);
+void 	EncodeNull(Options* opts);
+void 	EncodeBool(Options* opts, BOOL value);
+int 	WatchTasks(Options* opts, Snapshot* snap, Sampler* sampler);
+int 	DrawWatchScreen(Options* opts, Snapshot* snap, WatchTable* cliTable, WatchTable* sysTable);
+int 	DrawWatchTable(Options* opts, WatchTable* table, TaskRec* recs, ULONG count);
+BOOL 	UpdateWatchTable(Options* opts, WatchTable* table, TaskRec* recs, ULONG count, BOOL canGrow);
+BOOL 	UpdateSortedWatchTable(Options* opts, WatchTable* table, TaskRec* recs, ULONG count, BOOL canGrow);
+BOOL 	GrowWatchTable(WatchTable* table, ULONG count);
+void 	DrawWatchSlot(Options* opts, WatchTable* table, ULONG slot);
+BOOL 	TaskRecChanged(const TaskRec* a, const TaskRec* b);
+struct timerequest* OpenTimer(ULONG unit);
+void 	CloseTimer(struct timerequest* timer);
+BOOL 	WaitTimer(struct timerequest* timer, ULONG secs, ULONG micros);
+Sampler* StartSampler(void);
+void 	StopSampler(Sampler* sampler);
+void 	ReadSamples(Sampler* sampler, Snapshot* snap);
+void 	SortSamples(Snapshot* snap, ULONG top);
+ULONG 	KeepTopRecs(Snapshot* snap, ULONG to, ULONG from, ULONG* count, ULONG top);
+void 	PrintSampleSummary(Snapshot* snap);
+void 	PrintMemSummary(Snapshot* snap);
+int 	PrintMemMap(Options* opts);
+ULONG 	SnapMemMap(MemRegion* regions, ULONG max);
+ULONG 	SizeClass(ULONG bytes);
+LONG 	Fragmentation(const MemRegion* region);
+void 	PrintProcSummary(Options* opts, Snapshot* snap);
+void 	PrintBreakSummary(Snapshot* snap);
+int 	PrintPriChanges(Options* opts, Snapshot* snap);
+void 	__asm SampleHandler(register __a1 Sampler* sampler);
+int 	RunTrace(Options* opts);
+BOOL 	RemoveTracePatches(Tracer* tracer);
+void 	DrainTrace(Options* opts, Tracer* tracer);
+void 	AdvanceTraceClock(Tracer* tracer, ULONG tick);
+void 	TraceTask(Tracer* tracer, struct ExecBase* SysBase, struct Task* task, UBYTE event);
+void 	BuildTraceStub(TraceGate* gate, TraceStub* stub, APTR patch);
+APTR 	__asm TraceAddTask(register __a0 Tracer* tracer, register __a1 struct Task* task,
+						   register __a2 APTR initPC, register __a3 APTR finalPC,
+						   register __a6 struct ExecBase* SysBase);
+void 	__asm TraceRemTask(register __a0 Tracer* tracer, register __a1 struct Task* task,
+						   register __a6 struct ExecBase* SysBase);
+BOOL 	CompileCommandPatterns(Options* opts, char** names);
+const char* CompileCommandPattern(CmdPattern* pat, const char* name);
+BOOL 	ParseProcessNumbers(Options* opts, const char* text);
+ULONG 	ParseBreakSignals(const char* text);
+BOOL 	ParseAlertRules(Options* opts, const char* text);
+const char* ParseAlertRule(AlertRule* rule, const char* text);
+const char* ParseWord(char* word, ULONG size, const char* text);
+BOOL 	PlanColumns(Options* opts, const char* text);
+Column* PlanTable(Column* plan, const Column* columns, const Field* fields, ULONG count);
+BOOL 	ShownTablesHave(const Options* opts, Field field);
+const Column* FindColumn(const Column* columns, Field field);
+ULONG 	UnshownFields(Options* opts);
+BOOL 	WidenNumColumns(Options* opts, const Snapshot* snap);
+BOOL 	NarrowColumn(const Column* columns, Field field, UBYTE width);
+void 	WidenColumn(Column* columns, Field field, UBYTE width);
+UBYTE 	NumWidth(long num);
+ULONG 	PutBinTable(UBYTE* buffer, ULONG size, ULONG offset, ULONG tag, const TaskRec* recs, ULONG count);
+ULONG 	PutBinTables(UBYTE* buffer, ULONG size, ULONG offset, const Snapshot* snap, Mode mode);
+int 	SaveSnapshot(Options* opts, Snapshot* snap);
+ULONG 	LibrarySnapshotFlags(const Options* opts);
+int 	WriteLibrarySnapshot(Options* opts, ULONG flags);
+int 	WriteSaveFile(Options* opts, const UBYTE* buffer, ULONG size);
+BOOL 	ReadSnapshotFile(Options* opts, const char* name);
+const BinTable* FindBinTable(const UBYTE* buffer, ULONG size, ULONG tag);
+int 	LoadSnapshot(Snapshot* snap, const UBYTE* buffer, ULONG size);
+void 	LoadBinTable(Snapshot* snap, const BinTable* table);
+void 	FillTaskRec(TaskRec* rec, const BinRec* bin);
+int 	PrintDiff(Options* opts, Snapshot* snap);
+void 	DiffTable(TaskRec* was, ULONG wasCount, TaskRec* now, ULONG nowCount, BOOL cli, ULONG* counts);
+BOOL 	DiffTaskRecs(const TaskRec* old, const TaskRec* rec, BOOL cli);
+void 	PrintDiffLine(char sign, const TaskRec* rec, BOOL cli);
+BOOL 	CheckCommandMatch(const char* cmd_name, const CmdPattern* patterns, ULONG count);
 char* 	GetStateName(UBYTE state);
+const char* GetAlertName(UBYTE level);
 BOOL 	CheckRequirements(void);
+void 	OpenTiming(void);
+void 	CloseTiming(void);
+void 	TimingStart(struct EClockVal* start);
+ULONG 	TimingStop(const struct EClockVal* start);
+ULONG 	TicksToMicros(ULONG ticks);
+void 	PrintTiming(void);
+void 	EncodeTiming(void);
+int 	RunDaemon(Options* opts);
+int 	StopDaemon(void);
+void 	RecordFrame(HistoryPort* hp, FrameBuf* frame, Snapshot* prev, Snapshot* cur);
+void 	EncodeFrame(FrameBuf* fb, const Snapshot* prev, const Snapshot* cur, ULONG time, BOOL key);
+UBYTE 	TaskRecChanges(const TaskRec* a, const TaskRec* b);
+UBYTE 	HistState(const TaskRec* rec);
+void 	FrameFields(FrameBuf* fb, const TaskRec* rec, UBYTE fields);
+void 	FramePut(FrameBuf* fb, ULONG value, int bytes);
+void 	FramePutVar(FrameBuf* fb, LONG value);
+void 	FrameRun(FrameBuf* fb, UBYTE op);
+void 	FrameFlushRun(FrameBuf* fb);
+ULONG 	FrameGet(FrameBuf* fb, int bytes);
+LONG 	FrameGetVar(FrameBuf* fb);
+void 	DropHistoryGroup(HistoryPort* hp);
+ULONG 	HashName(const char* name);
+void 	RememberName(HistoryPort* hp, ULONG hash, const char* name);
+void 	LookupName(const HistoryPort* hp, ULONG hash, char* name);
+int 	PrintHistory(Options* opts);
+BOOL 	DecodeFrame(FrameBuf* fb, const HistEntry* prev, ULONG prevCount, HistEntry* cur, ULONG* count, ULONG* time);
+void 	FormatTime(char* buffer, ULONG secs);
+void 	FormatVersion(char* buffer, UWORD version, UWORD revision);
 BYTE 	bstrlen(BSTR bstring);
 size_t 	bstr2cstr(BSTR bstring, char* buffer, size_t bufsize);
+size_t 	strcpyn(char* buffer, const char* string, size_t bufsize);
+void 	OutFlush(void);
+void 	OutChar(char c);
+void 	OutStr(const char* str);
+void 	OutNewline(void);
+void 	OutMsg(const char* msg);
+void 	OutField(const char* str, int width, int align);
+void 	OutNum(long num, int width, int align);
+void 	OutTenths(long num, int width, int align);
+void 	OutCursor(ULONG line);
+void 	OutBytes(const void* data, ULONG len);
+
+//--------------------------------------------------------------------------------
+// Table layouts
+//--------------------------------------------------------------------------------
+
+// System tasks/processes
+const Column sysColumns[] = {
+	{ FIELD_NUM,		 3, ALIGN_RIGHT,	IN_ALL,				HEAD_NONE,	HEAD_NUM,	0		},
+	{ FIELD_NAME,		33, ALIGN_LEFT,		IN_FULL | IN_SHORT,	HEAD_NONE,	HEAD_SYS_NAME,	0		},
+	{ FIELD_PRI,		 4, ALIGN_RIGHT,	IN_FULL | IN_TCB,	HEAD_NONE,	HEAD_PRI,	0		},
+	{ FIELD_TYPE,		 3, ALIGN_CENTER,	IN_FULL | IN_TCB,	HEAD_NONE,	HEAD_TYPE,	0		},
+	{ FIELD_CLI,		 3, ALIGN_RIGHT,	IN_FULL | IN_TCB,	HEAD_CLI,	HEAD_NUM,	0		},
+	{ FIELD_STATE,		 5, ALIGN_RIGHT,	IN_FULL | IN_TCB,	HEAD_NONE,	HEAD_STATE,	0		},
+	{ FIELD_CPU,		 5, ALIGN_RIGHT,	IN_FULL | IN_TCB,	HEAD_NONE,	HEAD_CPU,	NEED_SAMPLE	},
+	{ FIELD_STACK_USED,	 6, ALIGN_RIGHT,	IN_FULL | IN_TCB,	HEAD_STACK,	HEAD_USED,	0		},
+	{ FIELD_STACK_SIZE,	 6, ALIGN_RIGHT,	IN_FULL | IN_TCB,	HEAD_STACK,	HEAD_SIZE,	0		},
+	{ FIELD_STACK_PEAK,	 6, ALIGN_RIGHT,	IN_FULL | IN_TCB,	HEAD_STACK,	HEAD_PEAK,	NEED_HIGHWATER	},
+	{ FIELD_MEM,		 8, ALIGN_RIGHT,	IN_FULL | IN_TCB,	HEAD_NONE,	HEAD_MEM,	NEED_MEM	},
+	{ FIELD_QUEUE,		 5, ALIGN_RIGHT,	IN_FULL | IN_TCB,	HEAD_NONE,	HEAD_QUEUE,	NEED_QUEUE	},
+	{ FIELD_WAIT_PORT,	20, ALIGN_LEFT,		IN_FULL | IN_TCB,	HEAD_WAIT,	HEAD_PORT,	NEED_QUEUE	},
+	{ FIELD_WAIT_MSGS,	 5, ALIGN_RIGHT,	IN_FULL | IN_TCB,	HEAD_WAIT,	HEAD_MSGS,	NEED_QUEUE	},
+	{ FIELD_ALERT,		 5, ALIGN_LEFT,		IN_ALL,				HEAD_NONE,	HEAD_ALERT,	NEED_ALERT	},
+	{ FIELD_END }
+};
+
+// Shell/CLI processes
+const Column cliColumns[] = {
+	{ FIELD_NUM,		 3, ALIGN_RIGHT,	IN_ALL,				HEAD_NONE,	HEAD_NUM,	0		},
+	{ FIELD_COMMAND,	33, ALIGN_LEFT,		IN_FULL | IN_SHORT,	HEAD_NONE,	HEAD_CLI_NAME,	0		},
+	{ FIELD_PRI,		 4, ALIGN_RIGHT,	IN_FULL | IN_TCB,	HEAD_NONE,	HEAD_PRI,	0		},
+	{ FIELD_GLOBVEC,	 4, ALIGN_RIGHT,	IN_FULL | IN_TCB,	HEAD_NONE,	HEAD_GV,	0		},
+	{ FIELD_STACK_USED,	 6, ALIGN_RIGHT,	IN_FULL | IN_TCB,	HEAD_STACK,	HEAD_USED,	0		},
+	{ FIELD_STACK_SIZE,	 6, ALIGN_RIGHT,	IN_FULL | IN_TCB,	HEAD_STACK,	HEAD_SIZE,	0		},
+	{ FIELD_STACK_PEAK,	 6, ALIGN_RIGHT,	IN_FULL | IN_TCB,	HEAD_STACK,	HEAD_PEAK,	NEED_HIGHWATER	},
+	{ FIELD_STACK_REC,	 6, ALIGN_RIGHT,	IN_FULL | IN_TCB,	HEAD_STACK,	HEAD_REC,	NEED_HIGHWATER	},
+	{ FIELD_MEM,		 8, ALIGN_RIGHT,	IN_FULL | IN_TCB,	HEAD_NONE,	HEAD_MEM,	NEED_MEM	},
+	{ FIELD_FAILAT,		 4, ALIGN_RIGHT,	IN_FULL | IN_TCB,	HEAD_FAIL,	HEAD_LVL,	0		},
+	{ FIELD_RC,			 3, ALIGN_RIGHT,	IN_FULL | IN_TCB,	HEAD_NONE,	HEAD_RC,	0		},
+	{ FIELD_BG,			 4, ALIGN_RIGHT,	IN_FULL | IN_TCB,	HEAD_NONE,	HEAD_BG,	0		},
+	{ FIELD_QUEUE,		 5, ALIGN_RIGHT,	IN_FULL | IN_TCB,	HEAD_NONE,	HEAD_QUEUE,	NEED_QUEUE	},
+	{ FIELD_WAIT_PORT,	20, ALIGN_LEFT,		IN_FULL | IN_TCB,	HEAD_WAIT,	HEAD_PORT,	NEED_QUEUE	},
+	{ FIELD_WAIT_MSGS,	 5, ALIGN_RIGHT,	IN_FULL | IN_TCB,	HEAD_WAIT,	HEAD_MSGS,	NEED_QUEUE	},
+	{ FIELD_ALERT,		 5, ALIGN_LEFT,		IN_ALL,				HEAD_NONE,	HEAD_ALERT,	NEED_ALERT	},
+	{ FIELD_END }
+};
+
+// DAEMON history frames, one row per task per frame
+const Column histColumns[] = {
+	{ FIELD_TIME,		 8, ALIGN_RIGHT,	IN_ALL,				HEAD_NONE,	HEAD_TIME,	0		},
+	{ FIELD_NAME,		33, ALIGN_LEFT,		IN_FULL | IN_SHORT,	HEAD_NONE,	HEAD_SYS_NAME,	0		},
+	{ FIELD_PRI,		 4, ALIGN_RIGHT,	IN_FULL | IN_TCB,	HEAD_NONE,	HEAD_PRI,	0		},
+	{ FIELD_TYPE,		 3, ALIGN_CENTER,	IN_FULL | IN_TCB,	HEAD_NONE,	HEAD_TYPE,	0		},
+	{ FIELD_CLI,		 3, ALIGN_RIGHT,	IN_FULL | IN_TCB,	HEAD_CLI,	HEAD_NUM,	0		},
+	{ FIELD_STATE,		 5, ALIGN_RIGHT,	IN_FULL | IN_TCB,	HEAD_NONE,	HEAD_STATE,	0		},
+	{ FIELD_STACK_USED,	 6, ALIGN_RIGHT,	IN_FULL | IN_TCB,	HEAD_STACK,	HEAD_USED,	0		},
+	{ FIELD_STACK_SIZE,	 6, ALIGN_RIGHT,	IN_FULL | IN_TCB,	HEAD_STACK,	HEAD_SIZE,	0		},
+	{ FIELD_END }
+};
+
+// TRACE events, one row per task added or removed
+const Column traceColumns[] = {
+	{ FIELD_MSECS,		 9, ALIGN_RIGHT,	IN_ALL,				HEAD_TIME,	HEAD_MSECS,	0		},
+	{ FIELD_EVENT,		 7, ALIGN_LEFT,		IN_ALL,				HEAD_NONE,	HEAD_EVENT,	0		},
+	{ FIELD_NAME,		33, ALIGN_LEFT,		IN_FULL | IN_SHORT,	HEAD_NONE,	HEAD_SYS_NAME,	0		},
+	{ FIELD_PRI,		 4, ALIGN_RIGHT,	IN_FULL | IN_TCB,	HEAD_NONE,	HEAD_PRI,	0		},
+	{ FIELD_TYPE,		 3, ALIGN_CENTER,	IN_FULL | IN_TCB,	HEAD_NONE,	HEAD_TYPE,	0		},
+	{ FIELD_CLI,		 3, ALIGN_RIGHT,	IN_FULL | IN_TCB,	HEAD_CLI,	HEAD_NUM,	0		},
+	{ FIELD_END }
+};
+
+// Libraries & devices
+const Column libColumns[] = {
+	{ FIELD_NUM,		 3, ALIGN_RIGHT,	IN_ALL,				HEAD_NONE,	HEAD_NUM,	0		},
+	{ FIELD_NAME,		33, ALIGN_LEFT,		IN_FULL | IN_SHORT,	HEAD_NONE,	HEAD_NODE_NAME,	0		},
+	{ FIELD_PRI,		 4, ALIGN_RIGHT,	IN_FULL | IN_TCB,	HEAD_NONE,	HEAD_PRI,	0		},
+	{ FIELD_VERSION,	 8, ALIGN_RIGHT,	IN_FULL | IN_TCB,	HEAD_NONE,	HEAD_VERSION,	0		},
+	{ FIELD_OPEN,		 5, ALIGN_RIGHT,	IN_FULL | IN_TCB,	HEAD_NONE,	HEAD_OPEN,	0		},
+	{ FIELD_END }
+};
+
+// Resources. OpenResource() doesn't count its callers.
+const Column resColumns[] = {
+	{ FIELD_NUM,		 3, ALIGN_RIGHT,	IN_ALL,				HEAD_NONE,	HEAD_NUM,	0		},
+	{ FIELD_NAME,		33, ALIGN_LEFT,		IN_FULL | IN_SHORT,	HEAD_NONE,	HEAD_NODE_NAME,	0		},
+	{ FIELD_PRI,		 4, ALIGN_RIGHT,	IN_FULL | IN_TCB,	HEAD_NONE,	HEAD_PRI,	0		},
+	{ FIELD_VERSION,	 8, ALIGN_RIGHT,	IN_FULL | IN_TCB,	HEAD_NONE,	HEAD_VERSION,	0		},
+	{ FIELD_END }
+};
+
+// Public message ports
+const Column portColumns[] = {
+	{ FIELD_NUM,		 3, ALIGN_RIGHT,	IN_ALL,				HEAD_NONE,	HEAD_NUM,	0		},
+	{ FIELD_NAME,		33, ALIGN_LEFT,		IN_FULL | IN_SHORT,	HEAD_NONE,	HEAD_NODE_NAME,	0		},
+	{ FIELD_PRI,		 4, ALIGN_RIGHT,	IN_FULL | IN_TCB,	HEAD_NONE,	HEAD_PRI,	0		},
+	{ FIELD_MSGS,		 5, ALIGN_RIGHT,	IN_FULL | IN_TCB,	HEAD_NONE,	HEAD_MSGS,	0		},
+	{ FIELD_SIG_TASK,	24, ALIGN_LEFT,		IN_FULL | IN_TCB,	HEAD_SIGNAL,	HEAD_TASK,	0		},
+	{ FIELD_END }
+};
+
+// exec list tables, by LIST_* value
+const ListTable listTables[LIST_COUNT] = {
+	{ STR_LIBS_HEADING,		KEY_LIBS_TABLE,		BIN_TAG_LIBS,	libColumns	},
+	{ STR_DEVS_HEADING,		KEY_DEVS_TABLE,		BIN_TAG_DEVS,	libColumns	},
+	{ STR_PORTS_HEADING,	KEY_PORTS_TABLE,	BIN_TAG_PORTS,	portColumns	},
+	{ STR_RES_HEADING,		KEY_RES_TABLE,		BIN_TAG_RES,	resColumns	}
+};
+
+// Console output buffer
+OutBuf outBuf;
+
+// timer.device base for ReadEClock(), set while TIMING, the CPU sampler or TRACE
+// needs it
+struct Device* TimerBase = NULL;
+
+// showproc.library base, set while a snapshot is taken through it
+struct Library* ShowProcBase = NULL;
+
+// TRACE ring buffer, for the patches to find
+Tracer* tracer = NULL;
+
+// TIMING measurements & output counters
+Timing timing;
 
 
 //--------------------------------------------------------------------------------
@@ -37,87 +322,250 @@ size_t 	bstr2cstr(BSTR bstring, char* buffer, size_t bufsize);
 //--------------------------------------------------------------------------------
 int main(void)
 {
-	Mode 	mode = MODE_SYSTEM;				// Default to system tasks/processes only
-	OutFrmt format = FORMAT_VERBOSE;		// Default to verbose output
-	int		start = 1;						// Process number to start with
-	int		finish = -1;					// Process number to finish with (set later)
- 	char	cmd_pat[MAX_CMD_NAME_LEN + 1];	// Command pattern for COMMAND argument
-	BYTE	prev_program_pri = 0;			// Program priority before we change it
-	int		taskCount = 1;					// Number of tasks found
+	Options	opts = {0};						// Settings from the command line
+	Snapshot snap = {0};					// Task/process records captured under Forbid()
+	Sampler* sampler = NULL;				// CPU usage sampler (SAMPLE only)
+	ULONG	spFlags;						// SP_* flags of a snapshot showproc.library can take
+	struct 	timerequest* timer;				// Paces the SAMPLE window
+	struct 	EClockVal start;				// When the step being timed started
+	BOOL	ok;
 	int		rc;
 
+	// TIMING covers startup, so the E-clock has to be available before we know
+	// whether it was asked for. timer.device is in ROM, so this never loads
+	// anything from disk.
+	OpenTiming();
+
 	// Check minimum Kickstart & AmigaOS version requirements
-	if (CheckRequirements() == FALSE)
-		return RETURN_FAIL;
+	TimingStart(&start);
+	ok = CheckRequirements();
+	timing.checkTicks = TimingStop(&start);
+	if (!ok) {
+		rc = RETURN_FAIL;
+		goto exit;
+	}
 
 	// Set the program name for our own process
 	SetProgramName(PROGRAM);
 
 	// Parse command line arguments
-	rc = ParseCommandLineArgs(&mode, &format, &start, &finish, cmd_pat);
-	if (rc != RETURN_OK)
+	rc = ParseCommandLineArgs(&opts);
+	if (rc != RETURN_OK) {
+		// RETURN_WARN just means VERSION was shown, which isn't a failure
+		if (rc == RETURN_WARN)
+			rc = RETURN_OK;
 		goto exit;
+	}
 
-	// Capture current program priority & set the priority a bit higher to reduce
-	// the risk of changes occurring while reading task/process & CLI info
-	prev_program_pri = SetTaskPri(FindTask(NULL), PROGRAM_PRIORITY);
+	// Nothing else needs the E-clock
+	if (!opts.timing)
+		CloseTiming();
+	else if (!timing.open) {
+		OutMsg(STR_ERR_OPEN_ECLOCK);
+		rc = RETURN_FAIL;
+		goto exit;
+	}
+
+	// DAEMON keeps recording history until Ctrl-C is pressed
+	if (opts.daemon) {
+		rc = opts.daemon == DAEMON_STOP ? StopDaemon() : RunDaemon(&opts);
+		goto exit;
+	}
+
+	// HISTORY shows what the daemon has recorded
+	if (opts.history) {
+		rc = PrintHistory(&opts);
+		goto exit;
+	}
+
+	// TRACE shows the tasks being added & removed until Ctrl-C is pressed
+	if (opts.trace) {
+		rc = RunTrace(&opts);
+		if (opts.timing)
+			PrintTiming();
+		goto exit;
+	}
+
+	// MEMMAP shows how fragmented the free memory is
+	if (opts.memMap) {
+		rc = PrintMemMap(&opts);
+		if (opts.timing)
+			PrintTiming();
+		goto exit;
+	}
+
+	// A plain FORMAT=BIN or SAVE is just what showproc.library hands out, so
+	// it's taken through the library when one is installed
+	if ((spFlags = LibrarySnapshotFlags(&opts)) != 0 &&
+		(ShowProcBase = OpenLibrary(SHOWPROC_NAME, SHOWPROC_VERSION)) != NULL) {
+		rc = WriteLibrarySnapshot(&opts, spFlags);
+		CloseLibrary(ShowProcBase);
+		ShowProcBase = NULL;
+		goto exit;
+	}
+
+	// SAMPLE mode notes which task is running at regular intervals
+	if (opts.sample) {
+		if ((sampler = StartSampler()) == NULL) {
+			rc = RETURN_FAIL;
+			goto exit;
+		}
+	}
+
+	// WATCH mode keeps refreshing the display until Ctrl-C is pressed
+	if (opts.watch) {
+		rc = WatchTasks(&opts, &snap, sampler);
+		if (opts.timing)
+			PrintTiming();
+		goto exit;
+	}
+
+	// Let the sampler run for the requested window. Ctrl-C ends it early.
+	if (sampler) {
+		if ((timer = OpenTimer(UNIT_VBLANK)) == NULL) {
+			rc = RETURN_FAIL;
+			goto exit;
+		}
+		WaitTimer(timer, opts.sample / 1000, (opts.sample % 1000) * 1000);
+		CloseTimer(timer);
+	}
+
+	// LOAD shows a snapshot written by SAVE instead of taking one
+	if (opts.loaded && !opts.diff) {
+		snap.sort = opts.sort;
+		snap.top = opts.top;
+		rc = LoadSnapshot(&snap, opts.loaded, opts.loadedSize);
+		if (rc != RETURN_OK) {
+			PrintFault(ERROR_NO_FREE_STORE, NULL);
+			goto exit;
+		}
+	}
+	else {
+		// Copy everything we're going to print while holding Forbid(), so none
+		// of the console output below happens with task switching disabled
+		rc = CaptureTasks(&opts, &snap);
+		if (rc != RETURN_OK)
+			goto exit;
+	}
+
+	if (sampler) {
+		ReadSamples(sampler, &snap);
+		if (opts.sort == SORT_CPU)
+			SortSamples(&snap, opts.top);
+	}
+
+	// PRI shows the priorities it has set, instead of the tables
+	if (opts.setPri) {
+		rc = PrintPriChanges(&opts, &snap);
+		if (opts.timing)
+			PrintTiming();
+		goto exit;
+	}
+
+	// SAVE writes the records out as they are, for LOAD or DIFF to show later
+	if (opts.saveFile) {
+		rc = SaveSnapshot(&opts, &snap);
+		if (opts.timing)
+			PrintTiming();
+		goto exit;
+	}
+
+	// DIFF shows what has changed since its file was saved
+	if (opts.diff) {
+		rc = PrintDiff(&opts, &snap);
+		if (opts.timing)
+			PrintTiming();
+		goto exit;
+	}
+
+	EncodeStart(&opts);
+
+	// Room for the row & CLI numbers, however many digits they have
+	if (opts.encoding == ENCODE_TEXT)
+		WidenNumColumns(&opts, &snap);
+
+	// Free memory isn't saved
+	if ((opts.show & NEED_MEM) && opts.encoding == ENCODE_TEXT && !opts.noHead && !opts.loaded)
+		PrintMemSummary(&snap);
 
 	// Print out Shell/CLI processes
-	if (mode == MODE_ALL || mode == MODE_CLI)
+	if (opts.mode == MODE_ALL || opts.mode == MODE_CLI)
 	{
-		rc = PrintShellProcesses(mode, format, start, finish, cmd_pat);
+		rc = PrintShellProcesses(&opts, &snap);
 		if (rc != RETURN_OK)
 			goto exit;
+
+		if (opts.pickCount > 1 && opts.encoding == ENCODE_TEXT && !opts.noHead)
+			PrintProcSummary(&opts, &snap);
+
+		if (opts.breakSigs && opts.format != FORMAT_COMMAND &&
+			opts.encoding == ENCODE_TEXT && !opts.noHead)
+			PrintBreakSummary(&snap);
 	}
 
 	// Print out system tasks/processes
-	if (mode == MODE_ALL || mode == MODE_SYSTEM)
+	if (opts.mode == MODE_ALL || opts.mode == MODE_SYSTEM)
 	{
-		// Only print section header if we're showing both system & CLI processes
-		// and format is not COMMAND
-		if (mode == MODE_ALL && format != FORMAT_COMMAND)
-			Printf("\n%s\n", STR_SYS_HEADING);
-
-		// Print header based on output format
-		switch (format) {
-			case FORMAT_VERBOSE:
-				Printf(SYS_VERBOSE, SYS_VERBOSE_TOP);
-				Printf(SYS_VERBOSE, SYS_VERBOSE_BOT);
-				Printf(SYS_VERBOSE, SYS_VERBOSE_DIV);
-				break;
-			case FORMAT_TCB:
-				Printf(SYS_TCB, SYS_TCB_TOP);
-				Printf(SYS_TCB, SYS_TCB_BOT);
-				Printf(SYS_TCB, SYS_TCB_DIV);
-				break;
-			case FORMAT_SHORT:
-				Printf(SYS_SHORT, SYS_SHORT_TOP);
-				Printf(SYS_SHORT, SYS_SHORT_BOT);
-				Printf(SYS_SHORT, SYS_SHORT_DIV);
-				break;
-			default:
-				// Shouldn't get here so fail if we do
-				Printf("%s\n", STR_INV_TASK_FMT);
-				return RETURN_FAIL;
-				break;
-		}
-
-		rc = PrintThisProcess(format, &taskCount);
+		rc = PrintTaskList(&opts, &snap);
 		if (rc != RETURN_OK)
 			goto exit;
 
-		rc = PrintTaskList(format, &SysBase->TaskReady, &taskCount);
-		if (rc != RETURN_OK)
-			goto exit;
+		if (sampler && opts.encoding == ENCODE_TEXT)
+			PrintSampleSummary(&snap);
+	}
 
-		rc = PrintTaskList(format, &SysBase->TaskWait, &taskCount);
+	// Print out the exec lists
+	if (opts.lists) {
+		rc = PrintExecLists(&opts, &snap);
 		if (rc != RETURN_OK)
 			goto exit;
 	}
 
+	EncodeEnd(&opts, &snap);
+
+	if (opts.timing && opts.encoding == ENCODE_TEXT)
+		PrintTiming();
+
+	// With several PROCESS numbers, the exit code is WARN if some of them
+	// weren't found & ERROR if none were
+	if (opts.pickCount > 1 && snap.missing)
+		rc = snap.missing < opts.pickCount ? RETURN_WARN : RETURN_ERROR;
+
 exit:
-	// Restore previous program priority
-	SetTaskPri(FindTask(NULL), prev_program_pri);
+	// With ALERT, the exit code is the highest level raised by the last snapshot
+	if (rc < snap.alertLevel)
+		rc = snap.alertLevel;
+
+	if (sampler)
+		StopSampler(sampler);
+
+	CloseTiming();
+
+	FreeSnapshot(&snap);
+
+	if (snap.alerting)
+		FreeVec(snap.alerting);
+
+	if (opts.patterns)
+		FreeVec(opts.patterns);
+
+	if (opts.picks)
+		FreeVec(opts.picks);
+
+	if (opts.loaded)
+		FreeVec(opts.loaded);
+
+	if (opts.alerts)
+		FreeVec(opts.alerts);
+
+	if (opts.plans)
+		FreeVec(opts.plans);
+
+	if (opts.wideCols)
+		FreeVec(opts.wideCols);
+
+	// Write out whatever is left in the output buffer
+	OutFlush();
 
 	return rc;
 }
@@ -126,14 +574,35 @@ exit:
 //--------------------------------------------------------------------------------
 //	Parses command line arguments
 //--------------------------------------------------------------------------------
-int ParseCommandLineArgs(Mode* mode, OutFrmt* format, int* start, int* finish, char* cmd_pat)
+int ParseCommandLineArgs(Options* opts)
 {
 	struct 	RDArgs*	rdargs;
- 	long	opts[OPT_COUNT] = {0};
+	struct 	EClockVal start;
+ 	long	args[OPT_COUNT] = {0};
+	ULONG	i;
 	int		rc = RETURN_OK;
 
+	// Defaults
+	opts->mode = MODE_SYSTEM;							// System tasks/processes only
+	opts->format = FORMAT_VERBOSE;						// Verbose output
+	opts->encoding = ENCODE_TEXT;						// Text tables
+	opts->start = 1;									// Process number to start with
+	opts->finish = -1;									// Process number to finish with (set below)
+	opts->patterns = NULL;								// No COMMAND search
+	opts->patCount = 0;
+	opts->allMatches = FALSE;
+	opts->watch = 0;									// Show the tables once
+	opts->sample = 0;									// No CPU usage column
+	opts->queueMax = SNAP_MAX_MSGS;						// Message lists counted in full
+	opts->sysCols = sysColumns;							// FULL, TCB or SHORT columns
+	opts->cliCols = cliColumns;
+	for (i = 0; i < LIST_COUNT; i++)
+		opts->listCols[i] = listTables[i].columns;
+
 	// Parse command line arguments
-	rdargs = ReadArgs(TEMPLATE, opts, NULL);
+	TimingStart(&start);
+	rdargs = ReadArgs(TEMPLATE, args, NULL);
+	timing.argsTicks = TimingStop(&start);
 
 	if (rdargs == NULL) {
 		PrintFault(IoErr(), NULL);
@@ -142,499 +611,5914 @@ int ParseCommandLineArgs(Mode* mode, OutFrmt* format, int* start, int* finish, c
 	}
 
 	// VERSION argument
-	if (opts[OPT_VERSION]) {
-		Printf("%s", VSTRING);
+	if (args[OPT_VERSION]) {
+		OutStr(VSTRING);
 		rc = RETURN_WARN;  // Not an error, but we want to exit after showing version
 		goto cleanup;
 	}
 
 	// Determine mode based on arguments received
-	if (opts[OPT_CLI])		*mode = MODE_CLI;				// CLI processes only
-	if (opts[OPT_SYS])		*mode = MODE_SYSTEM;			// System processes only
-	if (opts[OPT_ALL])		*mode = MODE_ALL;				// All processes (default)
+	if (args[OPT_CLI])		opts->mode = MODE_CLI;				// CLI processes only
+	if (args[OPT_SYS])		opts->mode = MODE_SYSTEM;			// System processes only
+	if (args[OPT_ALL])		opts->mode = MODE_ALL;				// All processes (default)
 
 	// Determine output format based on arguments received
-	if (opts[OPT_SHORT])	*format = FORMAT_SHORT;
-	if (opts[OPT_TCB])		*format = FORMAT_TCB;			// Overrides SHORT and CLI/ALL
-	if (opts[OPT_FULL])		*format = FORMAT_VERBOSE;		// Overrides SHORT, CLI/ALL and TCB
+	if (args[OPT_SHORT])	opts->format = FORMAT_SHORT;
+	if (args[OPT_TCB])		opts->format = FORMAT_TCB;			// Overrides SHORT and CLI/ALL
+	if (args[OPT_FULL])		opts->format = FORMAT_VERBOSE;		// Overrides SHORT, CLI/ALL and TCB
+
+	// FORMAT argument. The tables are written as text unless CSV, JSON or BIN is given.
+	if (args[OPT_FORMAT]) {
+		if (stricmp((char*)args[OPT_FORMAT], STR_FORMAT_CSV) == 0)
+			opts->encoding = ENCODE_CSV;
+		else if (stricmp((char*)args[OPT_FORMAT], STR_FORMAT_JSON) == 0)
+			opts->encoding = ENCODE_JSON;
+		else if (stricmp((char*)args[OPT_FORMAT], STR_FORMAT_BIN) == 0)
+			opts->encoding = ENCODE_BIN;
+		else {
+			OutMsg(STR_INV_FORMAT);
+			rc = RETURN_FAIL;
+			goto cleanup;
+		}
+	}
+	opts->noHead = args[OPT_NOHEAD] ? TRUE : FALSE;
+
+	// SORT argument. The rows are shown in task list or CLI number order unless given.
+	if (args[OPT_SORT]) {
+		if (stricmp((char*)args[OPT_SORT], STR_SORT_PRI) == 0)
+			opts->sort = SORT_PRI;
+		else if (stricmp((char*)args[OPT_SORT], STR_SORT_STACK) == 0)
+			opts->sort = SORT_STACK;
+		else if (stricmp((char*)args[OPT_SORT], STR_SORT_STACKPCT) == 0)
+			opts->sort = SORT_STACKPCT;
+		else if (stricmp((char*)args[OPT_SORT], STR_SORT_NAME) == 0)
+			opts->sort = SORT_NAME;
+		else if (stricmp((char*)args[OPT_SORT], STR_SORT_STATE) == 0)
+			opts->sort = SORT_STATE;
+		else if (stricmp((char*)args[OPT_SORT], STR_SORT_MEM) == 0)
+			opts->sort = SORT_MEM;
+		else if (stricmp((char*)args[OPT_SORT], STR_SORT_CPU) == 0)
+			opts->sort = SORT_CPU;
+		else {
+			OutMsg(STR_INV_SORT);
+			rc = RETURN_FAIL;
+			goto cleanup;
+		}
+	}
+
+	// TOP argument. Only the best n rows of each table are kept while walking.
+	if (args[OPT_TOP]) {
+		if (*((long*)args[OPT_TOP]) < 1) {
+			OutMsg(STR_INV_TOP);
+			rc = RETURN_FAIL;
+			goto cleanup;
+		}
+		opts->top = *((long*)args[OPT_TOP]);
+	}
+
+	// QUEUE argument. No message or port list is walked further than this, so
+	// a runaway queue can't stretch our Forbid().
+	if (args[OPT_QUEUE]) {
+		if (*((long*)args[OPT_QUEUE]) < 1 || *((long*)args[OPT_QUEUE]) > SNAP_MAX_MSGS) {
+			OutMsg(STR_INV_QUEUE);
+			rc = RETURN_FAIL;
+			goto cleanup;
+		}
+		opts->queueMax = *((long*)args[OPT_QUEUE]);
+	}
 
-	// Handle the PROCESS argument
-	if (opts[OPT_PROCESS]) {
-		*mode = MODE_CLI;									// PROCESS only applies to CLI processes
-		*start = *finish = *((long*)opts[OPT_PROCESS]);
-		if (*start < 1 || *start > 999) {
-			Printf("%s\n", STR_INV_PROC_NUM);
+	// FLUSH argument. Output is written a buffer at a time unless LINE is given.
+	if (args[OPT_FLUSH]) {
+		if (stricmp((char*)args[OPT_FLUSH], STR_FLUSH_LINE) == 0)
+			outBuf.lineFlush = TRUE;
+		else if (stricmp((char*)args[OPT_FLUSH], STR_FLUSH_FULL) != 0) {
+			OutMsg(STR_INV_FLUSH);
 			rc = RETURN_FAIL;
 			goto cleanup;
 		}
 	}
 
-	// If the user didn't specify a specific process, set finish to the max number of
-	// CLIs, but limit to 999 to match the max width of the process number field
-	if (*start != *finish)
-		*finish = MaxCli() > 1000 ? 999 : MaxCli() - 1;  	// -1 because last one is NULL
+	// Handle the PROCESS argument. The numbers are walked from the lowest to the
+	// highest, skipping the ones that weren't asked for.
+	if (args[OPT_PROCESS]) {
+		opts->mode = MODE_CLI;								// PROCESS only applies to CLI processes
+		if (!ParseProcessNumbers(opts, (char*)args[OPT_PROCESS])) {
+			rc = RETURN_FAIL;
+			goto cleanup;
+		}
+	}
+	else {
+		// Only the CLI slots in use are walked, so there's no need to know how
+		// many there are
+		opts->finish = CLI_LAST_NUM;
+	}
 
 	// If COMMAND argument is given, override mode & format
-	if (opts[OPT_COMMAND]) {
-		*mode = MODE_CLI;									// Command search only applies to CLI processes
-		*format = FORMAT_COMMAND;							// Overrides all other formats
-		// *cmd_pat = (char*)opts[OPT_COMMAND];
-		if (!SanitizeCommandName(cmd_pat, (char*)opts[OPT_COMMAND])) {
+	if (args[OPT_COMMAND]) {
+		opts->mode = MODE_CLI;								// Command search only applies to CLI processes
+		opts->format = FORMAT_COMMAND;						// Overrides all other formats
+		opts->encoding = ENCODE_TEXT;						// Output is just the CLI number
+		if (!CompileCommandPatterns(opts, (char**)args[OPT_COMMAND])) {
 			rc = RETURN_FAIL;
 			goto cleanup;
 		}
-		*start = 1;
-		*finish = MaxCli() > 1000 ? 999 : MaxCli() - 1;  	// Search all CLIs
+		opts->allMatches = args[OPT_ALLMATCHES] ? TRUE : FALSE;
+		opts->sort = SORT_NONE;								// Every CLI is searched, in order
+		opts->top = 0;
+		opts->start = 1;
+		opts->finish = CLI_LAST_NUM;						// Search all CLIs
+		opts->pickCount = 0;
+		if (opts->picks) {
+			FreeVec(opts->picks);
+			opts->picks = NULL;
+		}
 	}
 
-cleanup:
+	// Handle the WATCH argument
+	if (args[OPT_WATCH]) {
+		opts->watch = *((long*)args[OPT_WATCH]);
+		if (opts->watch < 1 || opts->watch > WATCH_MAX_SECS) {
+			OutMsg(STR_INV_WATCH);
+			rc = RETURN_FAIL;
+			goto cleanup;
+		}
+		if (opts->format == FORMAT_COMMAND) {
+			OutMsg(STR_WATCH_COMMAND);
+			rc = RETURN_FAIL;
+			goto cleanup;
+		}
+		if (opts->encoding != ENCODE_TEXT) {
+			OutMsg(STR_WATCH_FORMAT);
+			rc = RETURN_FAIL;
+			goto cleanup;
+		}
+	}
 
-	if (rdargs)
-		FreeArgs(rdargs);
+	// Handle the SAMPLE argument
+	if (args[OPT_SAMPLE]) {
+		opts->sample = *((long*)args[OPT_SAMPLE]);
+		if (opts->sample < SAMPLE_MIN_MS || opts->sample > SAMPLE_MAX_MS) {
+			OutMsg(STR_INV_SAMPLE);
+			rc = RETURN_FAIL;
+			goto cleanup;
+		}
+		if (opts->format == FORMAT_COMMAND) {
+			OutMsg(STR_SAMPLE_COMMAND);
+			rc = RETURN_FAIL;
+			goto cleanup;
+		}
+	}
 
-	return rc;
-}
+	// CPU usage only comes from the sampler, or a file saved with it
+	if (opts->sort == SORT_CPU && !args[OPT_SAMPLE] && !args[OPT_LOAD]) {
+		OutMsg(STR_SORT_CPU_SAMPLE);
+		rc = RETURN_FAIL;
+		goto cleanup;
+	}
 
+	// Handle the DAEMON argument. 0 stops the running daemon.
+	if (args[OPT_DAEMON]) {
+		opts->daemon = *((long*)args[OPT_DAEMON]);
+		if (opts->daemon < 0 || opts->daemon > DAEMON_MAX_SECS) {
+			OutMsg(STR_INV_DAEMON);
+			rc = RETURN_FAIL;
+			goto cleanup;
+		}
+		if (args[OPT_WATCH] || args[OPT_SAMPLE] || args[OPT_COMMAND] || args[OPT_HISTORY]) {
+			OutMsg(STR_DAEMON_OPTS);
+			rc = RETURN_FAIL;
+			goto cleanup;
+		}
+		if (opts->daemon == 0)
+			opts->daemon = DAEMON_STOP;
 
-//--------------------------------------------------------------------------------
-// Sanitizes/validates the specified command name
-// Returns TRUE if the name is valid after sanitization, FALSE otherwise.
-//--------------------------------------------------------------------------------
-BOOL SanitizeCommandName(char* cleanName, const char* dirtyName)
-{
-	// Validate parameters
-	if (dirtyName == NULL || strlen(dirtyName) == 0 || strlen(dirtyName) > MAX_CMD_NAME_LEN) {
-		Printf("%s\n", STR_ERR_INV_CMD_NAME);
-		return FALSE;
+		// Frames cover every task, in address order so they can be compared
+		opts->mode = MODE_SYSTEM;
+		opts->sort = SORT_TASK;
+		opts->top = 0;
 	}
 
-	if (cleanName == NULL) {
-		Printf("%s: %s\n", STR_ERR_INV_POINTER, "cleanName");
-		return FALSE;
+	// Handle the HISTORY argument
+	if (args[OPT_HISTORY]) {
+		if (args[OPT_WATCH] || args[OPT_SAMPLE] || args[OPT_COMMAND]) {
+			OutMsg(STR_HISTORY_OPTS);
+			rc = RETURN_FAIL;
+			goto cleanup;
+		}
+		if (opts->encoding != ENCODE_TEXT && opts->encoding != ENCODE_CSV) {
+			OutMsg(STR_HISTORY_FORMAT);
+			rc = RETURN_FAIL;
+			goto cleanup;
+		}
+		opts->history = TRUE;
+	}
+
+	// Handle the ALERT argument
+	if (args[OPT_ALERT]) {
+		if (args[OPT_COMMAND] || args[OPT_DAEMON] || args[OPT_HISTORY]) {
+			OutMsg(STR_ALERT_OPTS);
+			rc = RETURN_FAIL;
+			goto cleanup;
+		}
+		if (!ParseAlertRules(opts, (char*)args[OPT_ALERT])) {
+			rc = RETURN_FAIL;
+			goto cleanup;
+		}
+	}
+
+	// Handle the BREAK argument. Repeating it on each WATCH refresh or DAEMON
+	// frame would keep breaking new processes.
+	if (args[OPT_BREAK]) {
+		if ((!args[OPT_COMMAND] && !args[OPT_PROCESS]) || args[OPT_WATCH] ||
+			args[OPT_DAEMON] || args[OPT_HISTORY]) {
+			OutMsg(STR_BREAK_OPTS);
+			rc = RETURN_FAIL;
+			goto cleanup;
+		}
+		if ((opts->breakSigs = ParseBreakSignals((char*)args[OPT_BREAK])) == 0) {
+			OutMsg(STR_INV_BREAK);
+			rc = RETURN_FAIL;
+			goto cleanup;
+		}
+	}
+
+	// Handle the PRI argument, which is a report of its own. Exactly one of
+	// COMMAND, PROCESS & NAME picks the tasks.
+	if (args[OPT_PRI]) {
+		for (i = 0; i < OPT_COUNT; i++) {
+			if (args[i] && i != OPT_PRI && i != OPT_COMMAND && i != OPT_PROCESS &&
+				i != OPT_NAME && i != OPT_ALLMATCHES && i != OPT_DRYRUN && i != OPT_NOHEAD &&
+				i != OPT_TIMING && i != OPT_FLUSH) {
+				OutMsg(STR_PRI_OPTS);
+				rc = RETURN_FAIL;
+				goto cleanup;
+			}
+		}
+		if ((args[OPT_COMMAND] != 0) + (args[OPT_PROCESS] != 0) + (args[OPT_NAME] != 0) != 1) {
+			OutMsg(STR_PRI_OPTS);
+			rc = RETURN_FAIL;
+			goto cleanup;
+		}
+		if (*((long*)args[OPT_PRI]) < -128 || *((long*)args[OPT_PRI]) > 127) {
+			OutMsg(STR_INV_PRI);
+			rc = RETURN_FAIL;
+			goto cleanup;
+		}
+
+		// NAME patterns are matched like COMMAND ones, against the system tasks
+		if (args[OPT_NAME]) {
+			opts->mode = MODE_SYSTEM;
+			if (!CompileCommandPatterns(opts, (char**)args[OPT_NAME])) {
+				rc = RETURN_FAIL;
+				goto cleanup;
+			}
+			opts->allMatches = args[OPT_ALLMATCHES] ? TRUE : FALSE;
+		}
+
+		opts->setPri = TRUE;
+		opts->newPri = (BYTE)*((long*)args[OPT_PRI]);
+		opts->dryRun = args[OPT_DRYRUN] ? TRUE : FALSE;
+	}
+	else if (args[OPT_NAME] || args[OPT_DRYRUN]) {
+		OutMsg(STR_NAME_PRI);
+		rc = RETURN_FAIL;
+		goto cleanup;
+	}
+
+	// LIBS, DEVS, PORTS & RES add tables of the exec lists. On their own, the
+	// task tables are left out.
+	if (args[OPT_LIBS])		opts->lists |= 1 << LIST_LIBS;
+	if (args[OPT_DEVS])		opts->lists |= 1 << LIST_DEVS;
+	if (args[OPT_PORTS])	opts->lists |= 1 << LIST_PORTS;
+	if (args[OPT_RES])		opts->lists |= 1 << LIST_RES;
+	if (opts->lists) {
+		if (args[OPT_WATCH] || args[OPT_COMMAND] || args[OPT_DAEMON] || args[OPT_HISTORY] ||
+			args[OPT_ALERT]) {
+			OutMsg(STR_LISTS_OPTS);
+			rc = RETURN_FAIL;
+			goto cleanup;
+		}
+		if (!args[OPT_ALL] && !args[OPT_CLI] && !args[OPT_SYS] && !args[OPT_PROCESS])
+			opts->mode = MODE_LISTS;
+	}
+
+	// MEMMAP is a report of its own
+	if (args[OPT_MEMMAP]) {
+		for (i = 0; i < OPT_COUNT; i++) {
+			if (args[i] && i != OPT_MEMMAP && i != OPT_NOHEAD && i != OPT_TIMING &&
+				i != OPT_FLUSH) {
+				OutMsg(STR_MEMMAP_OPTS);
+				rc = RETURN_FAIL;
+				goto cleanup;
+			}
+		}
+		opts->memMap = TRUE;
 	}
 
-	// Copy the dirty name to the clean name buffer
-	strncpy(cleanName, dirtyName, MAX_CMD_NAME_LEN);
-	cleanName[MAX_CMD_NAME_LEN] = '\0';				// Ensure null termination
+	// TRACE is a report of its own too, & is written out as it goes
+	if (args[OPT_TRACE]) {
+		for (i = 0; i < OPT_COUNT; i++) {
+			if (args[i] && i != OPT_TRACE && i != OPT_ALL && i != OPT_CLI && i != OPT_SYS &&
+				i != OPT_FULL && i != OPT_TCB && i != OPT_SHORT && i != OPT_FORMAT &&
+				i != OPT_NOHEAD && i != OPT_TIMING && i != OPT_FLUSH) {
+				OutMsg(STR_TRACE_OPTS);
+				rc = RETURN_FAIL;
+				goto cleanup;
+			}
+		}
+		if (opts->encoding != ENCODE_TEXT && opts->encoding != ENCODE_CSV) {
+			OutMsg(STR_TRACE_FORMAT);
+			rc = RETURN_FAIL;
+			goto cleanup;
+		}
+		opts->trace = TRUE;
+	}
+
+	// Handle the SAVE argument. Every field is saved, so the file can be shown
+	// in any format later on.
+	if (args[OPT_SAVE]) {
+		if (args[OPT_LOAD] || args[OPT_DIFF] || args[OPT_WATCH] || args[OPT_COMMAND] ||
+			args[OPT_DAEMON] || args[OPT_HISTORY] || args[OPT_BREAK] || args[OPT_FORMAT] ||
+			args[OPT_COLS]) {
+			OutMsg(STR_SAVE_OPTS);
+			rc = RETURN_FAIL;
+			goto cleanup;
+		}
+		opts->saveFile = (char*)args[OPT_SAVE];
+	}
+
+	// Handle the LOAD & DIFF arguments. The tables are the ones in the file.
+	// DIFF shows the tasks in the order they're found.
+	if (args[OPT_LOAD] || args[OPT_DIFF]) {
+		if ((args[OPT_LOAD] && args[OPT_DIFF]) || args[OPT_ALL] || args[OPT_CLI] ||
+			args[OPT_SYS] || args[OPT_PROCESS] || opts->lists || args[OPT_WATCH] ||
+			args[OPT_SAMPLE] || args[OPT_COMMAND] || args[OPT_DAEMON] || args[OPT_HISTORY] ||
+			args[OPT_ALERT] || args[OPT_BREAK]) {
+			OutMsg(STR_LOAD_OPTS);
+			rc = RETURN_FAIL;
+			goto cleanup;
+		}
+		if (args[OPT_DIFF]) {
+			if (args[OPT_FORMAT] || args[OPT_COLS]) {
+				OutMsg(STR_DIFF_FORMAT);
+				rc = RETURN_FAIL;
+				goto cleanup;
+			}
+			opts->diff = TRUE;
+			opts->sort = SORT_NONE;
+			opts->top = 0;
+		}
+		if (!ReadSnapshotFile(opts, (char*)(opts->diff ? args[OPT_DIFF] : args[OPT_LOAD]))) {
+			rc = RETURN_FAIL;
+			goto cleanup;
+		}
+	}
+
+	// Handle the COLS argument, which replaces the columns of FULL, TCB or SHORT
+	if (args[OPT_COLS]) {
+		if (opts->format == FORMAT_COMMAND || opts->daemon || opts->history ||
+			opts->encoding == ENCODE_BIN) {
+			OutMsg(STR_COLS_OPTS);
+			rc = RETURN_FAIL;
+			goto cleanup;
+		}
+		if (!PlanColumns(opts, (char*)args[OPT_COLS])) {
+			rc = RETURN_FAIL;
+			goto cleanup;
+		}
+	}
+
+	// Handle the TIMING argument. Its report would break up CSV & BIN output.
+	if (args[OPT_TIMING]) {
+		if (opts->encoding == ENCODE_CSV || opts->encoding == ENCODE_BIN) {
+			OutMsg(STR_TIMING_FORMAT);
+			rc = RETURN_FAIL;
+			goto cleanup;
+		}
+		opts->timing = TRUE;
+	}
+
+	// Columns to show. COLS has already added what its columns need.
+	opts->show |= 1 << opts->format;
+	if (opts->sample)
+		opts->show |= NEED_SAMPLE;
+	if (args[OPT_HIGHWATER] && !opts->daemon)
+		opts->show |= NEED_HIGHWATER;				// Frames don't record the peak
+	if ((args[OPT_MEM] || opts->sort == SORT_MEM) && !opts->daemon)
+		opts->show |= NEED_MEM;
+	if (args[OPT_QUEUE] && !opts->daemon)
+		opts->show |= NEED_QUEUE;
+	if (opts->alertCount) {
+		opts->show |= NEED_ALERT;
+		for (i = 0; i < opts->alertCount; i++) {
+			if (opts->alerts[i].field == ALERT_MEM)
+				opts->show |= NEED_MEM;
+		}
+	}
+
+	// Fields to leave out of the walk. COMMAND, DAEMON, HISTORY & PRI use the
+	// name without showing it, and BIN records & SAVE & DIFF files have every
+	// field.
+	if (opts->format != FORMAT_COMMAND && !opts->daemon && !opts->history && !opts->setPri &&
+		opts->encoding != ENCODE_BIN && !opts->saveFile && !opts->diff)
+		opts->skip = UnshownFields(opts);
+
+	// Tables to show, so the headings are only added when there's more than one
+	opts->tables = opts->mode == MODE_ALL ? 2 : opts->mode == MODE_LISTS ? 0 : 1;
+	for (i = 0; i < LIST_COUNT; i++) {
+		if (opts->lists & (1 << i))
+			opts->tables++;
+	}
+
+cleanup:
+
+	if (rdargs)
+		FreeArgs(rdargs);
+
+	return rc;
+}
+
+
+//--------------------------------------------------------------------------------
+// Sanitizes/validates the specified command name
+// Returns TRUE if the name is valid after sanitization, FALSE otherwise.
+// Nothing is output, so the snapshot API can use it too.
+//--------------------------------------------------------------------------------
+BOOL SanitizeCommandName(char* cleanName, const char* dirtyName)
+{
+	// Validate parameters
+	if (dirtyName == NULL || strlen(dirtyName) == 0 || strlen(dirtyName) > MAX_CMD_NAME_LEN)
+		return FALSE;
+
+	if (cleanName == NULL)
+		return FALSE;
+
+	// Copy the dirty name to the clean name buffer
+	strncpy(cleanName, dirtyName, MAX_CMD_NAME_LEN);
+	cleanName[MAX_CMD_NAME_LEN] = '\0';				// Ensure null termination
+
+	// ReadArgs already filters out invalid characters, so we don't need to do
+	// that here. Instead, we can just check for a trailing colon & remove it.
+	if (cleanName[strlen(cleanName) - 1] == ':') {
+		cleanName[strlen(cleanName) - 1] = '\0';
+	}
+
+	return TRUE;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Takes a snapshot of the tasks/processes to show. Our priority is only raised
+//	while the snapshot is taken, so the formatting (and in WATCH mode, the
+//	waiting) is done at the priority we were started with.
+//--------------------------------------------------------------------------------
+int CaptureTasks(Options* opts, Snapshot* snap)
+{
+	BYTE	prev_program_pri;			// Program priority before we change it
+	int		rc;
+
+	// Capture current program priority & set the priority a bit higher to reduce
+	// the risk of changes occurring while reading task/process & CLI info
+	prev_program_pri = SetTaskPri(FindTask(NULL), PROGRAM_PRIORITY);
+
+	snap->show = opts->show;
+	snap->sort = opts->sort;
+	snap->top = opts->sort == SORT_CPU ? 0 : opts->top;		// SortSamples() applies it
+	snap->queueMax = opts->queueMax;
+	snap->alerts = opts->alerts;
+	snap->alertCount = opts->alertCount;
+	snap->lists = opts->lists;
+	snap->skip = opts->skip;
+	snap->picks = opts->picks;
+	snap->patterns = opts->patterns;
+	snap->patCount = opts->patCount;
+	snap->allMatches = opts->allMatches;
+	snap->breakSigs = opts->breakSigs;
+	snap->setPri = opts->setPri;
+	snap->newPri = opts->newPri;
+	snap->dryRun = opts->dryRun;
+	rc = TakeSnapshot(snap, opts->mode, opts->start, opts->finish);
+
+	// Restore previous program priority
+	SetTaskPri(FindTask(NULL), prev_program_pri);
+
+	if (rc == RETURN_OK && snap->alertCount)
+		rc = SettleAlerts(snap);
+
+	// The only way a snapshot can fail
+	if (rc != RETURN_OK)
+		PrintFault(ERROR_NO_FREE_STORE, NULL);
+
+	return rc;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Copies the tasks/processes & Shell/CLI processes selected by mode into the
+//	snapshot. The arena is sized from the previous walk's count; if the system
+//	has grown since then, it is enlarged once and the walk is repeated. The
+//	records are put in SORT order after Permit(). Nothing is output, so the
+//	snapshot API can use it too. Returns RETURN_FAIL if out of memory.
+//--------------------------------------------------------------------------------
+int TakeSnapshot(Snapshot* snap, Mode mode, int start, int finish)
+{
+	struct 	EClockVal started;
+	ULONG	ticks;
+
+	if (snap->needed == 0)
+		snap->needed = SNAP_INITIAL_RECS;
+
+	for (;;)
+	{
+		// (Re)allocate the arena outside of Forbid() if the last walk didn't fit
+		if (snap->needed > snap->capacity) {
+			FreeSnapshot(snap);
+			snap->capacity = snap->needed + SNAP_SLACK_RECS;
+			snap->recs = AllocVec(snap->capacity * sizeof(TaskRec), MEMF_ANY);
+			if (snap->recs == NULL) {
+				snap->capacity = 0;
+				return RETURN_FAIL;
+			}
+		}
+
+		snap->needed = 0;
+		snap->walked = 0;
+		snap->base = 0;
+		snap->kept = 0;
+		snap->sysCount = 0;
+		snap->cliCount = 0;
+		snap->missing = 0;
+		snap->broken = 0;
+		snap->repri = 0;
+
+		// AvailMem() holds its own Forbid() while it walks the free lists, so
+		// that isn't added to ours
+		if (snap->show & NEED_MEM) {
+			snap->mem.chip = AvailMem(MEMF_CHIP);
+			snap->mem.chipLargest = AvailMem(MEMF_CHIP | MEMF_LARGEST);
+			snap->mem.fast = AvailMem(MEMF_FAST);
+			snap->mem.fastLargest = AvailMem(MEMF_FAST | MEMF_LARGEST);
+		}
+
+		// Only memory copies are done in here; no dos.library calls that could
+		// wait and break the Forbid()
+		TimingStart(&started);
+		Forbid();
+		{
+			if (mode == MODE_ALL || mode == MODE_SYSTEM) {
+				SnapThisProcess(snap);
+				SnapTaskList(snap, &SysBase->TaskReady);
+				SnapTaskList(snap, &SysBase->TaskWait);
+				snap->sysCount = snap->kept;
+			}
+
+			// The Shell/CLI table starts after the system one
+			snap->base = snap->sysCount;
+			snap->kept = 0;
+
+			// dos.library only changes its CLI list under Forbid()
+			if (mode == MODE_ALL || mode == MODE_CLI)
+				SnapShellProcesses(snap, start, finish);
+
+			snap->cliCount = snap->kept;
+
+			// Signalled while the Forbid() still guarantees the tasks exist, &
+			// only once the walk has fit, so no process is signalled twice
+			if (snap->breakSigs && snap->needed <= snap->capacity)
+				BreakShellProcesses(snap);
+
+			// Likewise for PRI, so the priority is set on the task that was found
+			if (snap->setPri && snap->needed <= snap->capacity)
+				SetTaskPris(snap);
+
+			// In the same Forbid(), so the lists are consistent with the tasks
+			// & each other
+			SnapExecLists(snap);
+		} // End Forbid() section
+		Permit();
+
+		ticks = TimingStop(&started);
+		timing.forbids++;
+		timing.forbidTicks += ticks;
+		if (ticks > timing.forbidMaxTicks)
+			timing.forbidMaxTicks = ticks;
+
+		if (snap->needed <= snap->capacity) {
+			SortSnapshot(snap);
+			return RETURN_OK;
+		}
+	}
+}
+
+
+//--------------------------------------------------------------------------------
+//	Puts each table of the snapshot in SORT order. With TOP, the tables are
+//	already heaps.
+//--------------------------------------------------------------------------------
+void SortSnapshot(Snapshot* snap)
+{
+	ULONG	i;
+
+	if (snap->sort == SORT_NONE && !snap->top)
+		return;
+
+	SortTaskRecs(snap->recs, snap->sysCount, snap->sort, snap->top != 0);
+	SortTaskRecs(&snap->recs[snap->sysCount], snap->cliCount, snap->sort, snap->top != 0);
+	for (i = 0; i < LIST_COUNT; i++)
+		SortTaskRecs(&snap->recs[snap->listFirst[i]], snap->listCount[i],
+					 snap->sort, snap->top != 0);
+}
+
+
+//--------------------------------------------------------------------------------
+//	Frees the snapshot's record arena.
+//--------------------------------------------------------------------------------
+void FreeSnapshot(Snapshot* snap)
+{
+	if (snap->recs) {
+		FreeVec(snap->recs);
+		snap->recs = NULL;
+	}
+	snap->capacity = 0;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Returns the next free record in the snapshot, or NULL if the arena is full.
+//	Records are counted either way so the arena can be resized for the next walk.
+//	Once the TOP heap is full, this is the scratch record after it. The record
+//	must be handed to KeepTaskRec() once it has been filled in.
+//--------------------------------------------------------------------------------
+TaskRec* NewTaskRec(Snapshot* snap)
+{
+	TaskRec* rec;
+	ULONG	index;
+
+	index = snap->base + (snap->top && snap->kept >= snap->top ? snap->top : snap->kept);
+	if (index >= snap->needed)
+		snap->needed = index + 1;
+	snap->walked++;
+
+	if (index >= snap->capacity) {
+		if (!snap->top || snap->kept < snap->top)
+			snap->kept++;
+		return NULL;
+	}
+
+	rec = &snap->recs[index];
+	rec->task = NULL;
+	rec->cliNum = 0;
+	rec->stackUsed = 0;
+	rec->stackSize = 0;
+	rec->stackPeak = 0;
+	rec->defaultStack = 0;
+	rec->globVec = 0;
+	rec->failLevel = 0;
+	rec->returnCode = 0;
+	rec->mem = 0;
+	rec->pri = 0;
+	rec->type = NT_TASK;
+	rec->state = TS_INVALID;
+	rec->flags = 0;
+	rec->cpu = 0;
+	rec->alert = 0;
+	rec->action = PA_SIGNAL;
+	rec->version = 0;
+	rec->revision = 0;
+	rec->openCount = 0;
+	rec->msgCount = 0;
+	rec->queueCount = 0;
+	rec->waitCount = 0;
+	rec->seq = snap->walked;
+	rec->name[0] = '\0';
+	rec->sigTask[0] = '\0';
+	rec->waitPort[0] = '\0';
+
+	return rec;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Adds the record returned by NewTaskRec() to the table being walked. With TOP,
+//	it goes into the heap while there's room, and after that only replaces the
+//	worst record kept if it sorts before it. With ALERT, records that won't be
+//	shown are dropped, so they don't take up a TOP slot either. Must be called
+//	under Forbid().
+//--------------------------------------------------------------------------------
+void KeepTaskRec(Snapshot* snap, TaskRec* rec)
+{
+	TaskRec* heap = &snap->recs[snap->base];
+
+	if (snap->alertCount && !CheckAlerts(snap, rec))
+		return;
+
+	if (!snap->top) {
+		snap->kept++;
+	}
+	else if (snap->kept < snap->top) {
+		SiftUp(heap, snap->kept++, snap->sort);
+	}
+	else if (CompareTaskRecs(rec, &heap[0], snap->sort) < 0) {
+		heap[0] = *rec;
+		SiftDown(heap, 0, snap->top, snap->sort);
+	}
+}
+
+
+//--------------------------------------------------------------------------------
+//	Sets the highest ALERT level the record raises. A record that raises none but
+//	hasn't gone far enough back past a threshold to clear it keeps that level if
+//	its task was shown by the previous snapshot, so a value hovering around a
+//	threshold doesn't keep coming & going in WATCH mode. Returns FALSE if the
+//	record is left with no level, so it can be dropped before it takes a TOP
+//	slot. Our own process is never reported, as its priority is raised while the
+//	snapshot is taken. Must be called under Forbid().
+//--------------------------------------------------------------------------------
+BOOL CheckAlerts(Snapshot* snap, TaskRec* rec)
+{
+	const AlertRule* rule;
+	LONG	value;
+	ULONG	i;
+	UBYTE	hold = 0;
+
+	// Shown as an error, like without ALERT
+	if (rec->flags & REC_MISSING)
+		return TRUE;
+
+	if (rec->task == FindTask(NULL))
+		return FALSE;
+
+	for (i = 0; i < snap->alertCount; i++)
+	{
+		rule = &snap->alerts[i];
+		switch (rule->field)
+		{
+			case ALERT_STACK:		value = StackDepth(rec);	break;
+			case ALERT_STACKPCT:	value = StackPercent(rec);	break;
+			case ALERT_PRI:			value = rec->pri;			break;
+			default:				value = rec->mem;			break;
+		}
+
+		if ((rule->above ? value >= rule->raise : value <= rule->raise) && rule->level > rec->alert)
+			rec->alert = rule->level;
+		if ((rule->above ? value >= rule->clear : value <= rule->clear) && rule->level > hold)
+			hold = rule->level;
+	}
+
+	// Only a few tasks should be alerting at once, so a linear search will do
+	for (i = 0; !rec->alert && hold && i < snap->alertingCount; i++) {
+		if (snap->alerting[i] == rec->task)
+			rec->alert = hold;
+	}
+
+	return rec->alert != 0;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Remembers the tasks shown with an alert for the next snapshot, and notes the
+//	highest level raised. Returns RETURN_FAIL if out of memory.
+//--------------------------------------------------------------------------------
+int SettleAlerts(Snapshot* snap)
+{
+	struct 	Task** alerting = NULL;
+	ULONG	count = snap->sysCount + snap->cliCount;
+	ULONG	found = 0;
+	ULONG	i;
+
+	if (count) {
+		alerting = AllocVec(count * sizeof(struct Task*), MEMF_ANY);
+		if (alerting == NULL)
+			return RETURN_FAIL;
+	}
+
+	// The Shell/CLI table follows the system one
+	snap->alertLevel = 0;
+	for (i = 0; i < count; i++)
+	{
+		if (!snap->recs[i].alert)
+			continue;	// Go to next record
+
+		alerting[found++] = snap->recs[i].task;
+		if (snap->recs[i].alert > snap->alertLevel)
+			snap->alertLevel = snap->recs[i].alert;
+	}
+
+	if (snap->alerting)
+		FreeVec(snap->alerting);
+	snap->alerting = alerting;
+	snap->alertingCount = found;
+
+	return RETURN_OK;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Compares two records by the given sort key. Returns < 0 if a is shown before
+//	b, > 0 if it's shown after it. Ties are shown in the order they were walked.
+//--------------------------------------------------------------------------------
+int CompareTaskRecs(const TaskRec* a, const TaskRec* b, SortKey sort)
+{
+	LONG	diff = 0;
+
+	switch (sort)
+	{
+		case SORT_PRI:
+			diff = (LONG)b->pri - (LONG)a->pri;
+			break;
+
+		case SORT_STACK:
+			diff = StackDepth(b) - StackDepth(a);
+			break;
+
+		case SORT_STACKPCT:
+			diff = StackPercent(b) - StackPercent(a);
+			break;
+
+		case SORT_MEM:
+			diff = b->mem < a->mem ? -1 : b->mem > a->mem;
+			break;
+
+		case SORT_CPU:
+			diff = (LONG)b->cpu - (LONG)a->cpu;
+			break;
+
+		case SORT_NAME:
+			diff = stricmp((char*)a->name, (char*)b->name);
+			break;
+
+		case SORT_STATE:
+			diff = StateRank(a->state) - StateRank(b->state);
+			break;
+
+		case SORT_TASK:
+			diff = (ULONG)a->task < (ULONG)b->task ? -1 : (ULONG)a->task > (ULONG)b->task;
+			break;
+
+		default:
+			break;
+	}
+
+	if (diff != 0)
+		return diff < 0 ? -1 : 1;
+
+	return a->seq < b->seq ? -1 : a->seq > b->seq ? 1 : 0;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Returns the most stack the record's task is known to have used.
+//--------------------------------------------------------------------------------
+LONG StackDepth(const TaskRec* rec)
+{
+	return rec->stackPeak > rec->stackUsed ? rec->stackPeak : rec->stackUsed;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Returns the share of its stack the record's task has used, in tenths of a
+//	percent.
+//--------------------------------------------------------------------------------
+LONG StackPercent(const TaskRec* rec)
+{
+	ULONG	depth = StackDepth(rec) > 0 ? StackDepth(rec) : 0;
+	ULONG	size = rec->stackSize > 0 ? rec->stackSize : 0;
+
+	// Scale both down until depth * 1000 fits, so no 64-bit maths is needed
+	while (depth > 0x3FFFFF) {
+		depth >>= 4;
+		size >>= 4;
+	}
+
+	return size ? (LONG)(depth * 1000 / size) : 0;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Returns where a task in the given state is shown by SORT=STATE.
+//--------------------------------------------------------------------------------
+LONG StateRank(UBYTE state)
+{
+	switch (state)
+	{
+		case TS_RUN:		return 0;
+		case TS_READY:		return 1;
+		case TS_EXCEPT:		return 2;
+		case TS_WAIT:		return 3;
+		case TS_ADDED:		return 4;
+		case TS_REMOVED:	return 5;
+		default:			return 6;
+	}
+}
+
+
+//--------------------------------------------------------------------------------
+//	Moves heap[i] up towards the root until its parent sorts after it. The root
+//	of the heap is the record shown last.
+//--------------------------------------------------------------------------------
+void SiftUp(TaskRec* heap, ULONG i, SortKey sort)
+{
+	TaskRec	temp;
+	ULONG	parent;
+
+	while (i > 0) {
+		parent = (i - 1) / 2;
+		if (CompareTaskRecs(&heap[parent], &heap[i], sort) >= 0)
+			break;
+		temp = heap[parent];
+		heap[parent] = heap[i];
+		heap[i] = temp;
+		i = parent;
+	}
+}
+
+
+//--------------------------------------------------------------------------------
+//	Moves heap[i] down away from the root until both its children sort before it.
+//--------------------------------------------------------------------------------
+void SiftDown(TaskRec* heap, ULONG i, ULONG count, SortKey sort)
+{
+	TaskRec	temp;
+	ULONG	child;
+
+	while ((child = i * 2 + 1) < count) {
+		if (child + 1 < count && CompareTaskRecs(&heap[child + 1], &heap[child], sort) > 0)
+			child++;
+		if (CompareTaskRecs(&heap[child], &heap[i], sort) <= 0)
+			break;
+		temp = heap[child];
+		heap[child] = heap[i];
+		heap[i] = temp;
+		i = child;
+	}
+}
+
+
+//--------------------------------------------------------------------------------
+//	Heapsorts the records into the order they're shown in. Records kept with TOP
+//	are already a heap. Done in place, so there's nothing to allocate.
+//--------------------------------------------------------------------------------
+void SortTaskRecs(TaskRec* recs, ULONG count, SortKey sort, BOOL isHeap)
+{
+	TaskRec	temp;
+	ULONG	i;
+
+	if (count < 2)
+		return;
+
+	if (!isHeap) {
+		for (i = count / 2; i > 0; i--)
+			SiftDown(recs, i - 1, count, sort);
+	}
+
+	for (i = count - 1; i > 0; i--) {
+		temp = recs[0];
+		recs[0] = recs[i];
+		recs[i] = temp;
+		SiftDown(recs, 0, i, sort);
+	}
+}
+
+
+//--------------------------------------------------------------------------------
+//	Copies our own process into the snapshot. It's running, so it isn't in
+//	either of the exec task lists. Must be called under Forbid().
+//--------------------------------------------------------------------------------
+void SnapThisProcess(Snapshot* snap)
+{
+	TaskRec* rec;
+
+	if ((rec = NewTaskRec(snap)) != NULL) {
+		SnapProcess(snap, rec, (struct Process*)FindTask(NULL));
+		KeepTaskRec(snap, rec);
+	}
+}
+
+
+//--------------------------------------------------------------------------------
+//	Copies all tasks & processes in the given task list into the snapshot.
+//	Must be called under Forbid().
+//--------------------------------------------------------------------------------
+void SnapTaskList(Snapshot* snap, struct List* taskList)
+{
+	struct 	Node* node;
+	struct 	Task* task;
+	TaskRec* rec;
+
+	// Traverse the task list
+	for (node = taskList->lh_Head; node->ln_Succ != NULL; node = node->ln_Succ)
+	{
+		if ((rec = NewTaskRec(snap)) == NULL)
+			continue;	// Arena is full, just keep counting
+
+		task = (struct Task*)node;
+		rec->type = node->ln_Type;
+
+		// Determine what type of node this is (i.e. task or process)
+		switch (node->ln_Type)
+		{
+			case NT_TASK:
+				rec->task = task;
+				rec->pri = task->tc_Node.ln_Pri;
+				rec->state = task->tc_State;
+				rec->stackUsed = (long)task->tc_SPUpper - (long)task->tc_SPReg;
+				rec->stackSize = (long)task->tc_SPUpper - (long)task->tc_SPLower;
+				if (snap->show & NEED_HIGHWATER)
+					rec->stackPeak = StackHighWater(task);
+				if (snap->show & NEED_MEM)
+					rec->mem = TaskMemory(task);
+				if (snap->show & NEED_QUEUE)
+					SnapWaitPort(snap, rec, task);
+				if (!(snap->skip & FIELD_BIT(FIELD_NAME)))
+					strcpyn(rec->name, task->tc_Node.ln_Name, sizeof(rec->name));
+				break;
+
+			case NT_PROCESS:
+				SnapProcess(snap, rec, (struct Process*)node);
+				break;
+
+			default:
+				// Reported as an invalid task type when printed
+				break;
+		}
+
+		KeepTaskRec(snap, rec);
+	}
+}
+
+
+//--------------------------------------------------------------------------------
+//	Copies the exec lists selected by snap->lists into the snapshot, each as a
+//	table of its own after the Shell/CLI one. Must be called under Forbid().
+//--------------------------------------------------------------------------------
+void SnapExecLists(Snapshot* snap)
+{
+	struct 	List* lists[LIST_COUNT];
+	ULONG	i;
+
+	lists[LIST_LIBS] = &SysBase->LibList;
+	lists[LIST_DEVS] = &SysBase->DeviceList;
+	lists[LIST_PORTS] = &SysBase->PortList;
+	lists[LIST_RES] = &SysBase->ResourceList;
+
+	for (i = 0; i < LIST_COUNT; i++)
+	{
+		// Each table starts after the one before
+		snap->base += snap->kept;
+		snap->kept = 0;
+
+		if (snap->lists & (1 << i))
+			SnapExecList(snap, lists[i], (ExecList)i);
+
+		snap->listFirst[i] = snap->base;
+		snap->listCount[i] = snap->kept;
+	}
+}
+
+
+//--------------------------------------------------------------------------------
+//	Copies the nodes of one exec list into the snapshot. Libraries, devices &
+//	resources all start with a struct Library. Must be called under Forbid().
+//--------------------------------------------------------------------------------
+void SnapExecList(Snapshot* snap, struct List* list, ExecList which)
+{
+	struct 	Node* node;
+	struct 	Library* lib;
+	struct 	MsgPort* port;
+	TaskRec* rec;
+
+	for (node = list->lh_Head; node->ln_Succ != NULL; node = node->ln_Succ)
+	{
+		if ((rec = NewTaskRec(snap)) == NULL)
+			continue;	// Arena is full, just keep counting
+
+		rec->task = (struct Task*)node;
+		rec->type = node->ln_Type;
+		rec->pri = node->ln_Pri;
+		rec->flags = REC_NODE;
+		strcpyn(rec->name, node->ln_Name, sizeof(rec->name));
+
+		if (which == LIST_PORTS) {
+			port = (struct MsgPort*)node;
+			rec->action = port->mp_Flags & PF_ACTION;
+			if (rec->action == PA_SIGNAL && port->mp_SigTask != NULL)
+				strcpyn(rec->sigTask, ((struct Task*)port->mp_SigTask)->tc_Node.ln_Name,
+						sizeof(rec->sigTask));
+
+			rec->msgCount = CountMessages(port, snap->queueMax);
+		}
+		else {
+			lib = (struct Library*)node;
+			rec->version = lib->lib_Version;
+			rec->revision = lib->lib_Revision;
+			rec->openCount = lib->lib_OpenCnt;
+		}
+
+		KeepTaskRec(snap, rec);
+	}
+}
+
+
+//--------------------------------------------------------------------------------
+//	Copies the Shell/CLI processes numbered start to finish into the snapshot.
+//	dos.library's CLI list is walked directly, rather than calling FindCliProc()
+//	for every number, so only the slots in use are visited however many there
+//	are. With PROCESS, only the numbers picked are copied, and the ones that
+//	don't exist are recorded too. Must be called under Forbid().
+//--------------------------------------------------------------------------------
+void SnapShellProcesses(Snapshot* snap, int start, int finish)
+{
+	struct 	RootNode* root = ((struct DosLibrary*)DOSBase)->dl_Root;
+	struct 	CliProcList* list;
+	struct 	MsgPort** ports;
+	TaskRec* rec;
+	long 	next = start;							// Lowest number not walked yet
+	long 	num;
+	long 	slot;
+	long 	last;
+
+	// Each list holds the message ports of a run of CLI numbers, lowest first.
+	// Slot 0 is the number of slots.
+	for (list = (struct CliProcList*)root->rn_CliList.mlh_Head;
+		 list->cpl_Node.mln_Succ != NULL && list->cpl_First <= finish;
+		 list = (struct CliProcList*)list->cpl_Node.mln_Succ)
+	{
+		ports = list->cpl_Array;
+		slot = next > list->cpl_First ? next - list->cpl_First + 1 : 1;
+		last = (long)(ULONG)ports[0];
+		if (last > finish - list->cpl_First + 1)
+			last = finish - list->cpl_First + 1;
+
+		for (; slot <= last; slot++)
+		{
+			if (ports[slot] == NULL)
+				continue;	// Slot not in use
+
+			num = list->cpl_First + slot - 1;
+			if (snap->picks && !PICKED(snap->picks, num))
+				continue;	// Not asked for
+
+			SnapMissingProcesses(snap, next, num - 1);
+			next = num + 1;
+
+			if ((rec = NewTaskRec(snap)) == NULL)
+				continue;	// Arena is full, just keep counting
+
+			// The port is the process's own, so it signals the process
+			SnapShellProcess(snap, rec, num, (struct Process*)ports[slot]->mp_SigTask);
+			KeepTaskRec(snap, rec);
+		}
+	}
+
+	SnapMissingProcesses(snap, next, finish);
+}
+
+
+//--------------------------------------------------------------------------------
+//	Records the PROCESS numbers from start to finish as missing, so an error
+//	message can be shown for each one. If we're scanning all processes, there
+//	is nothing to record. Must be called under Forbid().
+//--------------------------------------------------------------------------------
+void SnapMissingProcesses(Snapshot* snap, long start, long finish)
+{
+	TaskRec* rec;
+	long 	num;
+
+	if (snap->picks == NULL)
+		return;
+
+	for (num = start; num <= finish; num++)
+	{
+		if (!PICKED(snap->picks, num))
+			continue;	// Not asked for
+
+		snap->missing++;
+
+		if ((rec = NewTaskRec(snap)) == NULL)
+			continue;	// Arena is full, just keep counting
+
+		SnapShellProcess(snap, rec, num, NULL);
+		KeepTaskRec(snap, rec);
+	}
+}
+
+
+//--------------------------------------------------------------------------------
+//	Sends the BREAK signals to the Shell/CLI processes in the snapshot. With
+//	COMMAND, only the ones whose command matches are signalled, and only the
+//	first unless ALLMATCHES was given. Our own process is never signalled. Must
+//	be called under Forbid(), in the same one as the walk.
+//--------------------------------------------------------------------------------
+void BreakShellProcesses(Snapshot* snap)
+{
+	struct 	Task* self = FindTask(NULL);
+	TaskRec* rec;
+	ULONG	i;
+
+	for (i = 0; i < snap->cliCount; i++)
+	{
+		rec = &snap->recs[snap->sysCount + i];
+
+		if (rec->flags & (REC_MISSING | REC_NO_CLI) || rec->task == self)
+			continue;	// Go to next process
+
+		if (snap->patterns) {
+			if (rec->flags & REC_NO_COMMAND ||
+				!CheckCommandMatch(rec->name, snap->patterns, snap->patCount))
+				continue;	// Go to next process
+		}
+
+		Signal(rec->task, snap->breakSigs);
+		rec->flags |= REC_BROKEN;
+		snap->broken++;
+
+		if (snap->patterns && !snap->allMatches)
+			break;	// Exit the for loop
+	}
+}
+
+
+//--------------------------------------------------------------------------------
+//	Sets the PRI priority of the tasks in the snapshot, or with DRYRUN only
+//	marks them. They are the Shell/CLI processes found by PROCESS or COMMAND,
+//	or the system tasks found by NAME, leaving out the Shell/CLI processes in
+//	the system list. With patterns, only the first match is changed unless
+//	ALLMATCHES was given. Our own process is never changed. The record keeps
+//	the old priority. Must be called under Forbid(), in the same one as the walk.
+//--------------------------------------------------------------------------------
+void SetTaskPris(Snapshot* snap)
+{
+	struct 	Task* self = FindTask(NULL);
+	TaskRec* rec;
+	ULONG	i;
+
+	for (i = 0; i < snap->sysCount + snap->cliCount; i++)
+	{
+		rec = &snap->recs[i];
+
+		if (rec->flags & (REC_MISSING | REC_NO_CLI) || rec->task == self ||
+			(i < snap->sysCount && rec->cliNum != 0))
+			continue;	// Go to next task
+
+		if (snap->patterns) {
+			if (rec->flags & REC_NO_COMMAND ||
+				!CheckCommandMatch(rec->name, snap->patterns, snap->patCount))
+				continue;	// Go to next task
+		}
+
+		if (!snap->dryRun)
+			SetTaskPri(rec->task, snap->newPri);
+		rec->flags |= REC_REPRI;
+		snap->repri++;
+
+		if (snap->patterns && !snap->allMatches)
+			break;	// Exit the for loop
+	}
+}
+
+
+//--------------------------------------------------------------------------------
+//	Copies Shell/CLI process number num into the given record. process is NULL if
+//	there is no such process. Must be called under Forbid().
+//--------------------------------------------------------------------------------
+void SnapShellProcess(Snapshot* snap, TaskRec* rec, long num, struct Process* process)
+{
+	struct 	CommandLineInterface* cli;
+
+	rec->cliNum = num;
+
+	if (process == NULL) {
+		rec->flags |= REC_MISSING;
+		return;
+	}
+
+	SnapProcess(snap, rec, process);
+
+	// Convert BPTR to CommandLineInterface pointer
+	cli = (struct CommandLineInterface*) BADDR(process->pr_CLI);
+	if (cli == NULL)
+		return;		// Flagged as REC_NO_CLI by SnapProcess()
+
+	// Only the fields that are shown are copied. Only CLI processes have a
+	// global vector.
+	if (!(snap->skip & FIELD_BIT(FIELD_GLOBVEC)))
+		rec->globVec = process->pr_GlobVec ? *(long*)process->pr_GlobVec : 0;
+	if (!(snap->skip & FIELD_BIT(FIELD_FAILAT)))
+		rec->failLevel = cli->cli_FailLevel;
+	if (!(snap->skip & FIELD_BIT(FIELD_RC)))
+		rec->returnCode = cli->cli_ReturnCode;
+	if (!(snap->skip & FIELD_BIT(FIELD_STACK_REC)))
+		rec->defaultStack = cli->cli_DefaultStack * 4;	// Stored in longwords
+	if (!(snap->skip & FIELD_BIT(FIELD_BG)) && cli->cli_Background)
+		rec->flags |= REC_BACKGROUND;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Copies the details common to every process into the given record, using the
+//	loaded command's name for Shell/CLI processes. Must be called under Forbid().
+//--------------------------------------------------------------------------------
+void SnapProcess(Snapshot* snap, TaskRec* rec, struct Process* process)
+{
+	struct 	CommandLineInterface* cli;
+
+	rec->task = &process->pr_Task;
+	rec->type = NT_PROCESS;
+	rec->cliNum = process->pr_TaskNum;
+	rec->pri = process->pr_Task.tc_Node.ln_Pri;
+	rec->state = process->pr_Task.tc_State;
+	rec->stackUsed = (long)process->pr_Task.tc_SPUpper - (long)process->pr_Task.tc_SPReg;
+	rec->stackSize = (long)process->pr_Task.tc_SPUpper - (long)process->pr_Task.tc_SPLower;
+	if (snap->show & NEED_HIGHWATER)
+		rec->stackPeak = StackHighWater(&process->pr_Task);
+	if (snap->show & NEED_MEM)
+		rec->mem = TaskMemory(&process->pr_Task);
+	if (snap->show & NEED_QUEUE) {
+		rec->queueCount = CountMessages(&process->pr_MsgPort, snap->queueMax);
+		SnapWaitPort(snap, rec, &process->pr_Task);
+	}
+
+	// TaskNum is 0 if not a CLI process
+	if (process->pr_TaskNum != 0)
+	{
+		// Convert BPTR to CommandLineInterface pointer
+		cli = (struct CommandLineInterface*) BADDR(process->pr_CLI);
+		if (cli == NULL) {
+			rec->flags |= REC_NO_CLI;
+			return;
+		}
+
+		// The loaded command isn't in tc_MemEntry
+		if (snap->show & NEED_MEM)
+			rec->mem += SegListSize(cli->cli_Module);
+
+		if (snap->skip & FIELD_BIT(FIELD_NAME))
+			return;
+
+		// Use the command name if it exists, otherwise fall back on the task name
+		if (bstrlen(cli->cli_CommandName) > 0) {
+			bstr2cstr(cli->cli_CommandName, rec->name, sizeof(rec->name));
+			return;
+		}
+		rec->flags |= REC_NO_COMMAND;
+	}
+
+	if (!(snap->skip & FIELD_BIT(FIELD_NAME)))
+		strcpyn(rec->name, process->pr_Task.tc_Node.ln_Name, sizeof(rec->name));
+}
+
+
+//--------------------------------------------------------------------------------
+//	Returns the most stack the task has ever used. Stack grows down from
+//	tc_SPUpper, so everything from tc_SPLower up to the deepest point reached
+//	still holds whatever the allocator left there (normally zero or a fill
+//	pattern), which is read from the lowest longword. The scan goes up one
+//	longword at a time: stack in use can hold zero or the fill value too, so
+//	skipping any of it could under-report the peak. Must be called under
+//	Forbid().
+//--------------------------------------------------------------------------------
+LONG StackHighWater(struct Task* task)
+{
+	ULONG*	lower;
+	ULONG*	upper;
+	ULONG*	scan;
+	ULONG	fill;
+	LONG	used;
+
+	// Stack bounds aren't necessarily longword aligned
+	lower = (ULONG*)(((ULONG)task->tc_SPLower + 3) & ~3UL);
+	upper = (ULONG*)((ULONG)task->tc_SPUpper & ~3UL);
+	if (upper <= lower)
+		return 0;
+
+	fill = *lower;
+
+	// Find the first longword that has been written to
+	scan = lower;
+	while (scan < upper && *scan == fill)
+		scan++;
+
+	used = (LONG)task->tc_SPUpper - (LONG)scan;
+
+	// The current stack pointer may be below a stale copy of the fill value
+	if (used < (LONG)task->tc_SPUpper - (LONG)task->tc_SPReg)
+		used = (LONG)task->tc_SPUpper - (LONG)task->tc_SPReg;
+
+	return used;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Returns the total size of the allocations in the task's tc_MemEntry list,
+//	which exec frees when the task ends. For a process this includes its
+//	stack & the process structure itself. Must be called under Forbid().
+//--------------------------------------------------------------------------------
+LONG TaskMemory(struct Task* task)
+{
+	struct 	Node* node;
+	struct 	MemList* memList;
+	LONG	size = 0;
+	UWORD	i;
+
+	for (node = task->tc_MemEntry.lh_Head; node->ln_Succ != NULL; node = node->ln_Succ)
+	{
+		memList = (struct MemList*)node;
+		for (i = 0; i < memList->ml_NumEntries; i++)
+			size += memList->ml_ME[i].me_Length;
+	}
+
+	return size;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Returns the size of a loaded seglist. Each segment starts with a BPTR to the
+//	next one, & the longword before it holds the segment's size in bytes.
+//	Must be called under Forbid().
+//--------------------------------------------------------------------------------
+LONG SegListSize(BPTR segList)
+{
+	LONG	size = 0;
+
+	for (; segList != 0; segList = *(BPTR*)BADDR(segList))
+		size += ((ULONG*)BADDR(segList))[-1];
+
+	return size;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Returns the number of messages queued at a port. A port nobody is reading
+//	can pile up any number of them, so counting stops at max. Must be called
+//	under Forbid().
+//--------------------------------------------------------------------------------
+UWORD CountMessages(struct MsgPort* port, ULONG max)
+{
+	struct 	Node* msg;
+	UWORD	count = 0;
+
+	for (msg = port->mp_MsgList.lh_Head; msg->ln_Succ != NULL && count < max; msg = msg->ln_Succ)
+		count++;
+
+	return count;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Notes which port a waiting task is blocked on, & how many messages are
+//	queued there: the first public port that signals the task with a signal
+//	it's waiting for, or else a process's own pr_MsgPort, which isn't public.
+//	The port list is walked no further than snap->queueMax ports. Must be
+//	called under Forbid().
+//--------------------------------------------------------------------------------
+void SnapWaitPort(Snapshot* snap, TaskRec* rec, struct Task* task)
+{
+	struct 	Node* node;
+	struct 	MsgPort* port;
+	ULONG	walked = 0;
+
+	if (task->tc_State != TS_WAIT || task->tc_SigWait == 0 ||
+		((snap->skip & FIELD_BIT(FIELD_WAIT_PORT)) && (snap->skip & FIELD_BIT(FIELD_WAIT_MSGS))))
+		return;
+
+	for (node = SysBase->PortList.lh_Head; node->ln_Succ != NULL && walked < snap->queueMax;
+		 node = node->ln_Succ, walked++)
+	{
+		port = (struct MsgPort*)node;
+		if ((port->mp_Flags & PF_ACTION) == PA_SIGNAL && port->mp_SigTask == task &&
+			(task->tc_SigWait & (1UL << port->mp_SigBit)) != 0) {
+			strcpyn(rec->waitPort, node->ln_Name, sizeof(rec->waitPort));
+			rec->waitCount = CountMessages(port, snap->queueMax);
+			return;
+		}
+	}
+
+	// Most processes spend their time waiting for dos.library packets there
+	port = &((struct Process*)task)->pr_MsgPort;
+	if (task->tc_Node.ln_Type == NT_PROCESS && (task->tc_SigWait & (1UL << port->mp_SigBit)) != 0) {
+		strcpyn(rec->waitPort, STR_WAIT_OWN_PORT, sizeof(rec->waitPort));
+		rec->waitCount = rec->queueCount;
+	}
+}
+
+
+//--------------------------------------------------------------------------------
+//	Returns the stack size to recommend for a Shell/CLI process: half as much
+//	again as its high-water mark, rounded up to STACK_REC_ROUND bytes, but never
+//	less than the Shell's default stack size.
+//--------------------------------------------------------------------------------
+LONG RecommendedStack(const TaskRec* rec)
+{
+	LONG	size;
+
+	size = rec->stackPeak + rec->stackPeak / 2;
+	size = (size + STACK_REC_ROUND - 1) / STACK_REC_ROUND * STACK_REC_ROUND;
+
+	return size > rec->defaultStack ? size : rec->defaultStack;
+}
+
+
+//-----------------------------------------------------------------------------
+//	Prints information about Shell/CLI processes
+//-----------------------------------------------------------------------------
+int PrintShellProcesses(Options* opts, Snapshot* snap)
+{
+	TaskRec* rec;
+	ULONG	i;
+	int		rc = RETURN_OK;
+
+	switch (opts->format) {
+		case FORMAT_VERBOSE:
+		case FORMAT_TCB:
+		case FORMAT_SHORT:
+			if (opts->encoding != ENCODE_TEXT)
+				EncodeTableStart(opts, KEY_CLI_TABLE, BIN_TAG_CLI, opts->cliCols, snap->cliCount);
+			else
+				PrintSectionHeader(opts, STR_CLI_HEADING, opts->cliCols);
+			break;
+		case FORMAT_COMMAND:
+			// No header for command mode
+			rc = RETURN_WARN;  	// Assume we won't find it
+			break;
+		default:
+			// Shouldn't get here so fail if we do
+			return RETURN_FAIL;
+			break;
+	}
+
+	// Loop through all the CLIs captured in the snapshot
+	for (i = 0; i < snap->cliCount; i++)
+	{
+		rec = &snap->recs[snap->sysCount + i];
+
+		// If in COMMAND mode, check if the command name matches the user-supplied pattern
+		if (opts->format == FORMAT_COMMAND)
+		{
+			if (rec->flags & (REC_MISSING | REC_NO_CLI))
+				continue;	// Go to next process
+
+			// With BREAK, the processes that were signalled are the matches
+			if (opts->breakSigs ? (rec->flags & REC_BROKEN) != 0 :
+				!(rec->flags & REC_NO_COMMAND) &&
+				CheckCommandMatch(rec->name, opts->patterns, opts->patCount) == TRUE) {
+				// Match found, print only the CLI number 
+				// to match the output of STATUS and stop
+				// unless every match was asked for
+				OutNum(rec->cliNum, 2, ALIGN_RIGHT);
+				OutNewline();
+				timing.rows++;
+				rc = RETURN_OK;
+				if (!opts->allMatches)
+					break;	// Exit the for loop
+			}
+			continue;	// Go to next process
+		}
+
+		if (opts->encoding != ENCODE_TEXT)
+			EncodeRecord(opts, opts->cliCols, rec, rec->cliNum, i == 0);
+		else
+			PrintRecord(opts->cliCols, opts->show, rec, rec->cliNum);
+
+		// Check for Ctrl-C break
+		if (CheckSignal(SIGBREAKF_CTRL_C)) {
+			OutFlush();
+			PrintFault(ERROR_BREAK, NULL);
+			break;	// Exit the for loop
+		}
+	}
+
+	if (opts->encoding != ENCODE_TEXT)
+		EncodeTableEnd(opts);
+
+	return rc;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Prints information about all tasks & processes captured in the snapshot.
+//--------------------------------------------------------------------------------
+int PrintTaskList(Options* opts, Snapshot* snap)
+{
+	TaskRec* rec;
+	ULONG	i;
+	int 	rc = RETURN_OK;
+
+	// COMMAND mode never shows the system table
+	if (opts->format == FORMAT_COMMAND) {
+		// Shouldn't get here so fail if we do
+		OutMsg(STR_INV_TASK_FMT);
+		return RETURN_FAIL;
+	}
+
+	if (opts->encoding != ENCODE_TEXT)
+		EncodeTableStart(opts, KEY_SYS_TABLE, BIN_TAG_SYS, opts->sysCols, snap->sysCount);
+	else
+		PrintSectionHeader(opts, STR_SYS_HEADING, opts->sysCols);
+
+	for (i = 0; i < snap->sysCount; i++)
+	{
+		rec = &snap->recs[i];
+
+		if (rec->flags & REC_NO_CLI) {
+			// Our own process must have a CLI
+			if (rec->task == FindTask(NULL)) {
+				OutMsg(STR_ERR_GET_CLI);
+				return RETURN_FAIL;
+			}
+			rc = RETURN_FAIL;
+		}
+
+		// Task count provides a running count of how many tasks/processes there are
+		if (opts->encoding != ENCODE_TEXT)
+			EncodeRecord(opts, opts->sysCols, rec, (long)i + 1, i == 0);
+		else
+			PrintRecord(opts->sysCols, opts->show, rec, (long)i + 1);
+
+		// Check for Ctrl-C break
+		if (CheckSignal(SIGBREAKF_CTRL_C)) {
+			OutFlush();
+			PrintFault(ERROR_BREAK, NULL);
+			break;	// Exit the for loop
+		}
+	}
+
+	if (opts->encoding != ENCODE_TEXT)
+		EncodeTableEnd(opts);
+
+	return rc;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Prints the exec lists captured in the snapshot, a table per list.
+//--------------------------------------------------------------------------------
+int PrintExecLists(Options* opts, Snapshot* snap)
+{
+	const ListTable* table;
+	TaskRec* rec;
+	ULONG	i;
+	ULONG	j;
+
+	for (i = 0; i < LIST_COUNT; i++)
+	{
+		if (!(opts->lists & (1 << i)))
+			continue;
+
+		table = &listTables[i];
+		if (opts->encoding != ENCODE_TEXT)
+			EncodeTableStart(opts, table->key, table->tag, opts->listCols[i], snap->listCount[i]);
+		else
+			PrintSectionHeader(opts, table->heading, opts->listCols[i]);
+
+		for (j = 0; j < snap->listCount[i]; j++)
+		{
+			rec = &snap->recs[snap->listFirst[i] + j];
+
+			if (opts->encoding != ENCODE_TEXT)
+				EncodeRecord(opts, opts->listCols[i], rec, (long)j + 1, j == 0);
+			else
+				PrintRecord(opts->listCols[i], opts->show, rec, (long)j + 1);
+
+			// Check for Ctrl-C break
+			if (CheckSignal(SIGBREAKF_CTRL_C)) {
+				OutFlush();
+				PrintFault(ERROR_BREAK, NULL);
+				break;	// Exit the for loop
+			}
+		}
+
+		if (opts->encoding != ENCODE_TEXT)
+			EncodeTableEnd(opts);
+	}
+
+	return RETURN_OK;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Prints the table header, preceded by the section heading if we're showing
+//	more than one table. Only the blank line between the tables is
+//	printed with NOHEAD.
+//--------------------------------------------------------------------------------
+void PrintSectionHeader(Options* opts, const char* heading, const Column* columns)
+{
+	if (opts->tables > 1) {
+		OutNewline();
+		if (!opts->noHead)
+			OutMsg(heading);
+	}
+
+	if (!opts->noHead)
+		PrintTableHeader(columns, opts->show);
+}
+
+
+//--------------------------------------------------------------------------------
+//	Prints the two heading lines and the divider for the columns selected by
+//	show.
+//--------------------------------------------------------------------------------
+void PrintTableHeader(const Column* columns, ULONG show)
+{
+	const Column* col;
+	int		i;
+
+	for (col = columns; col->field != FIELD_END; col++)
+		if (ShowColumn(col, show)) {
+			OutChar(' ');
+			OutField(col->top, col->width, col->align);
+		}
+	OutNewline();
+
+	for (col = columns; col->field != FIELD_END; col++)
+		if (ShowColumn(col, show)) {
+			OutChar(' ');
+			OutField(col->bot, col->width, col->align);
+		}
+	OutNewline();
+
+	for (col = columns; col->field != FIELD_END; col++)
+		if (ShowColumn(col, show)) {
+			OutChar(' ');
+			for (i = 0; i < col->width; i++)
+				OutChar('-');
+		}
+	OutNewline();
+}
+
+
+//--------------------------------------------------------------------------------
+//	Prints the table row for the given record, or an error message in its place
+//	if the record couldn't be read properly. num is shown in the FIELD_NUM column.
+//--------------------------------------------------------------------------------
+void PrintRecord(const Column* columns, ULONG show, const TaskRec* rec, long num)
+{
+	const Column* col;
+	const char* msg = RecordError(rec);
+
+	timing.rows++;
+
+	if (msg == NULL) {
+		PrintRow(columns, show, rec, num);
+		return;
+	}
+
+	// COLS may have put the number anywhere, or left it out
+	if ((col = FindColumn(columns, FIELD_NUM)) != NULL && ShowColumn(col, show)) {
+		OutChar(' ');
+		OutNum(num, col->width, ALIGN_RIGHT);
+	}
+	OutChar(' ');
+	OutMsg(msg);
+}
+
+
+//--------------------------------------------------------------------------------
+//	Returns the message to show in place of a record that couldn't be read
+//	properly, or NULL if the record is fine.
+//--------------------------------------------------------------------------------
+const char* RecordError(const TaskRec* rec)
+{
+	// The user requested a specific process number that doesn't exist
+	if (rec->flags & REC_MISSING)
+		return STR_NO_PROCESS;
+	if (rec->flags & REC_NO_CLI)
+		return STR_ERR_GET_CLI;
+	if (rec->type != NT_TASK && rec->type != NT_PROCESS && !(rec->flags & REC_NODE))
+		return STR_INV_TASK_TYPE;
+
+	return NULL;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Prints one table row for the given record. num is shown in the FIELD_NUM
+//	column.
+//--------------------------------------------------------------------------------
+void PrintRow(const Column* columns, ULONG show, const TaskRec* rec, long num)
+{
+	const Column* col;
+
+	for (col = columns; col->field != FIELD_END; col++)
+		if (ShowColumn(col, show)) {
+			OutChar(' ');
+			PrintCell(col, rec, num);
+		}
+
+	// End of the line
+	OutNewline();
+}
+
+
+//--------------------------------------------------------------------------------
+//	Returns TRUE if the column is shown in the output format selected by show
+//	and all the options it needs were given.
+//--------------------------------------------------------------------------------
+BOOL ShowColumn(const Column* col, ULONG show)
+{
+	return (col->formats & show) != 0 && (col->needs & show) == col->needs;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Prints a single field of a record, padded to the column width.
+//--------------------------------------------------------------------------------
+void PrintCell(const Column* col, const TaskRec* rec, long num)
+{
+	char	time[9];
+	char	version[12];
+
+	switch (col->field)
+	{
+		case FIELD_NUM:
+			OutNum(num, col->width, col->align);
+			break;
+		case FIELD_NAME:
+			OutField(rec->name, col->width, col->align);
+			break;
+		case FIELD_COMMAND:
+			OutField((rec->flags & REC_NO_COMMAND) ? STR_NO_COMMAND : rec->name, col->width, col->align);
+			break;
+		case FIELD_PRI:
+			OutNum(rec->pri, col->width, col->align);
+			break;
+		case FIELD_TYPE:
+			OutField(rec->type == NT_PROCESS ? STR_TYPE_PROCESS : STR_TYPE_TASK, col->width, col->align);
+			break;
+		case FIELD_CLI:
+			// Blank unless it's a CLI process
+			if (rec->cliNum != 0)
+				OutNum(rec->cliNum, col->width, col->align);
+			else
+				OutField("", col->width, col->align);
+			break;
+		case FIELD_STATE:
+			OutField(GetStateName(rec->state), col->width, col->align);
+			break;
+		case FIELD_STACK_USED:
+			OutNum(rec->stackUsed, col->width, col->align);
+			break;
+		case FIELD_STACK_SIZE:
+			OutNum(rec->stackSize, col->width, col->align);
+			break;
+		case FIELD_STACK_PEAK:
+			OutNum(rec->stackPeak, col->width, col->align);
+			break;
+		case FIELD_MEM:
+			OutNum(rec->mem, col->width, col->align);
+			break;
+		case FIELD_ALERT:
+			OutField(GetAlertName(rec->alert), col->width, col->align);
+			break;
+		case FIELD_VERSION:
+			FormatVersion(version, rec->version, rec->revision);
+			OutField(version, col->width, col->align);
+			break;
+		case FIELD_OPEN:
+			OutNum(rec->openCount, col->width, col->align);
+			break;
+		case FIELD_MSGS:
+			OutNum(rec->msgCount, col->width, col->align);
+			break;
+		case FIELD_QUEUE:
+			// Blank unless it's a process, as tasks have no pr_MsgPort
+			if (rec->type == NT_PROCESS)
+				OutNum(rec->queueCount, col->width, col->align);
+			else
+				OutField("", col->width, col->align);
+			break;
+		case FIELD_WAIT_PORT:
+			OutField(rec->waitPort, col->width, col->align);
+			break;
+		case FIELD_WAIT_MSGS:
+			// Blank unless the task is waiting on a port
+			if (rec->waitPort[0] != '\0')
+				OutNum(rec->waitCount, col->width, col->align);
+			else
+				OutField("", col->width, col->align);
+			break;
+		case FIELD_SIG_TASK:
+			OutField(rec->action == PA_SOFTINT ? STR_PORT_SOFTINT :
+					 rec->action == PA_IGNORE ? STR_PORT_IGNORE : rec->sigTask,
+					 col->width, col->align);
+			break;
+		case FIELD_STACK_REC:
+			OutNum(RecommendedStack(rec), col->width, col->align);
+			break;
+		case FIELD_GLOBVEC:
+			OutNum(rec->globVec, col->width, col->align);
+			break;
+		case FIELD_FAILAT:
+			OutNum(rec->failLevel, col->width, col->align);
+			break;
+		case FIELD_RC:
+			OutNum(rec->returnCode, col->width, col->align);
+			break;
+		case FIELD_BG:
+			OutField((rec->flags & REC_BACKGROUND) ? STR_YES : STR_NO, col->width, col->align);
+			break;
+		case FIELD_CPU:
+			OutTenths(rec->cpu, col->width, col->align);
+			break;
+		case FIELD_TIME:
+			FormatTime(time, num);
+			OutField(time, col->width, col->align);
+			break;
+		case FIELD_EVENT:
+			OutField(rec->event == TRACE_REMOVED ? STR_EVENT_REMOVED : STR_EVENT_ADDED, col->width, col->align);
+			break;
+		case FIELD_MSECS:
+			OutNum(num, col->width, col->align);
+			break;
+		default:
+			OutField("", col->width, col->align);
+			break;
+	}
+}
+
+
+//--------------------------------------------------------------------------------
+//	Starts the CSV, JSON or BIN output. Nothing is written for text tables.
+//--------------------------------------------------------------------------------
+void EncodeStart(Options* opts)
+{
+	BinHeader header;
+
+	switch (opts->encoding)
+	{
+		case ENCODE_JSON:
+			OutChar('{');
+			break;
+		case ENCODE_BIN:
+			header.magic = BIN_MAGIC;
+			header.version = BIN_VERSION;
+			header.recSize = sizeof(BinRec);
+			header.show = opts->show;
+			OutBytes(&header, sizeof(header));
+			break;
+		default:
+			break;
+	}
+}
+
+
+//--------------------------------------------------------------------------------
+//	Ends the CSV, JSON or BIN output. The JSON object also gets the sample
+//	summary that the text tables show below the system table, and the MEM
+//	free memory line they show above the tables.
+//--------------------------------------------------------------------------------
+void EncodeEnd(Options* opts, Snapshot* snap)
+{
+	if (opts->encoding != ENCODE_JSON)
+		return;
+
+	if ((opts->show & NEED_SAMPLE) && (opts->mode == MODE_ALL || opts->mode == MODE_SYSTEM)) {
+		OutChar(',');
+		EncodeKey(KEY_SAMPLE);
+		OutChar('{');
+		EncodeKey(KEY_SAMPLES);
+		OutNum(snap->cpu.samples, 1, ALIGN_LEFT);
+		OutChar(',');
+		EncodeKey(KEY_IDLE);
+		OutTenths(snap->cpu.idle, 1, ALIGN_LEFT);
+		OutChar(',');
+		EncodeKey(KEY_LOST);
+		OutNum(snap->cpu.lost, 1, ALIGN_LEFT);
+		OutChar(',');
+		EncodeKey(KEY_OVERHEAD);
+		OutTenths(snap->cpu.overhead, 1, ALIGN_LEFT);
+		OutChar('}');
+	}
+
+	if (opts->show & NEED_MEM) {
+		OutChar(',');
+		EncodeKey(KEY_MEMORY);
+		OutChar('{');
+		EncodeKey(KEY_CHIP);
+		OutNum(snap->mem.chip, 1, ALIGN_LEFT);
+		OutChar(',');
+		EncodeKey(KEY_CHIP_LARGEST);
+		OutNum(snap->mem.chipLargest, 1, ALIGN_LEFT);
+		OutChar(',');
+		EncodeKey(KEY_FAST);
+		OutNum(snap->mem.fast, 1, ALIGN_LEFT);
+		OutChar(',');
+		EncodeKey(KEY_FAST_LARGEST);
+		OutNum(snap->mem.fastLargest, 1, ALIGN_LEFT);
+		OutChar('}');
+	}
+
+	if (opts->timing)
+		EncodeTiming();
+
+	OutChar('}');
+	OutNewline();
+}
+
+
+//--------------------------------------------------------------------------------
+//	Starts a table of count records in the CSV, JSON or BIN output. The CSV
+//	header line names the columns shown, plus a final error column that is only
+//	filled in for records that couldn't be read properly.
+//--------------------------------------------------------------------------------
+void EncodeTableStart(Options* opts, const char* key, ULONG tag, const Column* columns, ULONG count)
+{
+	const Column* col;
+	BinTable table;
+	BOOL	first = (opts->tablesStarted++ == 0);
+
+	switch (opts->encoding)
+	{
+		case ENCODE_CSV:
+			if (!first)
+				OutNewline();
+			if (opts->noHead)
+				break;
+			for (col = columns; col->field != FIELD_END; col++)
+				if (ShowColumn(col, opts->show)) {
+					OutStr(FieldKey(col->field));
+					OutChar(',');
+				}
+			OutMsg(KEY_ERROR);
+			break;
+		case ENCODE_JSON:
+			if (!first)
+				OutChar(',');
+			EncodeKey(key);
+			OutChar('[');
+			break;
+		case ENCODE_BIN:
+			table.tag = tag;
+			table.count = count;
+			OutBytes(&table, sizeof(table));
+			break;
+		default:
+			break;
+	}
+}
+
+
+//--------------------------------------------------------------------------------
+//	Ends a table in the CSV, JSON or BIN output.
+//--------------------------------------------------------------------------------
+void EncodeTableEnd(Options* opts)
+{
+	if (opts->encoding == ENCODE_JSON) {
+		OutNewline();
+		OutChar(']');
+	}
+}
+
+
+//--------------------------------------------------------------------------------
+//	Writes a record in the CSV, JSON or BIN output. Records that couldn't be read
+//	properly only have their number and the error message. first is TRUE for
+//	the first record of the table.
+//--------------------------------------------------------------------------------
+void EncodeRecord(Options* opts, const Column* columns, const TaskRec* rec, long num, BOOL first)
+{
+	const Column* col;
+	const char* msg;
+
+	timing.rows++;
+
+	if (opts->encoding == ENCODE_BIN) {
+		EncodeBinRecord(rec, num);
+		return;
+	}
+
+	msg = RecordError(rec);
+
+	if (opts->encoding == ENCODE_CSV) {
+		for (col = columns; col->field != FIELD_END; col++)
+			if (ShowColumn(col, opts->show)) {
+				if (msg == NULL || col->field == FIELD_NUM)
+					EncodeCell(opts, col, rec, num);
+				OutChar(',');
+			}
+		if (msg != NULL)
+			EncodeStr(opts, msg);
+		OutNewline();
+		return;
+	}
+
+	// JSON records are separated by a comma at the end of the previous line
+	if (!first)
+		OutChar(',');
+	OutNewline();
+	OutChar('{');
+
+	EncodeKey(KEY_NUM);
+	OutNum(num, 1, ALIGN_LEFT);
+
+	if (msg != NULL) {
+		OutChar(',');
+		EncodeKey(KEY_ERROR);
+		EncodeStr(opts, msg);
+	}
+	else {
+		for (col = columns; col->field != FIELD_END; col++)
+			if (col->field != FIELD_NUM && ShowColumn(col, opts->show)) {
+				OutChar(',');
+				EncodeKey(FieldKey(col->field));
+				EncodeCell(opts, col, rec, num);
+			}
+	}
+
+	OutChar('}');
+}
+
+
+//--------------------------------------------------------------------------------
+//	Writes a record in the BIN output. Every field is written, whichever columns
+//	are shown.
+//--------------------------------------------------------------------------------
+void EncodeBinRecord(const TaskRec* rec, long num)
+{
+	BinRec	bin;
+
+	FillBinRec(&bin, rec, num);
+	OutBytes(&bin, sizeof(bin));
+}
+
+
+//--------------------------------------------------------------------------------
+//	Converts a record to the BIN layout, for the BIN output & the snapshot API.
+//--------------------------------------------------------------------------------
+void FillBinRec(BinRec* bin, const TaskRec* rec, long num)
+{
+	memset(bin, 0, sizeof(*bin));
+	bin->task = (ULONG)rec->task;
+	bin->num = num;
+	bin->cliNum = rec->cliNum;
+	bin->stackUsed = rec->stackUsed;
+	bin->stackSize = rec->stackSize;
+	bin->stackPeak = rec->stackPeak;
+	bin->defaultStack = rec->defaultStack;
+	bin->globVec = rec->globVec;
+	bin->failLevel = rec->failLevel;
+	bin->returnCode = rec->returnCode;
+	bin->mem = rec->mem;
+	bin->cpu = rec->cpu;
+	bin->pri = rec->pri;
+	bin->type = rec->type;
+	bin->state = rec->state;
+	bin->flags = (UBYTE)(rec->flags & ~(REC_FREE | REC_SEEN));
+	bin->version = rec->version;
+	bin->revision = rec->revision;
+	bin->openCount = rec->openCount;
+	bin->msgCount = rec->msgCount;
+	bin->action = rec->action;
+	bin->queueCount = rec->queueCount;
+	bin->waitCount = rec->waitCount;
+	strcpyn(bin->name, rec->name, sizeof(bin->name));
+	strcpyn(bin->sigTask, rec->sigTask, sizeof(bin->sigTask));
+	strcpyn(bin->waitPort, rec->waitPort, sizeof(bin->waitPort));
+}
+
+
+//--------------------------------------------------------------------------------
+//	Writes a single field of a record as a CSV or JSON value. Values that are
+//	blank in the text tables are written as null.
+//--------------------------------------------------------------------------------
+void EncodeCell(Options* opts, const Column* col, const TaskRec* rec, long num)
+{
+	char	time[9];
+	char	version[12];
+
+	switch (col->field)
+	{
+		case FIELD_NUM:
+			OutNum(num, 1, ALIGN_LEFT);
+			break;
+		case FIELD_NAME:
+			EncodeStr(opts, rec->name);
+			break;
+		case FIELD_COMMAND:
+			if (rec->flags & REC_NO_COMMAND)
+				EncodeNull(opts);
+			else
+				EncodeStr(opts, rec->name);
+			break;
+		case FIELD_PRI:
+			OutNum(rec->pri, 1, ALIGN_LEFT);
+			break;
+		case FIELD_TYPE:
+			EncodeStr(opts, rec->type == NT_PROCESS ? STR_TYPE_PROCESS : STR_TYPE_TASK);
+			break;
+		case FIELD_CLI:
+			if (rec->cliNum != 0)
+				OutNum(rec->cliNum, 1, ALIGN_LEFT);
+			else
+				EncodeNull(opts);
+			break;
+		case FIELD_STATE:
+			EncodeStr(opts, GetStateName(rec->state));
+			break;
+		case FIELD_STACK_USED:
+			OutNum(rec->stackUsed, 1, ALIGN_LEFT);
+			break;
+		case FIELD_STACK_SIZE:
+			OutNum(rec->stackSize, 1, ALIGN_LEFT);
+			break;
+		case FIELD_STACK_PEAK:
+			OutNum(rec->stackPeak, 1, ALIGN_LEFT);
+			break;
+		case FIELD_MEM:
+			OutNum(rec->mem, 1, ALIGN_LEFT);
+			break;
+		case FIELD_ALERT:
+			if (rec->alert)
+				EncodeStr(opts, GetAlertName(rec->alert));
+			else
+				EncodeNull(opts);
+			break;
+		case FIELD_VERSION:
+			FormatVersion(version, rec->version, rec->revision);
+			EncodeStr(opts, version);
+			break;
+		case FIELD_OPEN:
+			OutNum(rec->openCount, 1, ALIGN_LEFT);
+			break;
+		case FIELD_MSGS:
+			OutNum(rec->msgCount, 1, ALIGN_LEFT);
+			break;
+		case FIELD_QUEUE:
+			if (rec->type == NT_PROCESS)
+				OutNum(rec->queueCount, 1, ALIGN_LEFT);
+			else
+				EncodeNull(opts);
+			break;
+		case FIELD_WAIT_PORT:
+			if (rec->waitPort[0] != '\0')
+				EncodeStr(opts, rec->waitPort);
+			else
+				EncodeNull(opts);
+			break;
+		case FIELD_WAIT_MSGS:
+			if (rec->waitPort[0] != '\0')
+				OutNum(rec->waitCount, 1, ALIGN_LEFT);
+			else
+				EncodeNull(opts);
+			break;
+		case FIELD_SIG_TASK:
+			// Only set for ports that signal a task
+			if (rec->sigTask[0] != '\0')
+				EncodeStr(opts, rec->sigTask);
+			else
+				EncodeNull(opts);
+			break;
+		case FIELD_STACK_REC:
+			OutNum(RecommendedStack(rec), 1, ALIGN_LEFT);
+			break;
+		case FIELD_GLOBVEC:
+			OutNum(rec->globVec, 1, ALIGN_LEFT);
+			break;
+		case FIELD_FAILAT:
+			OutNum(rec->failLevel, 1, ALIGN_LEFT);
+			break;
+		case FIELD_RC:
+			OutNum(rec->returnCode, 1, ALIGN_LEFT);
+			break;
+		case FIELD_BG:
+			EncodeBool(opts, (rec->flags & REC_BACKGROUND) != 0);
+			break;
+		case FIELD_CPU:
+			OutTenths(rec->cpu, 1, ALIGN_LEFT);
+			break;
+		case FIELD_TIME:
+			FormatTime(time, num);
+			EncodeStr(opts, time);
+			break;
+		case FIELD_EVENT:
+			EncodeStr(opts, rec->event == TRACE_REMOVED ? STR_EVENT_REMOVED : STR_EVENT_ADDED);
+			break;
+		case FIELD_MSECS:
+			OutNum(num, 1, ALIGN_LEFT);
+			break;
+		default:
+			EncodeNull(opts);
+			break;
+	}
+}
+
+
+//--------------------------------------------------------------------------------
+//	Returns the CSV/JSON name of a field.
+//--------------------------------------------------------------------------------
+const char* FieldKey(Field field)
+{
+	switch (field)
+	{
+		case FIELD_NUM:			return KEY_NUM;
+		case FIELD_NAME:		return KEY_NAME;
+		case FIELD_COMMAND:		return KEY_COMMAND;
+		case FIELD_PRI:			return KEY_PRI;
+		case FIELD_TYPE:		return KEY_TYPE;
+		case FIELD_CLI:			return KEY_CLI;
+		case FIELD_STATE:		return KEY_STATE;
+		case FIELD_STACK_USED:	return KEY_STACK_USED;
+		case FIELD_STACK_SIZE:	return KEY_STACK_SIZE;
+		case FIELD_STACK_PEAK:	return KEY_STACK_PEAK;
+		case FIELD_MEM:			return KEY_MEM;
+		case FIELD_ALERT:		return KEY_ALERT;
+		case FIELD_VERSION:		return KEY_VERSION;
+		case FIELD_OPEN:		return KEY_OPEN;
+		case FIELD_MSGS:		return KEY_MSGS;
+		case FIELD_SIG_TASK:	return KEY_SIG_TASK;
+		case FIELD_QUEUE:		return KEY_QUEUE;
+		case FIELD_WAIT_PORT:	return KEY_WAIT_PORT;
+		case FIELD_WAIT_MSGS:	return KEY_WAIT_MSGS;
+		case FIELD_STACK_REC:	return KEY_STACK_REC;
+		case FIELD_GLOBVEC:		return KEY_GLOBVEC;
+		case FIELD_FAILAT:		return KEY_FAILAT;
+		case FIELD_RC:			return KEY_RC;
+		case FIELD_BG:			return KEY_BG;
+		case FIELD_CPU:			return KEY_CPU;
+		case FIELD_TIME:		return KEY_TIME;
+		case FIELD_EVENT:		return KEY_EVENT;
+		case FIELD_MSECS:		return KEY_MSECS;
+		default:				return KEY_ERROR;
+	}
+}
+
+
+//--------------------------------------------------------------------------------
+//	Writes a JSON object key, including the colon.
+//--------------------------------------------------------------------------------
+void EncodeKey(const char* key)
+{
+	OutChar('"');
+	OutStr(key);
+	OutStr("\":");
+}
+
+
+//--------------------------------------------------------------------------------
+//	Writes a string as a CSV or JSON value. CSV values are only quoted if they
+//	contain a comma, quote, line break or leading/trailing space, with quotes
+//	doubled. JSON strings escape quotes, backslashes, control characters and
+//	anything outside ASCII, which as ISO-8859-1 maps straight onto \u00xx.
+//--------------------------------------------------------------------------------
+void EncodeStr(Options* opts, const char* str)
+{
+	static const char hex[] = "0123456789abcdef";
+	const char* p;
+	BOOL	quote;
+	UBYTE	c;
+
+	if (opts->encoding == ENCODE_CSV) {
+		quote = (str[0] == ' ' || (str[0] != '\0' && str[strlen(str) - 1] == ' '));
+		for (p = str; *p != '\0' && !quote; p++)
+			quote = (*p == ',' || *p == '"' || *p == '\n' || *p == '\r');
+
+		if (!quote) {
+			OutStr(str);
+			return;
+		}
+
+		OutChar('"');
+		for (p = str; *p != '\0'; p++) {
+			if (*p == '"')
+				OutChar('"');
+			OutChar(*p);
+		}
+		OutChar('"');
+		return;
+	}
+
+	OutChar('"');
+	for (p = str; *p != '\0'; p++)
+	{
+		c = (UBYTE)*p;
+		if (c == '"' || c == '\\') {
+			OutChar('\\');
+			OutChar(c);
+		}
+		else if (c < 0x20 || c >= 0x7f) {
+			OutStr("\\u00");
+			OutChar(hex[c >> 4]);
+			OutChar(hex[c & 0x0f]);
+		}
+		else
+			OutChar(c);
+	}
+	OutChar('"');
+}
+
+
+//--------------------------------------------------------------------------------
+//	Writes a missing value: null in JSON, an empty field in CSV.
+//--------------------------------------------------------------------------------
+void EncodeNull(Options* opts)
+{
+	if (opts->encoding == ENCODE_JSON)
+		OutStr("null");
+}
+
+
+//--------------------------------------------------------------------------------
+//	Writes a yes/no value: true or false in JSON, Yes or No in CSV.
+//--------------------------------------------------------------------------------
+void EncodeBool(Options* opts, BOOL value)
+{
+	if (opts->encoding == ENCODE_JSON)
+		OutStr(value ? "true" : "false");
+	else
+		OutStr(value ? STR_YES : STR_NO);
+}
+
+
+//--------------------------------------------------------------------------------
+//	Shows the tables and keeps them up to date until Ctrl-C is pressed. After the
+//	first full draw, only the lines of tasks that have changed, appeared or gone
+//	away are redrawn.
+//--------------------------------------------------------------------------------
+int WatchTasks(Options* opts, Snapshot* snap, Sampler* sampler)
+{
+	struct 	timerequest* timer;
+	WatchTable cliTable = {0};
+	WatchTable sysTable = {0};
+	WatchTable* lastTable;
+	BOOL	redraw;
+	int		rc = RETURN_OK;
+
+	cliTable.columns = opts->cliCols;
+	cliTable.cliNums = TRUE;
+	sysTable.columns = opts->sysCols;
+	lastTable = opts->mode == MODE_CLI ? &cliTable : &sysTable;
+
+	// timer.device tells us when it's time for the next refresh
+	if ((timer = OpenTimer(UNIT_VBLANK)) == NULL)
+		return RETURN_FAIL;
+
+	// Lines are overwritten in place, so clear whatever was there before
+	outBuf.eraseEol = TRUE;
+
+	rc = CaptureTasks(opts, snap);
+	if (rc == RETURN_OK) {
+		if (sampler) {
+			ReadSamples(sampler, snap);
+			if (opts->sort == SORT_CPU)
+				SortSamples(snap, opts->top);
+		}
+		WidenNumColumns(opts, snap);
+		cliTable.columns = opts->cliCols;
+		sysTable.columns = opts->sysCols;
+		rc = DrawWatchScreen(opts, snap, &cliTable, &sysTable);
+	}
+
+	while (rc == RETURN_OK)
+	{
+		// Park the cursor below the tables & show everything drawn so far
+		OutCursor(lastTable->firstLine + lastTable->count);
+		OutFlush();
+
+		// We're not running at all while waiting for the next refresh
+		if (!WaitTimer(timer, opts->watch, 0))
+			break;	// Exit the while loop
+
+		rc = CaptureTasks(opts, snap);
+		if (rc != RETURN_OK)
+			break;	// Exit the while loop
+
+		// CPU usage since the previous refresh
+		if (sampler) {
+			ReadSamples(sampler, snap);
+			if (opts->sort == SORT_CPU)
+				SortSamples(snap, opts->top);
+		}
+
+		// Everything moves over when a number column has to grow
+		redraw = WidenNumColumns(opts, snap);
+		cliTable.columns = opts->cliCols;
+		sysTable.columns = opts->sysCols;
+
+		// The Shell/CLI table can only grow in place if nothing is shown below it
+		if (!redraw && (opts->mode == MODE_ALL || opts->mode == MODE_CLI))
+			redraw = !UpdateWatchTable(opts, &cliTable, &snap->recs[snap->sysCount],
+									   snap->cliCount, opts->mode == MODE_CLI);
+		if (!redraw && (opts->mode == MODE_ALL || opts->mode == MODE_SYSTEM))
+			redraw = !UpdateWatchTable(opts, &sysTable, snap->recs, snap->sysCount, TRUE);
+
+		if (redraw)
+			rc = DrawWatchScreen(opts, snap, &cliTable, &sysTable);
+	}
+
+	OutFlush();
+	outBuf.eraseEol = FALSE;
+
+	if (cliTable.slots)
+		FreeVec(cliTable.slots);
+	if (sysTable.slots)
+		FreeVec(sysTable.slots);
+
+	CloseTimer(timer);
+
+	return rc;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Clears the screen and draws both tables from scratch.
+//--------------------------------------------------------------------------------
+int DrawWatchScreen(Options* opts, Snapshot* snap, WatchTable* cliTable, WatchTable* sysTable)
+{
+	int		rc = RETURN_OK;
+
+	OutStr(ESC_CLEAR_SCREEN);
+	outBuf.lines = 0;
+
+	if (opts->mode == MODE_ALL || opts->mode == MODE_CLI) {
+		PrintSectionHeader(opts, STR_CLI_HEADING, opts->cliCols);
+		rc = DrawWatchTable(opts, cliTable, &snap->recs[snap->sysCount], snap->cliCount);
+	}
+
+	if (rc == RETURN_OK && (opts->mode == MODE_ALL || opts->mode == MODE_SYSTEM)) {
+		PrintSectionHeader(opts, STR_SYS_HEADING, opts->sysCols);
+		rc = DrawWatchTable(opts, sysTable, snap->recs, snap->sysCount);
+	}
+
+	return rc;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Draws all rows of a table starting at the current line, one slot per record.
+//--------------------------------------------------------------------------------
+int DrawWatchTable(Options* opts, WatchTable* table, TaskRec* recs, ULONG count)
+{
+	ULONG	i;
+
+	if (!GrowWatchTable(table, count))
+		return RETURN_FAIL;
+
+	table->firstLine = outBuf.lines + 1;
+	table->count = count;
+
+	for (i = 0; i < count; i++) {
+		table->slots[i] = recs[i];
+		DrawWatchSlot(opts, table, i);
+	}
+
+	return RETURN_OK;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Compares the records of a new, sorted snapshot with the slots on screen line
+//	by line and redraws only the lines that changed. Lines past the end of the
+//	table are blanked. Returns FALSE if the table has to be drawn from scratch.
+//--------------------------------------------------------------------------------
+BOOL UpdateSortedWatchTable(Options* opts, WatchTable* table, TaskRec* recs, ULONG count, BOOL canGrow)
+{
+	TaskRec* slot;
+	ULONG	i;
+
+	if (count > table->count && (!canGrow || !GrowWatchTable(table, count)))
+		return FALSE;
+
+	for (i = 0; i < count; i++)
+	{
+		slot = &table->slots[i];
+		if (i < table->count && !(slot->flags & REC_FREE) && slot->task == recs[i].task &&
+			slot->cliNum == recs[i].cliNum && !TaskRecChanged(slot, &recs[i]))
+			continue;	// Go to next line
+
+		*slot = recs[i];
+		slot->flags &= ~REC_SEEN;
+		DrawWatchSlot(opts, table, i);
+	}
+
+	for (i = count; i < table->count; i++)
+		if (!(table->slots[i].flags & REC_FREE)) {
+			table->slots[i].flags = REC_FREE;
+			DrawWatchSlot(opts, table, i);
+		}
+
+	// The blanked lines can only be dropped if nothing is shown below them
+	if (canGrow || count > table->count)
+		table->count = count;
+
+	return TRUE;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Matches the records of a new snapshot against the slots on screen and redraws
+//	only the slots that changed. New tasks take over the slots of tasks that have
+//	gone away, or are added to the end of the table if canGrow is TRUE.
+//	Returns FALSE if the table has to be drawn from scratch.
+//--------------------------------------------------------------------------------
+BOOL UpdateWatchTable(Options* opts, WatchTable* table, TaskRec* recs, ULONG count, BOOL canGrow)
+{
+	TaskRec* slot;
+	ULONG	i, j, k;
+	ULONG	free = 0;
+
+	// Sorted tasks move between lines, so each line just follows its position
+	if (opts->sort != SORT_NONE)
+		return UpdateSortedWatchTable(opts, table, recs, count, canGrow);
+
+	for (j = 0; j < count; j++)
+		recs[j].flags &= ~REC_SEEN;
+
+	// Find the new record of each task on screen. Tasks tend to stay in roughly
+	// the same order, so start looking at the same position.
+	for (i = 0; i < table->count; i++)
+	{
+		slot = &table->slots[i];
+		if (slot->flags & REC_FREE)
+			continue;	// Go to next slot
+
+		j = i < count ? i : 0;
+		for (k = 0; k < count; k++) {
+			if (!(recs[j].flags & REC_SEEN) && recs[j].task == slot->task &&
+				recs[j].cliNum == slot->cliNum)
+				break;	// Exit the for loop
+			if (++j == count)
+				j = 0;
+		}
+
+		// The task has gone away. Its line is blanked below unless a new task
+		// takes over the slot.
+		if (k == count) {
+			slot->flags = REC_FREE | REC_SEEN;
+			continue;	// Go to next slot
+		}
+
+		recs[j].flags |= REC_SEEN;
+		if (TaskRecChanged(slot, &recs[j])) {
+			*slot = recs[j];
+			slot->flags &= ~REC_SEEN;
+			DrawWatchSlot(opts, table, i);
+		}
+	}
+
+	// Put new tasks in the first free slots
+	for (j = 0; j < count; j++)
+	{
+		if (recs[j].flags & REC_SEEN)
+			continue;	// Go to next record
+
+		while (free < table->count && !(table->slots[free].flags & REC_FREE))
+			free++;
+
+		if (free == table->count) {
+			if (!canGrow || !GrowWatchTable(table, table->count + 1))
+				return FALSE;
+			table->count++;
+		}
+
+		table->slots[free] = recs[j];
+		DrawWatchSlot(opts, table, free);
+	}
+
+	// Blank the lines of tasks that have gone away
+	for (i = 0; i < table->count; i++)
+		if ((table->slots[i].flags & (REC_FREE | REC_SEEN)) == (REC_FREE | REC_SEEN)) {
+			table->slots[i].flags = REC_FREE;
+			DrawWatchSlot(opts, table, i);
+		}
+
+	// Drop free slots from the end of the table. Their lines are already blank.
+	if (canGrow)
+		while (table->count > 0 && (table->slots[table->count - 1].flags & REC_FREE))
+			table->count--;
+
+	return TRUE;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Makes sure the table has room for at least count slots.
+//	Returns FALSE if there's not enough memory.
+//--------------------------------------------------------------------------------
+BOOL GrowWatchTable(WatchTable* table, ULONG count)
+{
+	TaskRec* slots;
+
+	if (count <= table->capacity)
+		return TRUE;
+
+	slots = AllocVec((count + SNAP_SLACK_RECS) * sizeof(TaskRec), MEMF_ANY);
+	if (slots == NULL) {
+		OutFlush();
+		PrintFault(ERROR_NO_FREE_STORE, NULL);
+		return FALSE;
+	}
+
+	if (table->slots) {
+		memcpy(slots, table->slots, table->count * sizeof(TaskRec));
+		FreeVec(table->slots);
+	}
+
+	table->slots = slots;
+	table->capacity = count + SNAP_SLACK_RECS;
+
+	return TRUE;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Redraws the line of a single slot, or blanks it if the slot is free.
+//--------------------------------------------------------------------------------
+void DrawWatchSlot(Options* opts, WatchTable* table, ULONG slot)
+{
+	TaskRec* rec = &table->slots[slot];
+
+	OutCursor(table->firstLine + slot);
+
+	if (rec->flags & REC_FREE)
+		OutNewline();
+	else
+		PrintRecord(table->columns, opts->show, rec,
+					table->cliNums ? rec->cliNum : (long)slot + 1);
+}
+
+
+//--------------------------------------------------------------------------------
+//	Returns TRUE if any of the shown details of a task differ between two records.
+//--------------------------------------------------------------------------------
+BOOL TaskRecChanged(const TaskRec* a, const TaskRec* b)
+{
+	return a->pri != b->pri || a->state != b->state || a->type != b->type ||
+		   a->stackUsed != b->stackUsed || a->stackSize != b->stackSize ||
+		   a->globVec != b->globVec || a->failLevel != b->failLevel ||
+		   a->returnCode != b->returnCode || a->cpu != b->cpu ||
+		   a->stackPeak != b->stackPeak || a->mem != b->mem || a->alert != b->alert ||
+		   a->queueCount != b->queueCount || a->waitCount != b->waitCount ||
+		   (a->flags & ~REC_SEEN) != (b->flags & ~REC_SEEN) ||
+		   strcmp(a->name, b->name) != 0 || strcmp(a->waitPort, b->waitPort) != 0;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Opens timer.device on the given unit with its own reply port.
+//	Returns NULL if it couldn't be opened.
+//--------------------------------------------------------------------------------
+struct timerequest* OpenTimer(ULONG unit)
+{
+	struct 	MsgPort* port;
+	struct 	timerequest* timer = NULL;
+
+	if ((port = CreateMsgPort()) != NULL) {
+		timer = (struct timerequest*)CreateIORequest(port, sizeof(struct timerequest));
+		if (timer != NULL && OpenDevice(TIMERNAME, unit, (struct IORequest*)timer, 0) == 0)
+			return timer;
+	}
+
+	if (timer)
+		DeleteIORequest((struct IORequest*)timer);
+	if (port)
+		DeleteMsgPort(port);
+
+	OutMsg(STR_ERR_OPEN_TIMER);
+	return NULL;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Closes a timer opened by OpenTimer() and frees its reply port.
+//--------------------------------------------------------------------------------
+void CloseTimer(struct timerequest* timer)
+{
+	struct 	MsgPort* port = timer->tr_node.io_Message.mn_ReplyPort;
+
+	CloseDevice((struct IORequest*)timer);
+	DeleteIORequest((struct IORequest*)timer);
+	DeleteMsgPort(port);
+}
+
+
+//--------------------------------------------------------------------------------
+//	Waits for the given time to pass.
+//	Returns FALSE if the wait was cut short by Ctrl-C.
+//--------------------------------------------------------------------------------
+BOOL WaitTimer(struct timerequest* timer, ULONG secs, ULONG micros)
+{
+	struct 	MsgPort* port = timer->tr_node.io_Message.mn_ReplyPort;
+	ULONG	sigs;
+
+	timer->tr_node.io_Command = TR_ADDREQUEST;
+	timer->tr_time.tv_secs = secs;
+	timer->tr_time.tv_micro = micros;
+	SendIO((struct IORequest*)timer);
+
+	sigs = Wait((1L << port->mp_SigBit) | SIGBREAKF_CTRL_C);
+
+	if (sigs & SIGBREAKF_CTRL_C) {
+		if (!CheckIO((struct IORequest*)timer))
+			AbortIO((struct IORequest*)timer);
+		WaitIO((struct IORequest*)timer);
+		OutFlush();
+		PrintFault(ERROR_BREAK, NULL);
+		return FALSE;
+	}
+
+	WaitIO((struct IORequest*)timer);
+	return TRUE;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Starts taking CPU usage samples in the background.
+//	Returns NULL if the sampler couldn't be started.
+//--------------------------------------------------------------------------------
+Sampler* StartSampler(void)
+{
+	Sampler* sampler;
+
+	// The interrupt accesses this, so it has to be public memory
+	sampler = AllocVec(sizeof(Sampler), MEMF_PUBLIC | MEMF_CLEAR);
+	if (sampler == NULL) {
+		PrintFault(ERROR_NO_FREE_STORE, NULL);
+		return NULL;
+	}
+
+	sampler->owner = FindTask(NULL);
+	sampler->sysBase = SysBase;
+	if ((sampler->doneSig = AllocSignal(-1)) == -1) {
+		FreeVec(sampler);
+		PrintFault(ERROR_NO_FREE_STORE, NULL);
+		return NULL;
+	}
+
+	// Replying the timer request to this port causes the software interrupt
+	sampler->interrupt.is_Node.ln_Type = NT_INTERRUPT;
+	sampler->interrupt.is_Node.ln_Name = PROGRAM;
+	sampler->interrupt.is_Data = sampler;
+	sampler->interrupt.is_Code = (void (*)())SampleHandler;
+
+	sampler->port.mp_Node.ln_Type = NT_MSGPORT;
+	sampler->port.mp_Flags = PA_SOFTINT;
+	sampler->port.mp_SigTask = &sampler->interrupt;
+	NewList(&sampler->port.mp_MsgList);
+
+	sampler->timer.tr_node.io_Message.mn_Node.ln_Type = NT_REPLYMSG;
+	sampler->timer.tr_node.io_Message.mn_ReplyPort = &sampler->port;
+	sampler->timer.tr_node.io_Message.mn_Length = sizeof(struct timerequest);
+
+	if (OpenDevice(TIMERNAME, UNIT_MICROHZ, (struct IORequest*)&sampler->timer, 0) != 0) {
+		FreeSignal(sampler->doneSig);
+		FreeVec(sampler);
+		OutMsg(STR_ERR_OPEN_TIMER);
+		return NULL;
+	}
+
+	TimerBase = sampler->timer.tr_node.io_Device;
+	ReadEClock(&sampler->lastRead);
+
+	// From here on, the interrupt keeps resending the request itself
+	sampler->running = TRUE;
+	sampler->timer.tr_node.io_Command = TR_ADDREQUEST;
+	sampler->timer.tr_time.tv_secs = 0;
+	sampler->timer.tr_time.tv_micro = SAMPLE_PERIOD_US;
+	SendIO((struct IORequest*)&sampler->timer);
+
+	return sampler;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Stops the sampler and frees it.
+//--------------------------------------------------------------------------------
+void StopSampler(Sampler* sampler)
+{
+	// The interrupt signals us instead of resending the request once it sees
+	// that we want to stop, which happens within one sample period
+	sampler->running = FALSE;
+	while (!sampler->done)
+		Wait(1L << sampler->doneSig);
+
+	CloseDevice((struct IORequest*)&sampler->timer);
+	if (!timing.open)
+		TimerBase = NULL;
+
+	FreeSignal(sampler->doneSig);
+	FreeVec(sampler);
+}
+
+
+//--------------------------------------------------------------------------------
+//	Collects the samples taken since the last call and fills in the CPU usage of
+//	each system task/process in the snapshot.
+//--------------------------------------------------------------------------------
+void ReadSamples(Sampler* sampler, Snapshot* snap)
+{
+	SampleBank* bank;
+	struct 	EClockVal now;
+	ULONG	elapsed;
+	ULONG	slot;
+	ULONG	probe;
+	ULONG	i;
+	TaskRec* rec;
+
+	// Let the interrupt fill the other bank while we read this one. An
+	// interrupt always runs to its end before this task carries on, so once
+	// active is switched nothing more is written to this bank until the next
+	// call switches it back, even though the sampler keeps running.
+	bank = &sampler->banks[sampler->active];
+	sampler->active ^= 1;
+
+	ReadEClock(&now);
+	elapsed = now.ev_lo - sampler->lastRead.ev_lo;
+	sampler->lastRead = now;
+
+	snap->cpu.samples = bank->samples;
+	snap->cpu.lost = bank->lost;
+	snap->cpu.idle = bank->samples ? bank->idle * 1000 / bank->samples : 0;
+	snap->cpu.overhead = elapsed >= 1000 ? bank->handlerTicks / (elapsed / 1000) : 0;
+
+	for (i = 0; i < snap->sysCount; i++)
+	{
+		rec = &snap->recs[i];
+		rec->cpu = 0;
+
+		if (bank->samples == 0 || rec->task == NULL)
+			continue;	// Go to next record
+
+		slot = ((ULONG)rec->task >> 4) & (SAMPLE_SLOTS - 1);
+		for (probe = 0; probe < SAMPLE_PROBES; probe++) {
+			if (bank->hits[slot].task == rec->task) {
+				rec->cpu = (UWORD)(bank->hits[slot].hits * 1000 / bank->samples);
+				break;	// Exit the for loop
+			}
+			if (bank->hits[slot].task == NULL)
+				break;	// Exit the for loop
+			slot = (slot + 1) & (SAMPLE_SLOTS - 1);
+		}
+	}
+
+	// Empty the bank for its next turn
+	memset(bank, 0, sizeof(SampleBank));
+}
+
+
+//--------------------------------------------------------------------------------
+//	Puts the tables in SORT=CPU order once ReadSamples() has filled in the CPU
+//	usage, which isn't known yet while the tasks are walked, so TOP can only be
+//	applied now. Only system tasks have any; the other tables stay in their
+//	usual order. The tables are moved down over the rows TOP drops.
+//--------------------------------------------------------------------------------
+void SortSamples(Snapshot* snap, ULONG top)
+{
+	ULONG	cliFirst = snap->sysCount;
+	ULONG	to;
+	ULONG	from;
+	ULONG	i;
+
+	SortTaskRecs(snap->recs, snap->sysCount, SORT_CPU, FALSE);
+	if (!top)
+		return;
+
+	to = KeepTopRecs(snap, 0, 0, &snap->sysCount, top);
+	to = KeepTopRecs(snap, to, cliFirst, &snap->cliCount, top);
+	for (i = 0; i < LIST_COUNT; i++) {
+		if (snap->lists & (1 << i)) {
+			from = snap->listFirst[i];
+			snap->listFirst[i] = to;
+			to = KeepTopRecs(snap, to, from, &snap->listCount[i], top);
+		}
+	}
+}
+
+
+//--------------------------------------------------------------------------------
+//	Keeps the first top of the count records at from, moving them down to to.
+//	Returns the record after the last one kept.
+//--------------------------------------------------------------------------------
+ULONG KeepTopRecs(Snapshot* snap, ULONG to, ULONG from, ULONG* count, ULONG top)
+{
+	if (*count > top)
+		*count = top;
+	if (to != from)
+		memmove(&snap->recs[to], &snap->recs[from], *count * sizeof(TaskRec));
+
+	return to + *count;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Prints how many samples the CPU% column is based on, how much of the time
+//	the CPU was idle and how much of it the sampler itself used.
+//--------------------------------------------------------------------------------
+void PrintSampleSummary(Snapshot* snap)
+{
+	OutNewline();
+	OutStr(STR_SAMPLE_SUMMARY);
+	OutChar(' ');
+	OutNum(snap->cpu.samples, 1, ALIGN_RIGHT);
+	OutStr(", " STR_SAMPLE_IDLE " ");
+	OutTenths(snap->cpu.idle, 1, ALIGN_RIGHT);
+	OutStr("%, " STR_SAMPLE_OVERHEAD " ");
+	OutTenths(snap->cpu.overhead, 1, ALIGN_RIGHT);
+	OutChar('%');
+	if (snap->cpu.lost) {
+		OutStr(", ");
+		OutNum(snap->cpu.lost, 1, ALIGN_RIGHT);
+		OutStr(" " STR_SAMPLE_LOST);
+	}
+	OutNewline();
+}
+
+
+//--------------------------------------------------------------------------------
+//	Prints the free memory line shown above the tables with MEM.
+//--------------------------------------------------------------------------------
+void PrintMemSummary(Snapshot* snap)
+{
+	OutStr(STR_MEM_SUMMARY " ");
+	OutNum(snap->mem.chip, 1, ALIGN_LEFT);
+	OutStr(" " STR_MEM_CHIP " (" STR_MEM_LARGEST " ");
+	OutNum(snap->mem.chipLargest, 1, ALIGN_LEFT);
+	OutStr("), ");
+	OutNum(snap->mem.fast, 1, ALIGN_LEFT);
+	OutStr(" " STR_MEM_FAST " (" STR_MEM_LARGEST " ");
+	OutNum(snap->mem.fastLargest, 1, ALIGN_LEFT);
+	OutChar(')');
+	OutNewline();
+}
+
+
+//--------------------------------------------------------------------------------
+//	Prints how many of the PROCESS numbers were found.
+//--------------------------------------------------------------------------------
+void PrintProcSummary(Options* opts, Snapshot* snap)
+{
+	OutStr(STR_PROC_SUMMARY " ");
+	OutNum(opts->pickCount - snap->missing, 1, ALIGN_LEFT);
+	OutStr(" " STR_PROC_OF " ");
+	OutNum(opts->pickCount, 1, ALIGN_LEFT);
+	OutNewline();
+}
+
+
+//--------------------------------------------------------------------------------
+//	Prints how many processes the BREAK signals were sent to.
+//--------------------------------------------------------------------------------
+void PrintBreakSummary(Snapshot* snap)
+{
+	OutStr(STR_BREAK_SUMMARY " ");
+	OutNum(snap->broken, 1, ALIGN_LEFT);
+	OutNewline();
+}
+
+
+//--------------------------------------------------------------------------------
+//	Prints the tasks PRI was applied to, with their old & new priorities, in
+//	the same form as DIFF, then how many there were. Returns RETURN_WARN if
+//	none were found.
+//--------------------------------------------------------------------------------
+int PrintPriChanges(Options* opts, Snapshot* snap)
+{
+	TaskRec* rec;
+	ULONG	i;
+
+	for (i = 0; i < snap->sysCount + snap->cliCount; i++)
+	{
+		rec = &snap->recs[i];
+		if (!(rec->flags & REC_REPRI))
+			continue;	// Go to next task
+
+		PrintDiffLine('*', rec, i >= snap->sysCount);
+		OutStr(": " STR_DIFF_PRI " ");
+		OutNum(rec->pri, 1, ALIGN_LEFT);
+		OutStr(" " STR_DIFF_TO " ");
+		OutNum(opts->newPri, 1, ALIGN_LEFT);
+		OutNewline();
+		timing.rows++;
+	}
+
+	if (!opts->noHead) {
+		OutStr(opts->dryRun ? STR_PRI_DRYRUN " " : STR_PRI_SUMMARY " ");
+		OutNum(snap->repri, 1, ALIGN_LEFT);
+		OutNewline();
+	}
+
+	return snap->repri ? RETURN_OK : RETURN_WARN;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Prints each region of free memory for MEMMAP: its size, how much of it is
+//	free in how many chunks, the largest chunk & how fragmented it is, then how
+//	many chunks there are of each size.
+//--------------------------------------------------------------------------------
+int PrintMemMap(Options* opts)
+{
+	MemRegion* regions;
+	MemRegion* region;
+	ULONG	count;
+	ULONG	i, n;
+
+	regions = AllocVec(MEMMAP_MAX_REGIONS * sizeof(MemRegion), MEMF_ANY);
+	if (regions == NULL) {
+		PrintFault(ERROR_NO_FREE_STORE, NULL);
+		return RETURN_FAIL;
+	}
+
+	count = SnapMemMap(regions, MEMMAP_MAX_REGIONS);
+
+	if (!opts->noHead)
+		OutMsg(STR_MEMMAP_HEADING);
+
+	for (i = 0; i < count; i++)
+	{
+		region = &regions[i];
+
+		OutNewline();
+		OutStr(region->name);
+		OutStr(" (");
+		OutStr(region->attributes & MEMF_CHIP ? STR_MEM_CHIP :
+			   region->attributes & MEMF_FAST ? STR_MEM_FAST : STR_MEMMAP_OTHER);
+		OutStr("): " STR_MEMMAP_SIZE " ");
+		OutNum(region->size, 1, ALIGN_LEFT);
+		OutStr(", " STR_MEMMAP_FREE " ");
+		OutNum(region->free, 1, ALIGN_LEFT);
+		OutStr(" " STR_MEMMAP_IN " ");
+		OutNum(region->chunks, 1, ALIGN_LEFT);
+		OutStr(" " STR_MEMMAP_CHUNKS ", " STR_MEM_LARGEST " ");
+		OutNum(region->largest, 1, ALIGN_LEFT);
+		OutStr(", " STR_MEMMAP_FRAG " ");
+		OutTenths(Fragmentation(region), 1, ALIGN_LEFT);
+		OutChar('%');
+		OutNewline();
+
+		if (!opts->noHead) {
+			OutMsg(STR_MEMMAP_HEAD_TOP);
+			OutMsg(STR_MEMMAP_HEAD_LINE);
+		}
+
+		for (n = 0; n < MEMMAP_CLASSES; n++)
+		{
+			if (region->classCount[n] == 0)
+				continue;	// Go to next size class
+
+			OutChar(' ');
+			OutNum(1UL << n, 10, ALIGN_RIGHT);
+			OutStr(" - ");
+			OutNum((2UL << n) - 1, 8, ALIGN_LEFT);
+			OutChar(' ');
+			OutNum(region->classCount[n], 8, ALIGN_RIGHT);
+			OutChar(' ');
+			OutNum(region->classBytes[n], 11, ALIGN_RIGHT);
+			OutNewline();
+			timing.rows++;
+		}
+	}
+
+	FreeVec(regions);
+
+	return RETURN_OK;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Counts the free chunks of each MemHeader into regions, up to max of them,
+//	& returns how many there are. Each free list is walked once, & only the
+//	size class counters are updated while holding Forbid(), so it stays short
+//	even with thousands of free chunks. The totals are added up after Permit().
+//--------------------------------------------------------------------------------
+ULONG SnapMemMap(MemRegion* regions, ULONG max)
+{
+	struct 	EClockVal started;
+	struct 	MemHeader* mh;
+	struct 	MemChunk* mc;
+	MemRegion* region;
+	ULONG	count = 0;
+	ULONG	bytes;
+	ULONG	ticks;
+	ULONG	i, n;
+
+	memset(regions, 0, max * sizeof(MemRegion));
+
+	TimingStart(&started);
+	Forbid();
+	{
+		for (mh = (struct MemHeader*)SysBase->MemList.lh_Head;
+			 mh->mh_Node.ln_Succ != NULL && count < max;
+			 mh = (struct MemHeader*)mh->mh_Node.ln_Succ)
+		{
+			region = &regions[count++];
+			strcpyn(region->name, mh->mh_Node.ln_Name, sizeof(region->name));
+			region->attributes = mh->mh_Attributes;
+			region->size = (ULONG)mh->mh_Upper - (ULONG)mh->mh_Lower;
+
+			for (mc = mh->mh_First; mc != NULL; mc = mc->mc_Next) {
+				bytes = mc->mc_Bytes;
+				n = SizeClass(bytes);
+				region->classCount[n]++;
+				region->classBytes[n] += bytes;
+				if (bytes > region->largest)
+					region->largest = bytes;
+			}
+		}
+	} // End Forbid() section
+	Permit();
+
+	ticks = TimingStop(&started);
+	timing.forbids++;
+	timing.forbidTicks += ticks;
+	if (ticks > timing.forbidMaxTicks)
+		timing.forbidMaxTicks = ticks;
+
+	for (i = 0; i < count; i++) {
+		for (n = 0; n < MEMMAP_CLASSES; n++) {
+			regions[i].chunks += regions[i].classCount[n];
+			regions[i].free += regions[i].classBytes[n];
+		}
+	}
+
+	return count;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Returns the size class of a free chunk: the number of its highest set bit.
+//--------------------------------------------------------------------------------
+ULONG SizeClass(ULONG bytes)
+{
+	ULONG	n = 0;
+
+	if (bytes >= 1UL << 16) { bytes >>= 16; n += 16; }
+	if (bytes >= 1UL << 8)  { bytes >>= 8;  n += 8; }
+	if (bytes >= 1UL << 4)  { bytes >>= 4;  n += 4; }
+	if (bytes >= 1UL << 2)  { bytes >>= 2;  n += 2; }
+	if (bytes >= 1UL << 1)  n += 1;
+
+	return n;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Returns how fragmented a region's free memory is, in tenths of a percent:
+//	how much of it isn't in the largest chunk. 0 means it's all in one piece.
+//--------------------------------------------------------------------------------
+LONG Fragmentation(const MemRegion* region)
+{
+	ULONG	largest = region->largest;
+	ULONG	free = region->free;
+
+	// Scale both down until largest * 1000 fits, so no 64-bit maths is needed
+	while (largest > 0x3FFFFF) {
+		largest >>= 4;
+		free >>= 4;
+	}
+
+	return free ? 1000 - (LONG)(largest * 1000 / free) : 0;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Patches AddTask() & RemTask() so every task added or removed is recorded in
+//	a ring buffer, and shows the events as they come until Ctrl-C is pressed.
+//	The patches are removed before returning. Processes made by CreateNewProc()
+//	& friends are added with AddTask() too, so they're traced by the same patch.
+//	Returns RETURN_WARN if events were dropped.
+//--------------------------------------------------------------------------------
+int RunTrace(Options* opts)
+{
+	struct 	timerequest* timer;
+	struct 	EClockVal now;
+	BOOL	warned = FALSE;
+	int		rc = RETURN_OK;
+	TraceGate* gate;
+
+	// The patches run in other tasks, so it has to be public memory
+	tracer = AllocVec(sizeof(Tracer), MEMF_PUBLIC | MEMF_CLEAR);
+	gate = AllocVec(sizeof(TraceGate), MEMF_PUBLIC | MEMF_CLEAR);
+	if (tracer == NULL || gate == NULL) {
+		PrintFault(ERROR_NO_FREE_STORE, NULL);
+		FreeVec(gate);
+		FreeVec(tracer);
+		tracer = NULL;
+		return RETURN_FAIL;
+	}
+
+	if ((timer = OpenTimer(UNIT_VBLANK)) == NULL) {
+		FreeVec(gate);
+		FreeVec(tracer);
+		tracer = NULL;
+		return RETURN_FAIL;
+	}
+
+	tracer->gate = gate;
+	gate->tracer = tracer;
+	BuildTraceStub(gate, &gate->addTask, (APTR)TraceAddTask);
+	BuildTraceStub(gate, &gate->remTask, (APTR)TraceRemTask);
+	CacheClearU();
+	gate->active = TRUE;
+
+	// The patches time stamp the events with the E-clock
+	TimerBase = timer->tr_node.io_Device;
+	tracer->timerBase = TimerBase;
+	tracer->msTicks = ReadEClock(&now) / 1000;
+	if (tracer->msTicks == 0)
+		tracer->msTicks = 1;
+	tracer->lastTick = now.ev_lo;
+
+	if (opts->encoding != ENCODE_TEXT)
+		EncodeTableStart(opts, KEY_TRACE_TABLE, 0, traceColumns, 0);
+	else if (!opts->noHead)
+		PrintTableHeader(traceColumns, opts->show);
+	OutFlush();
+
+	// Nothing can go through a stub before its old vector is filled in
+	Forbid();
+	gate->addTask.old = SetFunction((struct Library*)SysBase, LVO_ADDTASK,
+									(ULONG (*)())gate->addTask.code);
+	gate->remTask.old = SetFunction((struct Library*)SysBase, LVO_REMTASK,
+									(ULONG (*)())gate->remTask.code);
+	Permit();
+
+	// WaitTimer() only returns FALSE once Ctrl-C is pressed
+	while (WaitTimer(timer, 0, TRACE_PERIOD_US))
+		DrainTrace(opts, tracer);
+
+	// Somebody who patched the vectors after us has to go first, or their
+	// patch would be left calling ours once we've gone
+	while (!RemoveTracePatches(tracer)) {
+		if (!warned) {
+			OutFlush();
+			OutMsg(STR_TRACE_PATCHED);
+			OutFlush();
+			warned = TRUE;
+		}
+		Delay(TRACE_RETRY_TICKS);
+	}
+
+	// A task may still be inside one of the patches, and returns through it.
+	// Any task that gets into a stub from now on goes straight past them.
+	while (gate->users)
+		Delay(1);
+
+	DrainTrace(opts, tracer);
+
+	if (opts->encoding == ENCODE_TEXT && !opts->noHead) {
+		OutNewline();
+		OutStr(STR_TRACE_SUMMARY " ");
+		OutNum(tracer->head, 1, ALIGN_LEFT);
+		OutStr(", ");
+		OutNum(tracer->dropped, 1, ALIGN_LEFT);
+		OutStr(" " STR_TRACE_DROPPED);
+		OutNewline();
+	}
+
+	if (tracer->dropped)
+		rc = RETURN_WARN;
+
+	CloseTimer(timer);
+	if (!timing.open)
+		TimerBase = NULL;
+
+	// The gate is left behind for tasks that are yet to get through a stub
+	FreeVec(tracer);
+	tracer = NULL;
+
+	return rc;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Writes the code of a TRACE entry stub, which finds users, active, the
+//	tracer & the stub's old vector at their addresses in the gate, and calls
+//	the patch directly.
+//--------------------------------------------------------------------------------
+void BuildTraceStub(TraceGate* gate, TraceStub* stub, APTR patch)
+{
+	static const UWORD code[TRACE_STUB_WORDS] = {
+		0x52B9, 0, 0,		// addq.l	#1,users
+		0x4A79, 0, 0,		// tst.w	active
+		0x6714,				// beq.s	.old
+		0x2079, 0, 0,		// movea.l	tracer,a0
+		0x4EB9, 0, 0,		// jsr		patch
+		0x53B9, 0, 0,		// subq.l	#1,users
+		0x4E75,				// rts
+		0x53B9, 0, 0,		// .old: subq.l #1,users
+		0x2079, 0, 0,		// movea.l	old,a0
+		0x4ED0				// jmp		(a0)
+	};
+	static const UBYTE users[] = { 1, 14, 18 };	// Operands of users
+	ULONG	addr;
+	ULONG	i;
+
+	memcpy(stub->code, code, sizeof(code));
+	for (i = 0; i < sizeof(users); i++) {
+		stub->code[users[i]] = (UWORD)((ULONG)&gate->users >> 16);
+		stub->code[users[i] + 1] = (UWORD)(ULONG)&gate->users;
+	}
+	addr = (ULONG)&gate->active;
+	stub->code[4] = (UWORD)(addr >> 16);
+	stub->code[5] = (UWORD)addr;
+	addr = (ULONG)&gate->tracer;
+	stub->code[8] = (UWORD)(addr >> 16);
+	stub->code[9] = (UWORD)addr;
+	addr = (ULONG)patch;
+	stub->code[11] = (UWORD)(addr >> 16);
+	stub->code[12] = (UWORD)addr;
+	addr = (ULONG)&stub->old;
+	stub->code[21] = (UWORD)(addr >> 16);
+	stub->code[22] = (UWORD)addr;
+
+	stub->patch = patch;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Puts back the vectors the TRACE patches replaced & shuts the gate. Returns
+//	FALSE, leaving them as they are, if another program has patched them since.
+//--------------------------------------------------------------------------------
+BOOL RemoveTracePatches(Tracer* tracer)
+{
+	struct 	Library* lib = (struct Library*)SysBase;
+	TraceGate* gate = tracer->gate;
+	APTR	addTask;
+	APTR	remTask;
+	BOOL	ours;
+
+	Forbid();
+	addTask = SetFunction(lib, LVO_ADDTASK, (ULONG (*)())gate->addTask.old);
+	remTask = SetFunction(lib, LVO_REMTASK, (ULONG (*)())gate->remTask.old);
+	ours = addTask == (APTR)gate->addTask.code && remTask == (APTR)gate->remTask.code;
+	if (!ours) {
+		SetFunction(lib, LVO_ADDTASK, (ULONG (*)())addTask);
+		SetFunction(lib, LVO_REMTASK, (ULONG (*)())remTask);
+	}
+	else
+		gate->active = FALSE;
+	Permit();
+
+	return ours;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Shows the TRACE events recorded since the last call, and how many were
+//	dropped because the ring buffer filled up in between.
+//--------------------------------------------------------------------------------
+void DrainTrace(Options* opts, Tracer* tracer)
+{
+	TraceEvent* event;
+	TaskRec	rec;
+	struct 	EClockVal now;
+	ULONG	head;
+
+	// If nothing has happened, any event from now on is later than now, so
+	// the clock can be moved on to it. That keeps it from wrapping.
+	ReadEClock(&now);
+	head = tracer->head;
+	if (head == tracer->tail)
+		AdvanceTraceClock(tracer, now.ev_lo);
+
+	for (; tracer->tail != head; tracer->tail++)
+	{
+		event = &tracer->events[tracer->tail & (TRACE_EVENTS - 1)];
+		AdvanceTraceClock(tracer, event->time.ev_lo);
+
+		if ((opts->mode == MODE_CLI && event->cliNum == 0) ||
+			(opts->mode == MODE_SYSTEM && event->cliNum != 0))
+			continue;	// Go to next event
+
+		memset(&rec, 0, sizeof(rec));
+		rec.task = event->task;
+		rec.cliNum = event->cliNum;
+		rec.pri = event->pri;
+		rec.type = event->type;
+		rec.event = event->event;
+		strcpyn(rec.name, event->name, sizeof(rec.name));
+
+		if (opts->encoding != ENCODE_TEXT)
+			EncodeRecord(opts, traceColumns, &rec, (long)tracer->msecs, FALSE);
+		else
+			PrintRecord(traceColumns, opts->show, &rec, (long)tracer->msecs);
+	}
+
+	// Events are only dropped once the ring is full, so after the ones in it
+	if (tracer->dropped != tracer->shown && opts->encoding == ENCODE_TEXT) {
+		OutChar(' ');
+		OutNum(tracer->dropped - tracer->shown, 1, ALIGN_LEFT);
+		OutChar(' ');
+		OutMsg(STR_TRACE_LOST);
+		tracer->shown = tracer->dropped;
+	}
+
+	OutFlush();
+}
+
+
+//--------------------------------------------------------------------------------
+//	Moves the TRACE clock on to E-clock time tick, counting the milliseconds
+//	since TRACE started without 64-bit maths. Only the low longword of the
+//	E-clock is used, so it must be moved on at least once an hour.
+//--------------------------------------------------------------------------------
+void AdvanceTraceClock(Tracer* tracer, ULONG tick)
+{
+	ULONG	ticks = tick - tracer->lastTick + tracer->spareTicks;
+
+	tracer->msecs += ticks / tracer->msTicks;
+	tracer->spareTicks = ticks % tracer->msTicks;
+	tracer->lastTick = tick;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Software interrupt run each time the sampler's timer request comes back.
+//	Notes which task was running and sends the request off again. Runs with
+//	task switching stopped, so it must be short and must not call dos.library.
+//	a4 isn't ours in an interrupt, and a resident ShowProc's data is a copy per
+//	run, so the library bases come from the sampler rather than the globals.
+//--------------------------------------------------------------------------------
+void __asm SampleHandler(register __a1 Sampler* sampler)
+{
+	struct 	ExecBase* SysBase = sampler->sysBase;
+	struct 	Device* TimerBase = sampler->timer.tr_node.io_Device;
+	SampleBank* bank = &sampler->banks[sampler->active];
+	struct 	EClockVal start;
+	struct 	EClockVal end;
+	struct 	Task* task;
+	ULONG	slot;
+	ULONG	probe;
+
+	ReadEClock(&start);
+
+	// Take the timer request off the port
+	GetMsg(&sampler->port);
+
+	// The interrupted task is still ThisTask. If it isn't running, the CPU
+	// was idle waiting for something to do.
+	task = SysBase->ThisTask;
+	bank->samples++;
+
+	if (task == NULL || task->tc_State != TS_RUN)
+		bank->idle++;
+	else {
+		slot = ((ULONG)task >> 4) & (SAMPLE_SLOTS - 1);
+		for (probe = 0; probe < SAMPLE_PROBES; probe++) {
+			if (bank->hits[slot].task == task || bank->hits[slot].task == NULL) {
+				bank->hits[slot].task = task;
+				bank->hits[slot].hits++;
+				break;	// Exit the for loop
+			}
+			slot = (slot + 1) & (SAMPLE_SLOTS - 1);
+		}
+		if (probe == SAMPLE_PROBES)
+			bank->lost++;
+	}
+
+	if (sampler->running) {
+		sampler->timer.tr_node.io_Command = TR_ADDREQUEST;
+		sampler->timer.tr_time.tv_secs = 0;
+		sampler->timer.tr_time.tv_micro = SAMPLE_PERIOD_US;
+		SendIO((struct IORequest*)&sampler->timer);
+	}
+	else {
+		sampler->done = TRUE;
+		Signal(sampler->owner, 1L << sampler->doneSig);
+	}
+
+	ReadEClock(&end);
+	bank->handlerTicks += end.ev_lo - start.ev_lo;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Appends an event to the TRACE ring buffer, or counts it as dropped if the
+//	reader is a whole ring behind.
+//	Runs in whichever task called AddTask() or RemTask(), so it must not
+//	allocate, wait or call dos.library, and must not touch any globals: a4
+//	is the caller's, & a resident ShowProc's data is a copy per run anyway.
+//	The library bases are locals so the calls go through them.
+//--------------------------------------------------------------------------------
+void TraceTask(Tracer* tracer, struct ExecBase* SysBase, struct Task* task, UBYTE event)
+{
+	struct 	Device* TimerBase = tracer->timerBase;
+	TraceEvent* ev;
+
+	// One writer at a time, so the ring only ever has one producer
+	Forbid();
+	if (tracer->head - tracer->tail >= TRACE_EVENTS)
+		tracer->dropped++;
+	else {
+		ev = &tracer->events[tracer->head & (TRACE_EVENTS - 1)];
+		ReadEClock(&ev->time);
+		ev->task = task;
+		ev->pri = task->tc_Node.ln_Pri;
+		ev->type = task->tc_Node.ln_Type;
+		ev->event = event;
+		ev->cliNum = 0;
+		if (ev->type == NT_PROCESS && ((struct Process*)task)->pr_CLI != 0)
+			ev->cliNum = ((struct Process*)task)->pr_TaskNum;
+		if (task->tc_Node.ln_Name != NULL)
+			strcpyn(ev->name, task->tc_Node.ln_Name, sizeof(ev->name));
+		else
+			ev->name[0] = '\0';
+
+		// The reader can only see the event once it's complete
+		tracer->head++;
+	}
+	Permit();
+}
+
+
+//--------------------------------------------------------------------------------
+//	AddTask() patch installed by TRACE, called through its stub. The task is
+//	recorded before it's added, as it may run & end before the real AddTask()
+//	returns.
+//--------------------------------------------------------------------------------
+APTR __asm TraceAddTask(register __a0 Tracer* tracer, register __a1 struct Task* task,
+						register __a2 APTR initPC, register __a3 APTR finalPC,
+						register __a6 struct ExecBase* SysBase)
+{
+	TraceTask(tracer, SysBase, task, TRACE_ADDED);
+	return ((AddTaskFunc)tracer->gate->addTask.old)(task, initPC, finalPC, SysBase);
+}
+
+
+//--------------------------------------------------------------------------------
+//	RemTask() patch installed by TRACE, called through its stub. A task
+//	removing itself never returns to the stub, so it's counted out here before
+//	it goes. That's done under a Forbid() that's never undone: the reader can't
+//	see users drop & unload the patch until the real RemTask() has switched
+//	away from this task for good.
+//--------------------------------------------------------------------------------
+void __asm TraceRemTask(register __a0 Tracer* tracer, register __a1 struct Task* task,
+						register __a6 struct ExecBase* SysBase)
+{
+	struct 	Task* self = SysBase->ThisTask;
+	TraceGate* gate = tracer->gate;
+	RemTaskFunc oldRemTask = (RemTaskFunc)gate->remTask.old;
+
+	TraceTask(tracer, SysBase, task != NULL ? task : self, TRACE_REMOVED);
+
+	if (task == NULL || task == self) {
+		Forbid();
+		gate->users--;
+	}
+
+	oldRemTask(task, SysBase);
+}
+
+
+//--------------------------------------------------------------------------------
+// Sanitizes the COMMAND names/patterns and tokenizes them with
+// ParsePatternNoCase(), so it's only done once rather than for every CLI.
+// Returns TRUE if all of them are valid, FALSE otherwise.
+//--------------------------------------------------------------------------------
+BOOL CompileCommandPatterns(Options* opts, char** names)
+{
+	const char* msg;
+	ULONG	count;
+
+	for (count = 0; names != NULL && names[count] != NULL; count++)
+		;
+
+	if (count == 0) {
+		OutMsg(STR_ERR_INV_CMD_NAME);
+		return FALSE;
+	}
+
+	opts->patterns = AllocVec(count * sizeof(CmdPattern), MEMF_ANY);
+	if (opts->patterns == NULL) {
+		PrintFault(ERROR_NO_FREE_STORE, NULL);
+		return FALSE;
+	}
+
+	for (opts->patCount = 0; opts->patCount < count; opts->patCount++)
+	{
+		if ((msg = CompileCommandPattern(&opts->patterns[opts->patCount],
+										 names[opts->patCount])) != NULL) {
+			OutMsg(msg);
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Checks & tokenizes a single COMMAND name or pattern. Nothing is output, so
+//	the snapshot API can use it too.
+//	Returns NULL, or the message to show if the name or pattern is invalid.
+//--------------------------------------------------------------------------------
+const char* CompileCommandPattern(CmdPattern* pat, const char* name)
+{
+	long	result;
+
+	if (!SanitizeCommandName(pat->text, name))
+		return STR_ERR_INV_CMD_NAME;
+
+	// Check if the user-supplied command string contains any wildcards
+	result = ParsePatternNoCase(pat->text, pat->parsed, sizeof(pat->parsed));
+
+	// Invalid pattern
+	if (result == -1)
+		return STR_INV_CMD_PAT;
+
+	pat->wild = (result == 1);
+	pat->length = strlen(pat->text);
+	pat->prefixLen = pat->wild ? strcspn(pat->text, CMD_PAT_WILDCARDS) : pat->length;
+
+	return NULL;
+}
+
+
+//--------------------------------------------------------------------------------
+// Checks if any of the given command patterns matches the command name.
+// Returns TRUE if one matches, FALSE if none do.
+//--------------------------------------------------------------------------------
+BOOL CheckCommandMatch(const char* cmd_name, const CmdPattern* patterns, ULONG count)
+{
+	const CmdPattern* pat;
+	ULONG	len;
+	ULONG	i;
+
+	// Validate parameters
+	if (cmd_name == NULL || cmd_name[0] == '\0')
+		return FALSE;
+
+	len = strlen(cmd_name);
+
+	for (i = 0; i < count; i++)
+	{
+		pat = &patterns[i];
+
+		// No wildcards, do a simple string compare if the lengths are the same
+		if (!pat->wild) {
+			if (len == pat->length && stricmp(cmd_name, pat->text) == 0)
+				return TRUE;
+			continue;
+		}
+
+		// Wildcards found. Rule out names that don't start with the pattern's
+		// literal prefix before running the full matcher.
+		if (pat->prefixLen > len || strnicmp(cmd_name, pat->text, pat->prefixLen) != 0)
+			continue;
+
+		if (MatchPatternNoCase((char*)pat->parsed, (char*)cmd_name))
+			return TRUE;
+	}
+
+	// No match was found
+	return FALSE;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Parses the PROCESS numbers. ReadArgs only allows one /M argument, so they're
+//	given as a single comma-separated list of numbers & ranges, e.g. "2,5-8".
+//	Marks each one in opts->picks and sets start & finish to the lowest & the
+//	highest. Returns TRUE if all of them are valid, FALSE otherwise.
+//--------------------------------------------------------------------------------
+BOOL ParseProcessNumbers(Options* opts, const char* text)
+{
+	long	first;
+	long	last;
+	long	num;
+
+	opts->picks = AllocVec(PROC_MAX_NUM / 8 + 1, MEMF_ANY | MEMF_CLEAR);
+	if (opts->picks == NULL) {
+		PrintFault(ERROR_NO_FREE_STORE, NULL);
+		return FALSE;
+	}
+
+	opts->start = PROC_MAX_NUM;
+	opts->finish = 1;
+
+	for (;;)
+	{
+		if (!isdigit((unsigned char)*text)) {
+			OutMsg(STR_INV_PROC_LIST);
+			return FALSE;
+		}
+		for (first = 0; isdigit((unsigned char)*text) && first <= PROC_MAX_NUM; text++)
+			first = first * 10 + (*text - '0');
+
+		last = first;
+		if (*text == '-') {
+			text++;
+			if (!isdigit((unsigned char)*text)) {
+				OutMsg(STR_INV_PROC_LIST);
+				return FALSE;
+			}
+			for (last = 0; isdigit((unsigned char)*text) && last <= PROC_MAX_NUM; text++)
+				last = last * 10 + (*text - '0');
+		}
+
+		if (first < 1 || last > PROC_MAX_NUM) {
+			OutMsg(STR_INV_PROC_NUM);
+			return FALSE;
+		}
+		if (first > last) {
+			OutMsg(STR_INV_PROC_LIST);
+			return FALSE;
+		}
+
+		for (num = first; num <= last; num++) {
+			if (!PICKED(opts->picks, num)) {
+				opts->picks[num >> 3] |= 1 << (num & 7);
+				opts->pickCount++;
+			}
+		}
+		if (first < opts->start)
+			opts->start = first;
+		if (last > opts->finish)
+			opts->finish = last;
+
+		if (*text == '\0')
+			return TRUE;
+		if (*text++ != ',') {
+			OutMsg(STR_INV_PROC_LIST);
+			return FALSE;
+		}
+	}
+}
+
+
+//--------------------------------------------------------------------------------
+//	Parses the BREAK signals: C, D, E and F in any combination, like the BREAK
+//	command's switches, or ALL for all four. Returns 0 if they're invalid.
+//--------------------------------------------------------------------------------
+ULONG ParseBreakSignals(const char* text)
+{
+	const char* key;
+	ULONG	sigs = 0;
+
+	if (stricmp(text, STR_BREAK_ALL) == 0)
+		return SIGBREAKF_CTRL_C | SIGBREAKF_CTRL_D | SIGBREAKF_CTRL_E | SIGBREAKF_CTRL_F;
+
+	for (; *text != '\0'; text++) {
+		key = strchr(STR_BREAK_KEYS, toupper((unsigned char)*text));
+		if (key == NULL)
+			return 0;
+		sigs |= SIGBREAKF_CTRL_C << (key - STR_BREAK_KEYS);
+	}
+
+	return sigs;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Parses the ALERT rules. ReadArgs only allows one /M argument, so they're
+//	given as a single comma-separated list, e.g. "STACKPCT>90,PRI>=5:ERROR".
+//	Returns TRUE if all of them are valid, FALSE otherwise.
+//--------------------------------------------------------------------------------
+BOOL ParseAlertRules(Options* opts, const char* text)
+{
+	const char* next;
+	ULONG	count;
+
+	for (count = 1, next = text; *next != '\0'; next++) {
+		if (*next == ',')
+			count++;
+	}
+
+	opts->alerts = AllocVec(count * sizeof(AlertRule), MEMF_ANY);
+	if (opts->alerts == NULL) {
+		PrintFault(ERROR_NO_FREE_STORE, NULL);
+		return FALSE;
+	}
+
+	for (opts->alertCount = 0; opts->alertCount < count; opts->alertCount++)
+	{
+		next = ParseAlertRule(&opts->alerts[opts->alertCount], text);
+		if (next == NULL || (*next != ',' && *next != '\0')) {
+			OutMsg(STR_INV_ALERT);
+			return FALSE;
+		}
+		text = next + 1;	// Past the comma
+	}
+
+	return TRUE;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Parses a single ALERT rule: a field, a comparison, a number and optionally
+//	the level it raises. = is the same as >=, so rules can be typed without
+//	quoting > and < in the Shell. STACKPCT is kept in tenths of a percent, like
+//	StackPercent(). Returns a pointer past the rule, or NULL if it's invalid.
+//--------------------------------------------------------------------------------
+const char* ParseAlertRule(AlertRule* rule, const char* text)
+{
+	char	word[10];
+	BOOL	orEqual = TRUE;
+	BOOL	negative = FALSE;
+	LONG	value;
+	LONG	band;
+
+	text = ParseWord(word, sizeof(word), text);
+	if (stricmp(word, STR_SORT_STACK) == 0)
+		rule->field = ALERT_STACK;
+	else if (stricmp(word, STR_SORT_STACKPCT) == 0)
+		rule->field = ALERT_STACKPCT;
+	else if (stricmp(word, STR_SORT_PRI) == 0)
+		rule->field = ALERT_PRI;
+	else if (stricmp(word, STR_SORT_MEM) == 0)
+		rule->field = ALERT_MEM;
+	else
+		return NULL;
+
+	// Comparison
+	rule->above = *text != '<';
+	if (*text == '>' || *text == '<') {
+		text++;
+		orEqual = *text == '=';
+	}
+	else if (*text != '=')
+		return NULL;
+	if (*text == '=')
+		text++;
+
+	// Threshold
+	if (*text == '-') {
+		negative = TRUE;
+		text++;
+	}
+	if (!isdigit((unsigned char)*text))
+		return NULL;
+	for (value = 0; isdigit((unsigned char)*text); text++) {
+		value = value * 10 + (*text - '0');
+		if (value >= ALERT_MAX_VALUE)
+			return NULL;
+	}
+	if (negative)
+		value = -value;
+	if (rule->field == ALERT_STACKPCT)
+		value *= 10;
+
+	rule->raise = orEqual ? value : rule->above ? value + 1 : value - 1;
+	band = (rule->raise < 0 ? -rule->raise : rule->raise) / ALERT_HYST_DIV;
+	if (band < 1)							// Thresholds under 10 still get a band
+		band = 1;
+	rule->clear = rule->above ? rule->raise - band : rule->raise + band;
+
+	// Level
+	rule->level = RETURN_WARN;
+	if (*text == ':') {
+		text = ParseWord(word, sizeof(word), text + 1);
+		if (stricmp(word, STR_ALERT_WARN) == 0)
+			rule->level = RETURN_WARN;
+		else if (stricmp(word, STR_ALERT_ERROR) == 0)
+			rule->level = RETURN_ERROR;
+		else if (stricmp(word, STR_ALERT_FAIL) == 0)
+			rule->level = RETURN_FAIL;
+		else
+			return NULL;
+	}
+
+	return text;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Copies the letters, digits & underscores at the start of text into word,
+//	truncated to fit so a longer word won't match anything. Returns a pointer
+//	past them.
+//--------------------------------------------------------------------------------
+const char* ParseWord(char* word, ULONG size, const char* text)
+{
+	ULONG	len = 0;
+
+	for (; isalnum((unsigned char)*text) || *text == '_'; text++) {
+		if (len < size - 1)
+			word[len++] = *text;
+	}
+	word[len] = '\0';
+
+	return text;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Builds the COLS column plans from a comma-separated list of column names,
+//	which are the CSV/JSON field names. Each table gets the columns it has, in
+//	the order they were named. Returns TRUE if all the names are valid.
+//--------------------------------------------------------------------------------
+BOOL PlanColumns(Options* opts, const char* text)
+{
+	Field	fields[PLAN_MAX_COLS];
+	char	word[16];
+	const char* next;
+	Column* plan;
+	ULONG	count = 0;
+	ULONG	field;
+	ULONG	i;
+
+	do {
+		next = ParseWord(word, sizeof(word), text);
+		for (field = FIELD_NUM; field <= FIELD_LAST; field++) {
+			if (stricmp(word, FieldKey((Field)field)) == 0)
+				break;
+		}
+		if (field > FIELD_LAST || count == PLAN_MAX_COLS || (*next != ',' && *next != '\0') ||
+			!ShownTablesHave(opts, (Field)field)) {
+			OutMsg(STR_INV_COLS);
+			return FALSE;
+		}
+		fields[count++] = (Field)field;
+		text = next + 1;	// Past the comma
+
+		// The peak & recommended stack need the stack scan, which HIGHWATER
+		// would turn on. CPU% still needs a SAMPLE window.
+		if (field == FIELD_STACK_PEAK || field == FIELD_STACK_REC)
+			opts->show |= NEED_HIGHWATER;
+		else if (field == FIELD_MEM)
+			opts->show |= NEED_MEM;
+		else if (field == FIELD_QUEUE || field == FIELD_WAIT_PORT || field == FIELD_WAIT_MSGS)
+			opts->show |= NEED_QUEUE;
+	} while (*next == ',');
+
+	// One plan per table, each ending with FIELD_END
+	opts->plans = AllocVec((2 + LIST_COUNT) * (count + 1) * sizeof(Column), MEMF_ANY);
+	if (opts->plans == NULL) {
+		PrintFault(ERROR_NO_FREE_STORE, NULL);
+		return FALSE;
+	}
+
+	plan = opts->plans;
+	opts->sysCols = plan;
+	plan = PlanTable(plan, sysColumns, fields, count);
+	opts->cliCols = plan;
+	plan = PlanTable(plan, cliColumns, fields, count);
+	for (i = 0; i < LIST_COUNT; i++) {
+		opts->listCols[i] = plan;
+		plan = PlanTable(plan, listTables[i].columns, fields, count);
+	}
+
+	return TRUE;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Copies the columns of a table that are named in fields into plan, in the
+//	order they were named, followed by FIELD_END. NAME also picks the command
+//	name column of the Shell/CLI table. Returns the end of the plan.
+//--------------------------------------------------------------------------------
+Column* PlanTable(Column* plan, const Column* columns, const Field* fields, ULONG count)
+{
+	const Column* col;
+	ULONG	i;
+
+	for (i = 0; i < count; i++)
+	{
+		if ((col = FindColumn(columns, fields[i])) != NULL) {
+			*plan = *col;
+			plan->formats = IN_ALL;		// Shown whichever format was given
+			plan++;
+		}
+	}
+
+	memset(plan, 0, sizeof(*plan));
+	plan->field = FIELD_END;
+
+	return plan + 1;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Returns TRUE if any of the tables the options show has a column for field,
+//	so a COLS name that would show nothing anywhere can be turned down.
+//--------------------------------------------------------------------------------
+BOOL ShownTablesHave(const Options* opts, Field field)
+{
+	ULONG	i;
+
+	if ((opts->mode == MODE_ALL || opts->mode == MODE_SYSTEM) && FindColumn(sysColumns, field))
+		return TRUE;
+	if ((opts->mode == MODE_ALL || opts->mode == MODE_CLI) && FindColumn(cliColumns, field))
+		return TRUE;
+	for (i = 0; i < LIST_COUNT; i++) {
+		if ((opts->lists & (1 << i)) && FindColumn(listTables[i].columns, field))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Returns the column of the table that shows field, or NULL if it has none.
+//	NAME also finds the command name column of the Shell/CLI table.
+//--------------------------------------------------------------------------------
+const Column* FindColumn(const Column* columns, Field field)
+{
+	const Column* col;
+
+	for (col = columns; col->field != FIELD_END; col++) {
+		if (col->field == field || (field == FIELD_NAME && col->field == FIELD_COMMAND))
+			return col;
+	}
+
+	return NULL;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Returns the FIELD_BIT()s of the fields that no column of any table shows, so
+//	the walk doesn't have to copy them. The name is also needed to sort by it.
+//--------------------------------------------------------------------------------
+ULONG UnshownFields(Options* opts)
+{
+	const Column* plans[2 + LIST_COUNT];
+	const Column* col;
+	ULONG	fields = 0;
+	ULONG	i;
+
+	plans[0] = opts->sysCols;
+	plans[1] = opts->cliCols;
+	for (i = 0; i < LIST_COUNT; i++)
+		plans[2 + i] = opts->listCols[i];
+
+	for (i = 0; i < 2 + LIST_COUNT; i++) {
+		for (col = plans[i]; col->field != FIELD_END; col++) {
+			if (ShowColumn(col, opts->show))
+				fields |= FIELD_BIT(col->field);
+		}
+	}
+
+	// The command name is kept in the name field
+	if ((fields & FIELD_BIT(FIELD_COMMAND)) || opts->sort == SORT_NAME)
+		fields |= FIELD_BIT(FIELD_NAME);
+
+	return ~fields;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Widens the number columns of the system & Shell/CLI tables to fit the
+//	snapshot, once its row or CLI numbers have more digits than the columns are
+//	laid out for. The columns are copied the first time one has to grow, and
+//	only ever grow, so WATCH doesn't keep redrawing. If there's no memory for
+//	the copy, the numbers just push the rest of their rows out. Returns TRUE if
+//	any column was widened.
+//--------------------------------------------------------------------------------
+BOOL WidenNumColumns(Options* opts, const Snapshot* snap)
+{
+	const Column* col;
+	UBYTE	sysWidth = NumWidth(snap->sysCount);
+	UBYTE	cliWidth = 1;
+	ULONG	sysLen;
+	ULONG	cliLen;
+	ULONG	i;
+
+	for (i = 0; i < snap->sysCount + snap->cliCount; i++) {
+		if (NumWidth(snap->recs[i].cliNum) > cliWidth)
+			cliWidth = NumWidth(snap->recs[i].cliNum);
+	}
+
+	// Nothing to do unless a column is too narrow
+	if (!NarrowColumn(opts->sysCols, FIELD_NUM, sysWidth) &&
+		!NarrowColumn(opts->sysCols, FIELD_CLI, cliWidth) &&
+		!NarrowColumn(opts->cliCols, FIELD_NUM, cliWidth))
+		return FALSE;
+
+	if (opts->wideCols == NULL) {
+		for (col = opts->sysCols; col->field != FIELD_END; col++)
+			;
+		sysLen = col - opts->sysCols + 1;
+		for (col = opts->cliCols; col->field != FIELD_END; col++)
+			;
+		cliLen = col - opts->cliCols + 1;
+
+		opts->wideCols = AllocVec((sysLen + cliLen) * sizeof(Column), MEMF_ANY);
+		if (opts->wideCols == NULL)
+			return FALSE;
+
+		memcpy(opts->wideCols, opts->sysCols, sysLen * sizeof(Column));
+		memcpy(opts->wideCols + sysLen, opts->cliCols, cliLen * sizeof(Column));
+		opts->sysCols = opts->wideCols;
+		opts->cliCols = opts->wideCols + sysLen;
+	}
+
+	WidenColumn((Column*)opts->sysCols, FIELD_NUM, sysWidth);
+	WidenColumn((Column*)opts->sysCols, FIELD_CLI, cliWidth);
+	WidenColumn((Column*)opts->cliCols, FIELD_NUM, cliWidth);
+
+	return TRUE;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Returns TRUE if the column showing field is narrower than width characters.
+//--------------------------------------------------------------------------------
+BOOL NarrowColumn(const Column* columns, Field field, UBYTE width)
+{
+	const Column* col;
+
+	for (col = columns; col->field != FIELD_END; col++) {
+		if (col->field == field && col->width < width)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Widens the column showing field to at least width characters.
+//--------------------------------------------------------------------------------
+void WidenColumn(Column* columns, Field field, UBYTE width)
+{
+	Column* col;
+
+	for (col = columns; col->field != FIELD_END; col++) {
+		if (col->field == field && col->width < width)
+			col->width = width;
+	}
+}
+
+
+//--------------------------------------------------------------------------------
+//	Returns the number of digits needed to show num.
+//--------------------------------------------------------------------------------
+UBYTE NumWidth(long num)
+{
+	UBYTE	width = 1;
+
+	for (; num >= 10; num /= 10)
+		width++;
+
+	return width;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Snapshot API, called as SP_TakeSnapshot() of showproc.library: takes a
+//	snapshot of the tables selected by the SP_* flags into buffer, for programs
+//	that want the numbers without running ShowProc & parsing its output.
+//	Whatever doesn't fit in size bytes is left out. Returns the number of bytes
+//	the whole snapshot needs, so a caller can try again with a bigger buffer,
+//	or -1 if out of memory.
+//--------------------------------------------------------------------------------
+LONG TakeBinSnapshot(APTR buffer, ULONG size, ULONG flags)
+{
+	Snapshot snap = {0};
+	Mode	mode;
+	ULONG	needed = 0;
+	ULONG	i;
+
+	for (i = 0; i < LIST_COUNT; i++) {
+		if (flags & (SP_LIBS << i))
+			snap.lists |= 1 << i;
+	}
+
+	if ((flags & SP_SYSTEM) && (flags & SP_CLI))
+		mode = MODE_ALL;
+	else if (flags & SP_SYSTEM)
+		mode = MODE_SYSTEM;
+	else if (flags & SP_CLI)
+		mode = MODE_CLI;
+	else if (snap.lists)
+		mode = MODE_LISTS;
+	else
+		return 0;
+
+	snap.show = (flags & SP_HIGHWATER) ? NEED_HIGHWATER : 0;
+	if (flags & SP_MEM)
+		snap.show |= NEED_MEM;
+	if (flags & SP_QUEUE)
+		snap.show |= NEED_QUEUE;
+	snap.queueMax = SNAP_MAX_MSGS;
+	if (TakeSnapshot(&snap, mode, 1, CLI_LAST_NUM) != RETURN_OK)
+		return -1;
+
+	needed = PutBinTables(buffer, size, 0, &snap, mode);
+
+	FreeSnapshot(&snap);
+
+	return (LONG)needed;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Snapshot API, called as SP_FindCli() of showproc.library: looks for a
+//	Shell/CLI process running a command that matches any of the NULL-terminated
+//	names or patterns, as COMMAND does. Returns its Shell/CLI number, 0 if none
+//	matches, or -1 if a pattern is invalid or we're out of memory.
+//--------------------------------------------------------------------------------
+LONG FindCommandCli(const char** patterns)
+{
+	Snapshot snap = {0};
+	CmdPattern* pats;
+	TaskRec* rec;
+	ULONG	count;
+	ULONG	i;
+	LONG	found = 0;
+
+	for (count = 0; patterns != NULL && patterns[count] != NULL; count++)
+		;
+	if (count == 0)
+		return -1;
+
+	if ((pats = AllocVec(count * sizeof(CmdPattern), MEMF_ANY)) == NULL)
+		return -1;
+
+	for (i = 0; i < count; i++)
+		if (CompileCommandPattern(&pats[i], patterns[i]) != NULL) {
+			found = -1;
+			goto cleanup;
+		}
+
+	if (TakeSnapshot(&snap, MODE_CLI, 1, CLI_LAST_NUM) != RETURN_OK) {
+		found = -1;
+		goto cleanup;
+	}
+
+	for (i = 0; i < snap.cliCount; i++)
+	{
+		rec = &snap.recs[snap.sysCount + i];
+		if (!(rec->flags & (REC_MISSING | REC_NO_CLI | REC_NO_COMMAND)) &&
+			CheckCommandMatch(rec->name, pats, count)) {
+			found = rec->cliNum;
+			break;	// Exit the for loop
+		}
+	}
+
+cleanup:
+	FreeSnapshot(&snap);
+	FreeVec(pats);
+
+	return found;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Puts a BinTable & count records at offset in buffer, leaving out whatever
+//	doesn't fit in size bytes. System rows are numbered from 1 & Shell/CLI rows
+//	by their Shell/CLI number, as in the BIN output.
+//	Returns the number of bytes the table needs.
+//--------------------------------------------------------------------------------
+ULONG PutBinTable(UBYTE* buffer, ULONG size, ULONG offset, ULONG tag, const TaskRec* recs, ULONG count)
+{
+	BinTable table;
+	ULONG	i;
+
+	table.tag = tag;
+	table.count = count;
+	if (offset + sizeof(table) <= size)
+		memcpy(buffer + offset, &table, sizeof(table));
+	offset += sizeof(table);
+
+	for (i = 0; i < count; i++) {
+		if (offset + sizeof(BinRec) <= size)
+			FillBinRec((BinRec*)(buffer + offset), &recs[i],
+					   tag == BIN_TAG_CLI ? recs[i].cliNum : (long)i + 1);
+		offset += sizeof(BinRec);
+	}
+
+	return sizeof(table) + count * sizeof(BinRec);
+}
+
+
+//--------------------------------------------------------------------------------
+//	Puts the tables of the snapshot selected by mode & snap->lists at offset in
+//	buffer, as PutBinTable() does: the Shell/CLI table first, then the system
+//	one & the exec lists. Returns the number of bytes they need.
+//--------------------------------------------------------------------------------
+ULONG PutBinTables(UBYTE* buffer, ULONG size, ULONG offset, const Snapshot* snap, Mode mode)
+{
+	ULONG	needed = 0;
+	ULONG	i;
+
+	if (mode == MODE_ALL || mode == MODE_CLI)
+		needed += PutBinTable(buffer, size, offset + needed, BIN_TAG_CLI,
+							  &snap->recs[snap->sysCount], snap->cliCount);
+	if (mode == MODE_ALL || mode == MODE_SYSTEM)
+		needed += PutBinTable(buffer, size, offset + needed, BIN_TAG_SYS,
+							  snap->recs, snap->sysCount);
+	for (i = 0; i < LIST_COUNT; i++) {
+		if (snap->lists & (1 << i))
+			needed += PutBinTable(buffer, size, offset + needed, listTables[i].tag,
+								  &snap->recs[snap->listFirst[i]], snap->listCount[i]);
+	}
+
+	return needed;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Writes the snapshot to the SAVE file in the BIN layout, header & all, with a
+//	single Write(). Nothing is formatted, so LOAD or DIFF can do that later,
+//	even on another machine.
+//--------------------------------------------------------------------------------
+int SaveSnapshot(Options* opts, Snapshot* snap)
+{
+	BinHeader* header;
+	UBYTE*	buffer;
+	ULONG	size;
+	int		rc;
+
+	size = sizeof(BinHeader) + PutBinTables(NULL, 0, 0, snap, opts->mode);
+	if ((buffer = AllocVec(size, MEMF_ANY)) == NULL) {
+		PrintFault(ERROR_NO_FREE_STORE, NULL);
+		return RETURN_FAIL;
+	}
+
+	header = (BinHeader*)buffer;
+	header->magic = BIN_MAGIC;
+	header->version = BIN_VERSION;
+	header->recSize = sizeof(BinRec);
+	header->show = opts->show;
+	PutBinTables(buffer, size, sizeof(BinHeader), snap, opts->mode);
+
+	rc = WriteSaveFile(opts, buffer, size);
+
+	FreeVec(buffer);
+
+	return rc;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Returns the SP_* flags that have showproc.library take the snapshot the
+//	options ask for, or 0 if they need more than the library does, like
+//	choosing, sorting or sampling the tasks. Only a FORMAT=BIN or SAVE
+//	snapshot is written out as the library hands it over.
+//--------------------------------------------------------------------------------
+ULONG LibrarySnapshotFlags(const Options* opts)
+{
+	ULONG	flags = 0;
+	ULONG	i;
+
+	if (opts->encoding != ENCODE_BIN && opts->saveFile == NULL)
+		return 0;
+
+	if (opts->loaded || opts->timing || opts->sample || opts->picks || opts->patCount ||
+		opts->breakSigs || opts->setPri || opts->alertCount || opts->sort != SORT_NONE ||
+		opts->top)
+		return 0;
+
+	// The library counts every message, as QUEUE does without a number
+	if ((opts->show & NEED_QUEUE) && opts->queueMax != SNAP_MAX_MSGS)
+		return 0;
+
+	if (opts->mode == MODE_ALL || opts->mode == MODE_SYSTEM)
+		flags |= SP_SYSTEM;
+	if (opts->mode == MODE_ALL || opts->mode == MODE_CLI)
+		flags |= SP_CLI;
+	for (i = 0; i < LIST_COUNT; i++) {
+		if (opts->lists & (1 << i))
+			flags |= SP_LIBS << i;
+	}
+	if (opts->show & NEED_HIGHWATER)
+		flags |= SP_HIGHWATER;
+	if (opts->show & NEED_MEM)
+		flags |= SP_MEM;
+	if (opts->show & NEED_QUEUE)
+		flags |= SP_QUEUE;
+
+	return flags;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Takes the snapshot through SP_TakeSnapshot() of showproc.library & writes
+//	it as the BIN output or the SAVE file, behind the header ShowProc would
+//	have written itself.
+//--------------------------------------------------------------------------------
+int WriteLibrarySnapshot(Options* opts, ULONG flags)
+{
+	BinHeader* header;
+	UBYTE*	buffer = NULL;
+	ULONG	size = sizeof(BinHeader) + SNAP_INITIAL_RECS * sizeof(BinRec);
+	LONG	needed;
+	BYTE	prev_program_pri;			// Program priority before we change it
+	int		rc = RETURN_OK;
+
+	// Same priority as the snapshots ShowProc takes itself
+	prev_program_pri = SetTaskPri(FindTask(NULL), PROGRAM_PRIORITY);
+
+	// The system can grow between one try & the next, so there's some slack
+	for (;;)
+	{
+		if ((buffer = AllocVec(size, MEMF_ANY)) == NULL) {
+			needed = -1;
+			break;
+		}
+		needed = SP_TakeSnapshot(buffer + sizeof(BinHeader), size - sizeof(BinHeader), flags);
+		if (needed < 0 || sizeof(BinHeader) + needed <= size)
+			break;
+		FreeVec(buffer);
+		size = sizeof(BinHeader) + needed + SNAP_SLACK_RECS * sizeof(BinRec);
+	}
+
+	SetTaskPri(FindTask(NULL), prev_program_pri);
+
+	if (needed < 0) {
+		PrintFault(ERROR_NO_FREE_STORE, NULL);
+		FreeVec(buffer);
+		return RETURN_FAIL;
+	}
+
+	size = sizeof(BinHeader) + needed;
+	header = (BinHeader*)buffer;
+	header->magic = BIN_MAGIC;
+	header->version = BIN_VERSION;
+	header->recSize = sizeof(BinRec);
+	header->show = opts->show;
+
+	if (opts->saveFile)
+		rc = WriteSaveFile(opts, buffer, size);
+	else
+		OutBytes(buffer, size);
+
+	FreeVec(buffer);
+
+	return rc;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Writes size bytes of buffer to the SAVE file with a single Write().
+//--------------------------------------------------------------------------------
+int WriteSaveFile(Options* opts, const UBYTE* buffer, ULONG size)
+{
+	BPTR	file;
+	int		rc = RETURN_OK;
+
+	if ((file = Open(opts->saveFile, MODE_NEWFILE)) == NULL) {
+		PrintFault(IoErr(), opts->saveFile);
+		return RETURN_FAIL;
+	}
+
+	if (Write(file, (APTR)buffer, size) != (LONG)size) {
+		PrintFault(IoErr(), opts->saveFile);
+		rc = RETURN_FAIL;
+	}
+	Close(file);
+
+	return rc;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Reads the LOAD or DIFF file into opts->loaded with a single Read() & checks
+//	it was written by SAVE. The tables shown are the ones in the file, and LOAD
+//	shows the optional fields that were taken. Returns FALSE if it can't be
+//	used.
+//--------------------------------------------------------------------------------
+BOOL ReadSnapshotFile(Options* opts, const char* name)
+{
+	const BinHeader* header;
+	const BinTable* table;
+	BPTR	file;
+	LONG	size;
+	ULONG	offset;
+	ULONG	i;
+	BOOL	sys = FALSE;
+	BOOL	cli = FALSE;
+
+	if ((file = Open(name, MODE_OLDFILE)) == NULL) {
+		PrintFault(IoErr(), name);
+		return FALSE;
+	}
+
+	Seek(file, 0, OFFSET_END);
+	size = Seek(file, 0, OFFSET_BEGINNING);
+	if (size > 0 && (opts->loaded = AllocVec(size, MEMF_ANY)) != NULL) {
+		opts->loadedSize = size;
+		if (Read(file, opts->loaded, size) != size)
+			size = -1;
+	}
+	Close(file);
+
+	if (size < 0) {
+		PrintFault(IoErr(), name);
+		return FALSE;
+	}
+	if (size > 0 && opts->loaded == NULL) {
+		PrintFault(ERROR_NO_FREE_STORE, NULL);
+		return FALSE;
+	}
+
+	// Every table has to be one we know & fit in the file
+	header = (const BinHeader*)opts->loaded;
+	if (opts->loadedSize < sizeof(BinHeader) || header->magic != BIN_MAGIC ||
+		header->version != BIN_VERSION || header->recSize != sizeof(BinRec))
+		goto invalid;
+
+	opts->lists = 0;
+	for (offset = sizeof(BinHeader); offset < opts->loadedSize;
+		 offset += sizeof(BinTable) + table->count * sizeof(BinRec))
+	{
+		table = (const BinTable*)(opts->loaded + offset);
+		if (offset + sizeof(BinTable) > opts->loadedSize ||
+			table->count > (opts->loadedSize - offset - sizeof(BinTable)) / sizeof(BinRec))
+			goto invalid;
+
+		if (table->tag == BIN_TAG_SYS)
+			sys = TRUE;
+		else if (table->tag == BIN_TAG_CLI)
+			cli = TRUE;
+		else {
+			for (i = 0; i < LIST_COUNT && table->tag != listTables[i].tag; i++)
+				;
+			if (i == LIST_COUNT)
+				goto invalid;
+			opts->lists |= 1 << i;
+		}
+	}
+
+	opts->mode = sys && cli ? MODE_ALL : sys ? MODE_SYSTEM : cli ? MODE_CLI : MODE_LISTS;
+
+	// DIFF only compares the tasks
+	if (opts->diff)
+		opts->lists = 0;
+	else
+		opts->show |= header->show & (NEED_SAMPLE | NEED_HIGHWATER | NEED_MEM | NEED_QUEUE);
+
+	return TRUE;
+
+invalid:
+	OutStr(name);
+	OutChar(' ');
+	OutMsg(STR_INV_SNAP_FILE);
+	return FALSE;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Returns the table of the file read by ReadSnapshotFile() with the given tag,
+//	or NULL if it doesn't have one.
+//--------------------------------------------------------------------------------
+const BinTable* FindBinTable(const UBYTE* buffer, ULONG size, ULONG tag)
+{
+	const BinTable* table;
+	ULONG	offset;
+
+	for (offset = sizeof(BinHeader); offset < size;
+		 offset += sizeof(BinTable) + table->count * sizeof(BinRec))
+	{
+		table = (const BinTable*)(buffer + offset);
+		if (table->tag == tag)
+			return table;
+	}
+
+	return NULL;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Fills the snapshot from a file read by ReadSnapshotFile(), as if its tables
+//	had just been walked, so TOP & SORT work the same. Returns RETURN_FAIL if
+//	out of memory.
+//--------------------------------------------------------------------------------
+int LoadSnapshot(Snapshot* snap, const UBYTE* buffer, ULONG size)
+{
+	const BinTable* table;
+	ULONG	offset;
+	ULONG	i;
+
+	// Room for every record, plus TOP's scratch record
+	snap->needed = 0;
+	for (offset = sizeof(BinHeader); offset < size;
+		 offset += sizeof(BinTable) + table->count * sizeof(BinRec)) {
+		table = (const BinTable*)(buffer + offset);
+		snap->needed += table->count;
+	}
+
+	FreeSnapshot(snap);
+	snap->capacity = snap->needed + 1;
+	snap->recs = AllocVec(snap->capacity * sizeof(TaskRec), MEMF_ANY);
+	if (snap->recs == NULL) {
+		snap->capacity = 0;
+		return RETURN_FAIL;
+	}
+
+	snap->walked = 0;
+	snap->base = 0;
+	snap->kept = 0;
+	LoadBinTable(snap, FindBinTable(buffer, size, BIN_TAG_SYS));
+	snap->sysCount = snap->kept;
+
+	snap->base = snap->sysCount;
+	snap->kept = 0;
+	LoadBinTable(snap, FindBinTable(buffer, size, BIN_TAG_CLI));
+	snap->cliCount = snap->kept;
+
+	snap->lists = 0;
+	for (i = 0; i < LIST_COUNT; i++)
+	{
+		snap->base += snap->kept;
+		snap->kept = 0;
+
+		if ((table = FindBinTable(buffer, size, listTables[i].tag)) != NULL) {
+			snap->lists |= 1 << i;
+			LoadBinTable(snap, table);
+		}
+
+		snap->listFirst[i] = snap->base;
+		snap->listCount[i] = snap->kept;
+	}
+
+	SortSnapshot(snap);
+
+	return RETURN_OK;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Adds the records of a table of the SAVE file to the table being filled.
+//--------------------------------------------------------------------------------
+void LoadBinTable(Snapshot* snap, const BinTable* table)
+{
+	const BinRec* bin;
+	TaskRec* rec;
+	ULONG	i;
+
+	if (table == NULL)
+		return;
+
+	bin = (const BinRec*)(table + 1);
+	for (i = 0; i < table->count; i++) {
+		if ((rec = NewTaskRec(snap)) == NULL)
+			continue;	// Can't happen, the arena fits every record
+		FillTaskRec(rec, &bin[i]);
+		KeepTaskRec(snap, rec);
+	}
+}
+
+
+//--------------------------------------------------------------------------------
+//	Converts a record from the BIN layout, the reverse of FillBinRec().
+//--------------------------------------------------------------------------------
+void FillTaskRec(TaskRec* rec, const BinRec* bin)
+{
+	rec->task = (struct Task*)bin->task;
+	rec->cliNum = bin->cliNum;
+	rec->stackUsed = bin->stackUsed;
+	rec->stackSize = bin->stackSize;
+	rec->stackPeak = bin->stackPeak;
+	rec->defaultStack = bin->defaultStack;
+	rec->globVec = bin->globVec;
+	rec->failLevel = bin->failLevel;
+	rec->returnCode = bin->returnCode;
+	rec->mem = bin->mem;
+	rec->cpu = bin->cpu;
+	rec->pri = bin->pri;
+	rec->type = bin->type;
+	rec->state = bin->state;
+	rec->flags = bin->flags & ~(REC_FREE | REC_SEEN);
+	rec->version = bin->version;
+	rec->revision = bin->revision;
+	rec->openCount = bin->openCount;
+	rec->msgCount = bin->msgCount;
+	rec->action = bin->action;
+	rec->queueCount = bin->queueCount;
+	rec->waitCount = bin->waitCount;
+	strcpyn(rec->name, bin->name, sizeof(rec->name));
+	strcpyn(rec->sigTask, bin->sigTask, sizeof(rec->sigTask));
+	strcpyn(rec->waitPort, bin->waitPort, sizeof(rec->waitPort));
+}
+
+
+//--------------------------------------------------------------------------------
+//	Compares the tasks just taken with the DIFF file, & prints the ones that
+//	have been added or removed since it was saved, & those whose priority,
+//	state or stack use has changed. Returns RETURN_WARN if anything differs.
+//--------------------------------------------------------------------------------
+int PrintDiff(Options* opts, Snapshot* snap)
+{
+	Snapshot was = {0};
+	ULONG	counts[3] = { 0, 0, 0 };		// Added, removed & changed
+
+	was.sort = SORT_NONE;
+	if (LoadSnapshot(&was, opts->loaded, opts->loadedSize) != RETURN_OK) {
+		PrintFault(ERROR_NO_FREE_STORE, NULL);
+		return RETURN_FAIL;
+	}
+
+	if (opts->mode == MODE_ALL || opts->mode == MODE_CLI) {
+		if (opts->tables > 1 && !opts->noHead)
+			OutMsg(STR_CLI_HEADING);
+		DiffTable(&was.recs[was.sysCount], was.cliCount,
+				  &snap->recs[snap->sysCount], snap->cliCount, TRUE, counts);
+	}
+
+	if (opts->mode == MODE_ALL || opts->mode == MODE_SYSTEM) {
+		if (opts->tables > 1 && !opts->noHead) {
+			OutNewline();
+			OutMsg(STR_SYS_HEADING);
+		}
+		DiffTable(was.recs, was.sysCount, snap->recs, snap->sysCount, FALSE, counts);
+	}
+
+	if (!opts->noHead) {
+		OutStr(STR_DIFF_SUMMARY " ");
+		OutNum(counts[0], 1, ALIGN_LEFT);
+		OutStr(" " STR_DIFF_ADDED ", ");
+		OutNum(counts[1], 1, ALIGN_LEFT);
+		OutStr(" " STR_DIFF_REMOVED ", ");
+		OutNum(counts[2], 1, ALIGN_LEFT);
+		OutStr(" " STR_DIFF_CHANGED);
+		OutNewline();
+	}
+
+	FreeSnapshot(&was);
+
+	return counts[0] || counts[1] || counts[2] ? RETURN_WARN : RETURN_OK;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Prints the differences between a table of the DIFF file & the same table
+//	just taken, adding them up in counts: the tasks that have changed, then
+//	those that have gone & those that are new. Tasks are paired by address,
+//	Shell/CLI number & name first, then by number & name alone, which pairs
+//	them up when the file came from another boot or machine too.
+//--------------------------------------------------------------------------------
+void DiffTable(TaskRec* was, ULONG wasCount, TaskRec* now, ULONG nowCount, BOOL cli, ULONG* counts)
+{
+	TaskRec* old;
+	ULONG	pass;
+	ULONG	i, j, k;
+
+	for (i = 0; i < wasCount; i++)
+		was[i].flags &= ~REC_SEEN;
+	for (j = 0; j < nowCount; j++)
+		now[j].flags &= ~REC_SEEN;
+
+	// Tasks tend to stay in roughly the same order, so each one is looked for
+	// from where the last one was found
+	for (pass = 0; pass < 2; pass++)
+	{
+		for (i = 0, j = 0; i < wasCount; i++)
+		{
+			old = &was[i];
+			if (old->flags & REC_SEEN)
+				continue;	// Go to next task
+
+			for (k = 0; k < nowCount; k++) {
+				if (!(now[j].flags & REC_SEEN) && (pass || now[j].task == old->task) &&
+					now[j].cliNum == old->cliNum && strcmp(now[j].name, old->name) == 0)
+					break;	// Exit the for loop
+				if (++j == nowCount)
+					j = 0;
+			}
+			if (k == nowCount)
+				continue;	// Go to next task
+
+			old->flags |= REC_SEEN;
+			now[j].flags |= REC_SEEN;
+			if (DiffTaskRecs(old, &now[j], cli))
+				counts[2]++;
+		}
+	}
+
+	for (i = 0; i < wasCount; i++) {
+		if (!(was[i].flags & REC_SEEN)) {
+			PrintDiffLine('-', &was[i], cli);
+			OutNewline();
+			counts[1]++;
+		}
+	}
+
+	for (j = 0; j < nowCount; j++) {
+		if (!(now[j].flags & REC_SEEN)) {
+			PrintDiffLine('+', &now[j], cli);
+			OutNewline();
+			counts[0]++;
+		}
+		now[j].flags &= ~REC_SEEN;
+	}
+}
+
+
+//--------------------------------------------------------------------------------
+//	Prints what has changed between two records of the same task, if anything.
+//	Returns TRUE if something has.
+//--------------------------------------------------------------------------------
+BOOL DiffTaskRecs(const TaskRec* old, const TaskRec* rec, BOOL cli)
+{
+	if (rec->pri == old->pri && rec->state == old->state &&
+		rec->stackUsed == old->stackUsed && rec->stackSize == old->stackSize)
+		return FALSE;
+
+	PrintDiffLine('*', old, cli);
+	OutChar(':');
+	if (rec->pri != old->pri) {
+		OutStr(" " STR_DIFF_PRI " ");
+		OutNum(old->pri, 1, ALIGN_LEFT);
+		OutStr(" " STR_DIFF_TO " ");
+		OutNum(rec->pri, 1, ALIGN_LEFT);
+	}
+	if (rec->state != old->state) {
+		OutStr(" " STR_DIFF_STATE " ");
+		OutStr(GetStateName(old->state));
+		OutStr(" " STR_DIFF_TO " ");
+		OutStr(GetStateName(rec->state));
+	}
+	if (rec->stackUsed != old->stackUsed) {
+		OutStr(" " STR_DIFF_STACK " ");
+		OutNum(old->stackUsed, 1, ALIGN_LEFT);
+		OutStr(" " STR_DIFF_TO " ");
+		OutNum(rec->stackUsed, 1, ALIGN_LEFT);
+	}
+	if (rec->stackSize != old->stackSize) {
+		OutStr(" " STR_DIFF_STACK_SIZE " ");
+		OutNum(old->stackSize, 1, ALIGN_LEFT);
+		OutStr(" " STR_DIFF_TO " ");
+		OutNum(rec->stackSize, 1, ALIGN_LEFT);
+	}
+	OutNewline();
+
+	return TRUE;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Prints the start of a DIFF line: + for an added task, - for a removed one
+//	or * for a changed one, then its Shell/CLI number & its name.
+//--------------------------------------------------------------------------------
+void PrintDiffLine(char sign, const TaskRec* rec, BOOL cli)
+{
+	OutChar(sign);
+	OutChar(' ');
+	if (cli) {
+		OutNum(rec->cliNum, 3, ALIGN_RIGHT);
+		OutChar(' ');
+	}
+	OutStr(cli && (rec->flags & REC_NO_COMMAND) ? STR_NO_COMMAND : rec->name);
+}
+
+
+//--------------------------------------------------------------------------------
+//	Returns a string representation of the task/process state.
+//--------------------------------------------------------------------------------
+char* GetStateName(UBYTE state)
+{
+	switch (state) {
+		case TS_INVALID:
+			return STR_STATE_INVALID;
+		case TS_ADDED:
+			return STR_STATE_ADDED;
+		case TS_RUN:
+			return STR_STATE_RUN;
+		case TS_READY:
+			return STR_STATE_READY;
+		case TS_WAIT:
+			return STR_STATE_WAIT;
+		case TS_EXCEPT:
+			return STR_STATE_EXCEPT;
+		case TS_REMOVED:
+			return STR_STATE_REMOVED;
+		default:
+			return STR_STATE_UNDEFINED;
+	}
+}
+
+
+//--------------------------------------------------------------------------------
+//	Returns the name of an ALERT level, or "" if none was raised.
+//--------------------------------------------------------------------------------
+const char* GetAlertName(UBYTE level)
+{
+	switch (level) {
+		case RETURN_WARN:
+			return STR_ALERT_WARN;
+		case RETURN_ERROR:
+			return STR_ALERT_ERROR;
+		case RETURN_FAIL:
+			return STR_ALERT_FAIL;
+		default:
+			return "";
+	}
+}
+
+
+//--------------------------------------------------------------------------------
+//	Checks that the Kickstart and AmigaOS versions meet the minimum requirements.
+//	dos.library is always open, so its version stands in for the AmigaOS one.
+//	Returns TRUE if requirements are met, FALSE otherwise.
+//--------------------------------------------------------------------------------
+BOOL CheckRequirements(void)
+{
+	// Check Kickstart version
+	if (SysBase->LibNode.lib_Version < KICKSTART_MIN_VER) {
+		OutMsg(STR_KS_TOO_OLD);
+		return FALSE;
+	}
+
+	// Check AmigaOS version
+	if (((struct Library*)DOSBase)->lib_Version < OS_MIN_VER) {
+		OutMsg(STR_OS_TOO_OLD);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Opens the E-clock unit of timer.device for TIMING. The request is never sent,
+//	so it needs no reply port. Leaves timing.open FALSE if it couldn't be opened
+//	(UNIT_ECLOCK needs Kickstart 2.0).
+//--------------------------------------------------------------------------------
+void OpenTiming(void)
+{
+	timing.timer.tr_node.io_Message.mn_Length = sizeof(struct timerequest);
+	if (OpenDevice(TIMERNAME, UNIT_ECLOCK, (struct IORequest*)&timing.timer, 0) != 0)
+		return;
+
+	timing.open = TRUE;
+	TimerBase = timing.timer.tr_node.io_Device;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Closes the E-clock unit if it's open.
+//--------------------------------------------------------------------------------
+void CloseTiming(void)
+{
+	if (!timing.open)
+		return;
+
+	CloseDevice((struct IORequest*)&timing.timer);
+	timing.open = FALSE;
+	TimerBase = NULL;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Notes when a timed step starts. Does nothing unless the E-clock is open.
+//--------------------------------------------------------------------------------
+void TimingStart(struct EClockVal* start)
+{
+	if (timing.open)
+		ReadEClock(start);
+}
+
+
+//--------------------------------------------------------------------------------
+//	Returns the E-clock ticks since TimingStart(), or 0 if the E-clock isn't open.
+//--------------------------------------------------------------------------------
+ULONG TimingStop(const struct EClockVal* start)
+{
+	struct 	EClockVal now;
+
+	if (!timing.open)
+		return 0;
+
+	ReadEClock(&now);
+	return now.ev_lo - start->ev_lo;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Converts E-clock ticks to microseconds without overflowing 32 bits.
+//--------------------------------------------------------------------------------
+ULONG TicksToMicros(ULONG ticks)
+{
+	struct 	EClockVal now;
+	ULONG	freq;
+
+	freq = ReadEClock(&now);
+	if (freq < 1000)
+		return 0;
+
+	return (ticks / freq) * 1000000 + (ticks % freq) * 1000 / (freq / 1000);
+}
+
+
+//--------------------------------------------------------------------------------
+//	Prints the TIMING report. The output counters only cover what was written
+//	before it.
+//--------------------------------------------------------------------------------
+void PrintTiming(void)
+{
+	ULONG	bytes = timing.bytes + outBuf.len;
+
+	OutNewline();
+	OutStr(STR_TIMING_STARTUP " " STR_TIMING_CHECK " ");
+	OutNum(TicksToMicros(timing.checkTicks), 1, ALIGN_RIGHT);
+	OutStr(" " STR_TIMING_US ", " STR_TIMING_ARGS " ");
+	OutNum(TicksToMicros(timing.argsTicks), 1, ALIGN_RIGHT);
+	OutStr(" " STR_TIMING_US);
+	OutNewline();
+
+	OutStr(STR_TIMING_FORBID " ");
+	OutNum(timing.forbids, 1, ALIGN_RIGHT);
+	OutStr(" " STR_TIMING_SECTIONS ", ");
+	OutNum(TicksToMicros(timing.forbidTicks), 1, ALIGN_RIGHT);
+	OutStr(" " STR_TIMING_US " " STR_TIMING_TOTAL ", ");
+	OutNum(TicksToMicros(timing.forbidMaxTicks), 1, ALIGN_RIGHT);
+	OutStr(" " STR_TIMING_US " " STR_TIMING_LONGEST);
+	OutNewline();
+
+	OutStr(STR_TIMING_OUTPUT " ");
+	OutNum(timing.rows, 1, ALIGN_RIGHT);
+	OutStr(" " STR_TIMING_ROWS ", ");
+	OutNum(bytes, 1, ALIGN_RIGHT);
+	OutStr(" " STR_TIMING_BYTES ", ");
+	OutNum(timing.writes, 1, ALIGN_RIGHT);
+	OutStr(" " STR_TIMING_WRITES);
+	OutNewline();
+}
+
+
+//--------------------------------------------------------------------------------
+//	Writes the TIMING report as a member of the JSON object.
+//--------------------------------------------------------------------------------
+void EncodeTiming(void)
+{
+	ULONG	bytes = timing.bytes + outBuf.len;
+
+	OutChar(',');
+	EncodeKey(KEY_TIMING);
+	OutChar('{');
+	EncodeKey(KEY_CHECK_US);
+	OutNum(TicksToMicros(timing.checkTicks), 1, ALIGN_LEFT);
+	OutChar(',');
+	EncodeKey(KEY_READARGS_US);
+	OutNum(TicksToMicros(timing.argsTicks), 1, ALIGN_LEFT);
+	OutChar(',');
+	EncodeKey(KEY_FORBIDS);
+	OutNum(timing.forbids, 1, ALIGN_LEFT);
+	OutChar(',');
+	EncodeKey(KEY_FORBID_US);
+	OutNum(TicksToMicros(timing.forbidTicks), 1, ALIGN_LEFT);
+	OutChar(',');
+	EncodeKey(KEY_FORBID_MAX_US);
+	OutNum(TicksToMicros(timing.forbidMaxTicks), 1, ALIGN_LEFT);
+	OutChar(',');
+	EncodeKey(KEY_ROWS);
+	OutNum(timing.rows, 1, ALIGN_LEFT);
+	OutChar(',');
+	EncodeKey(KEY_BYTES);
+	OutNum(bytes, 1, ALIGN_LEFT);
+	OutChar(',');
+	EncodeKey(KEY_WRITES);
+	OutNum(timing.writes, 1, ALIGN_LEFT);
+	OutChar('}');
+}
+
+
+//--------------------------------------------------------------------------------
+//	Records a history frame of every task every opts->daemon seconds, until
+//	Ctrl-C is pressed or DAEMON=0 is used. The frames are kept in a ring buffer
+//	on a public port, so HISTORY can show them. Start it with Run >NIL: to let
+//	it carry on in the background.
+//--------------------------------------------------------------------------------
+int RunDaemon(Options* opts)
+{
+	struct 	timerequest* timer = NULL;
+	HistoryPort* hp;
+	Snapshot snaps[2] = {{0}};
+	Snapshot* prev = &snaps[0];
+	Snapshot* cur = &snaps[1];
+	Snapshot* swap;
+	FrameBuf frame = {0};
+	BOOL	running;
+	BOOL	added = FALSE;
+	int		rc = RETURN_OK;
+
+	// Everything is allocated up front, so recording never runs out of memory
+	hp = AllocVec(sizeof(HistoryPort) + HISTORY_SIZE, MEMF_PUBLIC | MEMF_CLEAR);
+	frame.data = AllocVec(HISTORY_SIZE, MEMF_ANY);
+	frame.max = HISTORY_SIZE;
+	if (hp == NULL || frame.data == NULL) {
+		PrintFault(ERROR_NO_FREE_STORE, NULL);
+		rc = RETURN_FAIL;
+		goto cleanup;
+	}
+
+	if ((timer = OpenTimer(UNIT_VBLANK)) == NULL) {
+		rc = RETURN_FAIL;
+		goto cleanup;
+	}
+
+	hp->port.mp_Node.ln_Name = HISTORY_PORT;
+	hp->port.mp_Node.ln_Type = NT_MSGPORT;
+	hp->port.mp_Flags = PA_IGNORE;
+	hp->port.mp_SigTask = FindTask(NULL);
+	NewList(&hp->port.mp_MsgList);
+	hp->size = HISTORY_SIZE;
+	hp->interval = opts->daemon;
+
+	// Only one daemon can own the port
+	Forbid();
+	running = FindPort(HISTORY_PORT) != NULL;
+	if (!running) {
+		AddPort(&hp->port);
+		added = TRUE;
+	}
+	Permit();
+
+	if (running) {
+		OutMsg(STR_DAEMON_RUNNING);
+		rc = RETURN_WARN;
+		goto cleanup;
+	}
+
+	for (;;)
+	{
+		rc = CaptureTasks(opts, cur);
+		if (rc != RETURN_OK)
+			break;	// Exit the for loop
+
+		RecordFrame(hp, &frame, prev, cur);
+
+		// The frame just taken is what the next one is compared with
+		swap = prev;
+		prev = cur;
+		cur = swap;
+
+		// We're not running at all while waiting for the next frame
+		if (!WaitTimer(timer, opts->daemon, 0))
+			break;	// Exit the for loop
+	}
+
+cleanup:
+	if (added)
+		RemPort(&hp->port);
+
+	if (timer)
+		CloseTimer(timer);
+
+	FreeSnapshot(&snaps[0]);
+	FreeSnapshot(&snaps[1]);
+
+	if (frame.data)
+		FreeVec(frame.data);
+	if (hp)
+		FreeVec(hp);
+
+	return rc;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Sends Ctrl-C to the running daemon, for DAEMON=0.
+//--------------------------------------------------------------------------------
+int StopDaemon(void)
+{
+	struct 	MsgPort* port;
+
+	Forbid();
+	if ((port = FindPort(HISTORY_PORT)) != NULL)
+		Signal(port->mp_SigTask, SIGBREAKF_CTRL_C);
+	Permit();
+
+	if (port == NULL) {
+		OutMsg(STR_NO_DAEMON);
+		return RETURN_WARN;
+	}
+
+	return RETURN_OK;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Encodes cur as a frame against prev & adds it to the ring buffer. The oldest
+//	key frame & the delta frames that follow it are dropped to make room. A key
+//	frame is written instead of a delta if the delta would need the newest key
+//	frame to be dropped.
+//--------------------------------------------------------------------------------
+void RecordFrame(HistoryPort* hp, FrameBuf* frame, Snapshot* prev, Snapshot* cur)
+{
+	struct 	DateStamp now;
+	UBYTE*	ring = (UBYTE*)(hp + 1);
+	ULONG	time;
+	ULONG	first;
+	ULONG	i;
+	BOOL	key;
+
+	DateStamp(&now);
+	time = (ULONG)now.ds_Days * 86400 + now.ds_Minute * 60 + now.ds_Tick / TICKS_PER_SECOND;
+
+	key = frame->needKey || hp->recorded % HISTORY_KEY_EVERY == 0;
+	EncodeFrame(frame, prev, cur, time, key);
+	if (!key && frame->len > hp->size - hp->groupBytes) {
+		key = TRUE;
+		EncodeFrame(frame, prev, cur, time, key);
+	}
+
+	// Names are remembered first, so HISTORY never finds a frame without them
+	for (i = 0; i < cur->sysCount; i++)
+		RememberName(hp, HashName(cur->recs[i].name), cur->recs[i].name);
+
+	Forbid();
+
+	hp->recorded++;
+
+	// The frame length is only a UWORD
+	if (frame->len > frame->max || frame->len > hp->size || frame->len > 0xFFFF) {
+		hp->dropped++;
+		Permit();
+		frame->needKey = TRUE;
+		return;
+	}
+
+	while (hp->size - hp->used < frame->len)
+		DropHistoryGroup(hp);
+
+	first = hp->size - hp->tail;
+	if (first > frame->len)
+		first = frame->len;
+	memcpy(ring + hp->tail, frame->data, first);
+	memcpy(ring, frame->data + first, frame->len - first);
+	hp->tail = (hp->tail + frame->len) % hp->size;
+
+	hp->used += frame->len;
+	hp->frames++;
+	hp->groupBytes = key ? frame->len : hp->groupBytes + frame->len;
+
+	Permit();
+
+	frame->needKey = FALSE;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Drops the oldest key frame & the delta frames that depend on it from the
+//	ring buffer. Must be called under Forbid().
+//--------------------------------------------------------------------------------
+void DropHistoryGroup(HistoryPort* hp)
+{
+	UBYTE*	ring = (UBYTE*)(hp + 1);
+	ULONG	len;
+	BOOL	key = TRUE;
+
+	while (hp->frames && (key || !(ring[(hp->head + 2) % hp->size] & HFRAME_KEY)))
+	{
+		len = (ring[hp->head] << 8) | ring[(hp->head + 1) % hp->size];
+		hp->head = (hp->head + len) % hp->size;
+		hp->used -= len;
+		hp->frames--;
+		key = FALSE;
+	}
+
+	// The newest group has gone too
+	if (hp->frames == 0)
+		hp->groupBytes = 0;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Encodes the tasks of cur as a frame. Both snapshots must be in task address
+//	order. A key frame doesn't look at prev.
+//--------------------------------------------------------------------------------
+void EncodeFrame(FrameBuf* fb, const Snapshot* prev, const Snapshot* cur, ULONG time, BOOL key)
+{
+	const TaskRec* p = prev->recs;
+	const TaskRec* pend = prev->recs + (key ? 0 : prev->sysCount);
+	const TaskRec* c;
+	UBYTE	changes;
+	ULONG	i;
+
+	fb->len = 0;
+	fb->runCount = 0;
+
+	FramePut(fb, 0, 2);					// Length, filled in below
+	FramePut(fb, key ? HFRAME_KEY : 0, 1);
+	FramePut(fb, time, 4);
+	FramePut(fb, cur->sysCount, 2);
+
+	for (i = 0; i < cur->sysCount; i++)
+	{
+		c = &cur->recs[i];
+
+		// Tasks of the previous frame below this address have gone
+		while (p < pend && (ULONG)p->task < (ULONG)c->task) {
+			FrameRun(fb, HOP_SKIP);
+			p++;
+		}
+
+		if (p < pend && p->task == c->task && strcmp(p->name, c->name) == 0) {
+			changes = TaskRecChanges(p++, c);
+			if (changes == 0) {
+				FrameRun(fb, HOP_COPY);
+				continue;
+			}
+			FrameFlushRun(fb);
+			FramePut(fb, HOP_CHANGE | changes, 1);
+		}
+		else {
+			// A different task at the same address
+			if (p < pend && p->task == c->task) {
+				FrameRun(fb, HOP_SKIP);
+				p++;
+			}
+			FrameFlushRun(fb);
+			FramePut(fb, HOP_NEW, 1);
+			FramePut(fb, HashName(c->name), 4);
+			changes = HCH_ALL;
+		}
+
+		FrameFields(fb, c, changes);
+	}
+
+	// Tasks of the previous frame past the last one here have gone without
+	// needing a HOP_SKIP, as nothing follows them
+	FrameFlushRun(fb);
+
+	if (fb->max >= 2) {
+		fb->data[0] = (UBYTE)(fb->len >> 8);
+		fb->data[1] = (UBYTE)fb->len;
+	}
+}
+
+
+//--------------------------------------------------------------------------------
+//	Returns the HCH_* flags of the frame fields that differ between two records.
+//--------------------------------------------------------------------------------
+UBYTE TaskRecChanges(const TaskRec* a, const TaskRec* b)
+{
+	UBYTE	changes = 0;
+
+	if (a->pri != b->pri)
+		changes |= HCH_PRI;
+	if (HistState(a) != HistState(b))
+		changes |= HCH_STATE;
+	if (a->stackUsed != b->stackUsed)
+		changes |= HCH_USED;
+	if (a->stackSize != b->stackSize)
+		changes |= HCH_SIZE;
+	if (a->cliNum != b->cliNum)
+		changes |= HCH_CLI;
+
+	return changes;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Returns the frame state byte of a record.
+//--------------------------------------------------------------------------------
+UBYTE HistState(const TaskRec* rec)
+{
+	return (UBYTE)(rec->state | (rec->type == NT_PROCESS ? HSTATE_PROCESS : 0));
+}
+
+
+//--------------------------------------------------------------------------------
+//	Encodes the fields of a record selected by the HCH_* flags.
+//--------------------------------------------------------------------------------
+void FrameFields(FrameBuf* fb, const TaskRec* rec, UBYTE fields)
+{
+	if (fields & HCH_PRI)
+		FramePut(fb, (UBYTE)rec->pri, 1);
+	if (fields & HCH_STATE)
+		FramePut(fb, HistState(rec), 1);
+	if (fields & HCH_USED)
+		FramePutVar(fb, rec->stackUsed);
+	if (fields & HCH_SIZE)
+		FramePutVar(fb, rec->stackSize);
+	if (fields & HCH_CLI)
+		FramePutVar(fb, rec->cliNum);
+}
+
+
+//--------------------------------------------------------------------------------
+//	Appends the low bytes of value to the frame, big-endian.
+//--------------------------------------------------------------------------------
+void FramePut(FrameBuf* fb, ULONG value, int bytes)
+{
+	while (bytes--) {
+		if (fb->len < fb->max)
+			fb->data[fb->len] = (UBYTE)(value >> (bytes * 8));
+		fb->len++;
+	}
+}
+
+
+//--------------------------------------------------------------------------------
+//	Appends a zigzag-encoded value to the frame, 7 bits per byte, low bits
+//	first. The top bit of each byte is set if more bytes follow.
+//--------------------------------------------------------------------------------
+void FramePutVar(FrameBuf* fb, LONG value)
+{
+	ULONG	zigzag = value < 0 ? ~((ULONG)value << 1) : (ULONG)value << 1;
+
+	while (zigzag >= 0x80) {
+		FramePut(fb, (zigzag & 0x7F) | 0x80, 1);
+		zigzag >>= 7;
+	}
+	FramePut(fb, zigzag, 1);
+}
+
+
+//--------------------------------------------------------------------------------
+//	Adds a task to the run of HOP_COPY or HOP_SKIP ops, writing out the run
+//	so far if it was of the other op.
+//--------------------------------------------------------------------------------
+void FrameRun(FrameBuf* fb, UBYTE op)
+{
+	if (fb->runCount && fb->runOp != op)
+		FrameFlushRun(fb);
+
+	fb->runOp = op;
+	fb->runCount++;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Writes out the run of HOP_COPY or HOP_SKIP ops, HISTORY_RUN_MAX tasks per op.
+//--------------------------------------------------------------------------------
+void FrameFlushRun(FrameBuf* fb)
+{
+	ULONG	count;
+
+	while (fb->runCount) {
+		count = fb->runCount < HISTORY_RUN_MAX ? fb->runCount : HISTORY_RUN_MAX;
+		FramePut(fb, fb->runOp | (count - 1), 1);
+		fb->runCount -= count;
+	}
+}
+
+
+//--------------------------------------------------------------------------------
+//	Reads a big-endian value from the frame. Reading past the end returns 0 and
+//	leaves fb->len past fb->max.
+//--------------------------------------------------------------------------------
+ULONG FrameGet(FrameBuf* fb, int bytes)
+{
+	ULONG	value = 0;
+
+	while (bytes--) {
+		value <<= 8;
+		if (fb->len < fb->max)
+			value |= fb->data[fb->len];
+		fb->len++;
+	}
+
+	return value;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Reads a value written by FramePutVar().
+//--------------------------------------------------------------------------------
+LONG FrameGetVar(FrameBuf* fb)
+{
+	ULONG	zigzag = 0;
+	ULONG	byte;
+	int		shift;
 
-	// ReadArgs already filters out invalid characters, so we don't need to do
-	// that here. Instead, we can just check for a trailing colon & remove it.
-	if (cleanName[strlen(cleanName) - 1] == ':') {
-		cleanName[strlen(cleanName) - 1] = '\0';
+	for (shift = 0; shift < 35; shift += 7) {
+		byte = FrameGet(fb, 1);
+		zigzag |= (byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+			break;	// Exit the for loop
 	}
 
-	return TRUE;
+	return (zigzag & 1) ? (LONG)~(zigzag >> 1) : (LONG)(zigzag >> 1);
 }
 
 
-//-----------------------------------------------------------------------------
-//	Prints information about Shell/CLI processes
-//-----------------------------------------------------------------------------
-int PrintShellProcesses(Mode mode, OutFrmt format, int start, int finish, char* cmd_pat)
+//--------------------------------------------------------------------------------
+//	Returns the FNV-1a hash of a task name. 0 is kept for unused name slots.
+//--------------------------------------------------------------------------------
+ULONG HashName(const char* name)
 {
-	struct 	Process* process;
-	struct 	CommandLineInterface* cli;
-	long 	num;
-	int		rc = RETURN_OK;
-
-	// Only print section header if we're showing both system & CLI processes
-	// and format is not COMMAND
-	if (mode == MODE_ALL && format != FORMAT_COMMAND)
-		Printf("\n%s\n", STR_CLI_HEADING);
+	ULONG	hash = 2166136261UL;
 
-	// Print header based on output format
-	switch (format) {
-		case FORMAT_VERBOSE:
-			Printf(CLI_VERBOSE, CLI_VERBOSE_TOP);
-			Printf(CLI_VERBOSE, CLI_VERBOSE_BOT);
-			Printf(CLI_VERBOSE, CLI_VERBOSE_DIV);
-			break;
-		case FORMAT_TCB:
-			Printf(CLI_TCB, CLI_TCB_TOP);
-			Printf(CLI_TCB, CLI_TCB_BOT);
-			Printf(CLI_TCB, CLI_TCB_DIV);
-			break;
-		case FORMAT_SHORT:
-			Printf(CLI_SHORT, CLI_SHORT_TOP);
-			Printf(CLI_SHORT, CLI_SHORT_BOT);
-			Printf(CLI_SHORT, CLI_SHORT_DIV);
-			break;
-		case FORMAT_COMMAND:
-			// No header for command mode
-			rc = RETURN_WARN;  	// Assume we won't find it
-			break;
-		default:
-			// Shouldn't get here so fail if we do
-			rc = RETURN_FAIL;
-			goto end;
-			break;
-	}
+	while (*name)
+		hash = ((hash ^ (UBYTE)*name++) * 16777619UL) & 0xFFFFFFFFUL;
 
-	// Per the Amiga DOS library docs, FindCliProc() is normally used with Forbid()
-	Forbid();
-	{
-		// Loop through all the CLIs
-		for (num = start; num <= finish; num++)
-		{
-			// Process struct has the stack size & pointer to the CLI struct
-			process = FindCliProc(num);
-
-			if (process == NULL) {
-				// If the user requested a specific process number, show an error
-				// message. If we're scanning all processes, just skip it.
-				if (start == finish)
-					Printf(" %3.3ld %s\n", num, STR_NO_PROCESS);
-				continue;	// Go to next process
-			}
+	return hash ? hash : 1;
+}
 
-			// Convert BPTR to CommandLineInterface pointer
-			cli = (struct CommandLineInterface*) BADDR((*process).pr_CLI);
 
-			if (cli == NULL) {
-				Printf(" %s\n", STR_ERR_GET_CLI);
-				continue;	// Go to next process
-			}
+//--------------------------------------------------------------------------------
+//	Puts a task name in the daemon's name table, if it isn't there already. It
+//	goes in the first free slot from its hash on, or replaces the name in the
+//	first slot if they're all taken.
+//--------------------------------------------------------------------------------
+void RememberName(HistoryPort* hp, ULONG hash, const char* name)
+{
+	HistName* slot = NULL;
+	HistName* entry;
+	int		i;
 
-			// If in COMMAND mode, check if the command name matches the user-supplied pattern
-			if (format == FORMAT_COMMAND)
-			{
-				if (CheckCommandMatch(cli->cli_CommandName, cmd_pat) == TRUE) {
-					// Match found, print only the CLI number 
-					// to match the output of STATUS and stop
-					Printf("%2ld\n", num);
-					rc = RETURN_OK;
-					break;	// Exit the for loop
-				}
-				// No match
-				rc = RETURN_WARN;
-				continue;	// Go to next process
-			}
+	for (i = 0; i < HISTORY_NAME_PROBES; i++)
+	{
+		entry = &hp->names[(hash + i) & (HISTORY_NAMES - 1)];
+		if (entry->hash == hash)
+			return;
+		if (entry->hash == 0 && slot == NULL)
+			slot = entry;
+	}
 
-			// CLI number
-			Printf(" %3.3ld", num);
+	if (slot == NULL)
+		slot = &hp->names[hash & (HISTORY_NAMES - 1)];
 
-			// Command name if not TCB format
-			if (format != FORMAT_TCB) {
-				if (bstrlen(cli->cli_CommandName) > 0)
-					Printf(" %-33.33b",	cli->cli_CommandName);		// %b prints BSTR strings (AmigaOS only)
-				else
-					Printf(" %-33.33s",	STR_NO_COMMAND);
-			}
+	slot->hash = 0;
+	strcpyn(slot->name, name, sizeof(slot->name));
+	slot->hash = hash;
+}
 
-			// Print the rest of the process details if not SHORT format
-			if (format != FORMAT_SHORT)
-			{
-				// Priority
-				Printf(" %4.4ld", process->pr_Task.tc_Node.ln_Pri);
-				// Global vector
-				Printf(" %4.4ld", process->pr_GlobVec ? *(long*)process->pr_GlobVec : 0);
-				// Stack usage
-				Printf(" %6.6ld", (long)process->pr_Task.tc_SPUpper - (long)process->pr_Task.tc_SPReg);
-				// Total stack size
-				Printf(" %6.6ld", (long)process->pr_Task.tc_SPUpper - (long)process->pr_Task.tc_SPLower);
-				// Failat level
-				Printf(" %4.4ld", cli->cli_FailLevel);
-				// Last return code
-				Printf(" %3.3ld", cli->cli_ReturnCode);
-				// Background process?
-				Printf(" %4.3s", cli->cli_Background  ? STR_YES : STR_NO);
-			}
 
-			// End of the line
-			Printf("\n");
+//--------------------------------------------------------------------------------
+//	Copies the name with the given hash from the name table, or the hash itself
+//	as #xxxxxxxx if the name has been forgotten.
+//--------------------------------------------------------------------------------
+void LookupName(const HistoryPort* hp, ULONG hash, char* name)
+{
+	const HistName* entry;
+	static const char hex[] = "0123456789abcdef";
+	int		i;
 
-			// Check for Ctrl-C break
-			if (CheckSignal(SIGBREAKF_CTRL_C)) {
-                PrintFault(ERROR_BREAK, NULL);
-                break;	// Exit the for loop
-			}
+	for (i = 0; i < HISTORY_NAME_PROBES; i++)
+	{
+		entry = &hp->names[(hash + i) & (HISTORY_NAMES - 1)];
+		if (entry->hash == hash) {
+			strcpyn(name, entry->name, HISTORY_NAME_SIZE);
+			return;
 		}
+	}
 
-	} // End Forbid() section
-	Permit();
-
-end:
-	return rc;
+	*name++ = '#';
+	for (i = 28; i >= 0; i -= 4)
+		*name++ = hex[(hash >> i) & 0x0F];
+	*name = '\0';
 }
 
 
 //--------------------------------------------------------------------------------
-//	Prints information about the current process.
+//	Shows the frames recorded by the running daemon, oldest first. The frames
+//	are copied out under Forbid(), so the daemon can carry on while they're
+//	being shown.
 //--------------------------------------------------------------------------------
-int PrintThisProcess(OutFrmt format, int* taskCount)
+int PrintHistory(Options* opts)
 {
-	struct 	Process* process;
-	struct 	CommandLineInterface* cli;
+	struct 	MsgPort* port;
+	HistoryPort* copy;
+	HistEntry* entries = NULL;
+	HistEntry* prev;
+	HistEntry* cur;
+	HistEntry* swap;
+	FrameBuf fb = {0};
+	TaskRec	rec;
+	UBYTE*	ring;
+	ULONG	first;
+	ULONG	length;
+	ULONG	count;
+	ULONG	prevCount = 0;
+	ULONG	maxCount = 0;
+	ULONG	time;
+	ULONG	frame;
+	ULONG	i;
+	BOOL	cliOnly = opts->mode == MODE_CLI;
+	BOOL	found = FALSE;
 	int		rc = RETURN_OK;
 
-	// Get our own process structure
-	process = (struct Process*)FindTask(NULL);
-	if (process == NULL) {
-		Printf("%s\n", STR_ERR_GET_OWN_PROC);
+	if ((copy = AllocVec(sizeof(HistoryPort) + HISTORY_SIZE, MEMF_ANY)) == NULL) {
+		PrintFault(ERROR_NO_FREE_STORE, NULL);
 		return RETURN_FAIL;
 	}
 
-	// Convert BPTR to CommandLineInterface pointer
-	cli = (struct CommandLineInterface*) BADDR((*process).pr_CLI);
-	if (cli == NULL) {
-		Printf("%s\n", STR_ERR_GET_CLI);
-		return RETURN_FAIL;
+	// Copy the frames out oldest first, so they don't wrap
+	Forbid();
+	if ((port = FindPort(HISTORY_PORT)) != NULL) {
+		memcpy(copy, port, sizeof(HistoryPort));
+		if (copy->size == HISTORY_SIZE) {
+			ring = (UBYTE*)((HistoryPort*)port + 1);
+			first = copy->size - copy->head;
+			if (first > copy->used)
+				first = copy->used;
+			memcpy(copy + 1, ring + copy->head, first);
+			memcpy((UBYTE*)(copy + 1) + first, ring, copy->used - first);
+			found = TRUE;
+		}
 	}
+	Permit();
 
-	// Task/Process counter
-	Printf(" %3.3ld", (*taskCount)++);
-
-	// Print header based on output format
-	if (format != FORMAT_TCB) {
-		if (bstrlen(cli->cli_CommandName) > 0) 
-			Printf(" %-35.35b",	cli->cli_CommandName);
-		else
-			Printf(" %-35.35s", process->pr_Task.tc_Node.ln_Name);
+	if (port == NULL) {
+		OutMsg(STR_NO_DAEMON);
+		rc = RETURN_WARN;
+		goto cleanup;
 	}
 
-	// Print the rest of the process details if not SHORT mode
-	if (format != FORMAT_SHORT) 
+	fb.data = (UBYTE*)(copy + 1);
+	fb.max = found ? copy->used : 0;
+
+	// Find the most tasks in a frame, to size the decoded frames
+	for (frame = 0; found && frame < copy->frames; frame++)
 	{
-		// Priority
-		Printf(" %4.4ld", process->pr_Task.tc_Node.ln_Pri);
-		// Type
-		Printf("  %-2.2s", "P");
-		// CLI number (unless 0 which means not a CLI process)
-		Printf(" %3.3ld", process->pr_TaskNum);
-		// Current state
-		Printf(" %5.5s", GetStateName(process->pr_Task.tc_State));
-		// Used stack size
-		Printf(" %6.6ld", (long)process->pr_Task.tc_SPUpper - (long)process->pr_Task.tc_SPReg);
-		// Total stack size
-		Printf(" %6.6ld", (long)process->pr_Task.tc_SPUpper - (long)process->pr_Task.tc_SPLower);
+		first = fb.len;
+		length = FrameGet(&fb, 2);
+		FrameGet(&fb, 5);
+		count = FrameGet(&fb, 2);
+		if (length < HFRAME_HEAD || first + length > fb.max) {
+			found = FALSE;
+			break;	// Exit the for loop
+		}
+		if (count > maxCount)
+			maxCount = count;
+		fb.len = first + length;
 	}
 
-	// End of the line
-	Printf("\n");
+	if (found)
+		entries = AllocVec(2 * (maxCount + 1) * sizeof(HistEntry), MEMF_ANY);
+	if (!found) {
+		OutMsg(STR_ERR_HISTORY);
+		rc = RETURN_FAIL;
+		goto cleanup;
+	}
+	if (entries == NULL) {
+		PrintFault(ERROR_NO_FREE_STORE, NULL);
+		rc = RETURN_FAIL;
+		goto cleanup;
+	}
+	prev = entries;
+	cur = entries + maxCount + 1;
 
-	return rc;
-}	
+	// Everything goes in a single table, whichever tasks are shown
+	opts->mode = MODE_SYSTEM;
+	if (opts->encoding != ENCODE_TEXT)
+		EncodeTableStart(opts, KEY_SYS_TABLE, BIN_TAG_SYS, histColumns, 0);
+	else if (!opts->noHead)
+		PrintTableHeader(histColumns, opts->show);
 
+	fb.len = 0;
+	for (frame = 0; frame < copy->frames; frame++)
+	{
+		if (!DecodeFrame(&fb, prev, prevCount, cur, &count, &time)) {
+			OutFlush();
+			OutMsg(STR_ERR_HISTORY);
+			rc = RETURN_FAIL;
+			break;	// Exit the for loop
+		}
 
-//--------------------------------------------------------------------------------
-//	Prints information about all tasks & processes in the given task list.
-//--------------------------------------------------------------------------------
-int PrintTaskList(OutFrmt format, struct List* taskList, int* taskCount)
-{
-	struct 	Node* node;
-	struct 	Task* task;
-	struct 	Process* process;
-	struct 	CommandLineInterface* cli;
-	int 	rc = RETURN_OK;
+		if (frame > 0 && opts->encoding == ENCODE_TEXT && !opts->noHead)
+			OutNewline();
 
-	if (taskList == NULL) {
-		Printf("%s\n", STR_INV_TASK_LIST);
-		return RETURN_FAIL;
-	}
+		for (i = 0; i < count; i++)
+		{
+			if (cliOnly && cur[i].cliNum == 0)
+				continue;
 
-	Forbid();
-	{
-		node = taskList->lh_Head;
+			memset(&rec, 0, sizeof(rec));
+			LookupName(copy, cur[i].hash, rec.name);
+			rec.type = (cur[i].state & HSTATE_PROCESS) ? NT_PROCESS : NT_TASK;
+			rec.state = cur[i].state & ~HSTATE_PROCESS;
+			rec.pri = cur[i].pri;
+			rec.cliNum = cur[i].cliNum;
+			rec.stackUsed = cur[i].stackUsed;
+			rec.stackSize = cur[i].stackSize;
 
-		// Traverse the task list
-		while (node->ln_Succ != NULL)
-		{
-			// Task count provides a running count of how many tasks/processes there are
-			Printf(" %3.3ld", (*taskCount)++);
-
-			// Determine what type of node this is (i.e. task or process)
-			switch (node->ln_Type)
-			{
-				case NT_TASK:
-					// Cast the Node pointer to a Task pointer
-					task = (struct Task*)node;
-
-					// Print task name if not TCB mode
-					if (format != FORMAT_TCB)
-						Printf(" %-35.35s", task->tc_Node.ln_Name);
-
-					// Print the rest of the task details if not SHORT mode
-					if (format != FORMAT_SHORT) 
-					{
-						// Priority
-						Printf(" %4.4ld", task->tc_Node.ln_Pri);
-						// Type
-						Printf("  %-2.2s", "T");
-						// CLI number (Tasks never have a CLI number)
-						Printf(" %3.3s", "");
-						// Current state
-						Printf(" %5.5s", GetStateName(task->tc_State));
-						// Stack usage
-						Printf(" %6.6ld", (long)task->tc_SPUpper - (long)task->tc_SPReg);
-						// Total stack size
-						Printf(" %6.6ld", (long)task->tc_SPUpper - (long)task->tc_SPLower);
-					}
-					break;
-
-				case NT_PROCESS:
-					
-					process = (struct Process*)node;
-
-					// Print process name or command name if not TCB mode
-					if (format != FORMAT_TCB)
-					{
-						// TaskNum is 0 if not a CLI process
-						if (process->pr_TaskNum == 0) 
-							Printf(" %-35.35s", process->pr_Task.tc_Node.ln_Name);
-						else
-						{
-							cli = (struct CommandLineInterface*) BADDR((*process).pr_CLI);
-							if (cli == NULL) {
-								Printf(" %s\n", STR_ERR_GET_CLI);
-								rc = RETURN_FAIL;
-								break;	// Exit the switch statement
-							}
-
-							// Print the command name if it exists, otherwise print the task name
-							if (bstrlen(cli->cli_CommandName) > 0) 
-								Printf(" %-35.35b",	cli->cli_CommandName);
-							else
-								Printf(" %-35.35s", process->pr_Task.tc_Node.ln_Name);
-						}
-					}
-
-					if (format != FORMAT_SHORT) 
-					{
-						// Priority
-						Printf(" %4.4ld", process->pr_Task.tc_Node.ln_Pri);
-						// Type
-						Printf("  %-2.2s", "P");
-
-						// CLI number (unless 0 which means not a CLI process)
-						if (process->pr_TaskNum != 0)
-							Printf(" %3.3ld", process->pr_TaskNum);
-						else
-							Printf(" %3.3s", "");
-
-						// Current state
-						Printf(" %5.5s", GetStateName(process->pr_Task.tc_State));
-						// Stack usage
-						Printf(" %6.6ld", (long)process->pr_Task.tc_SPUpper - (long)process->pr_Task.tc_SPReg);
-						// Total stack size
-						Printf(" %6.6ld", (long)process->pr_Task.tc_SPUpper - (long)process->pr_Task.tc_SPLower);
-					}
-					break;
-
-				default:
-					Printf("%s\n", STR_INV_TASK_TYPE);
-					// rc = RETURN_FAIL;
-					break;
-			}
+			if (opts->encoding != ENCODE_TEXT)
+				EncodeRecord(opts, histColumns, &rec, (long)time, FALSE);
+			else
+				PrintRecord(histColumns, opts->show, &rec, (long)time);
+		}
 
-			// End of the line
-			Printf("\n");
+		// This frame is what the next one is decoded against
+		swap = prev;
+		prev = cur;
+		cur = swap;
+		prevCount = count;
 
-			// Move to next task
-			node = node->ln_Succ;
+		// Check for Ctrl-C break
+		if (CheckSignal(SIGBREAKF_CTRL_C)) {
+			OutFlush();
+			PrintFault(ERROR_BREAK, NULL);
+			break;	// Exit the for loop
+		}
+	}
 
-			// Check for Ctrl-C break
-			if (CheckSignal(SIGBREAKF_CTRL_C)) {
-                PrintFault(ERROR_BREAK, NULL);
-                break;	// Exit the for loop
-			}
+	if (rc == RETURN_OK && opts->encoding == ENCODE_TEXT && !opts->noHead) {
+		OutNewline();
+		OutNum(copy->frames, 1, ALIGN_LEFT);
+		OutStr(" " STR_HISTORY_FRAMES ", ");
+		OutNum(copy->used, 1, ALIGN_LEFT);
+		OutStr(" " STR_HISTORY_BYTES ", " STR_HISTORY_EVERY " ");
+		OutNum(copy->interval, 1, ALIGN_LEFT);
+		OutStr(" " STR_HISTORY_SECONDS);
+		if (copy->dropped) {
+			OutStr(", ");
+			OutNum(copy->dropped, 1, ALIGN_LEFT);
+			OutStr(" " STR_HISTORY_DROPPED);
 		}
-	} // End Forbid() section
-	Permit();
+		OutNewline();
+	}
+
+cleanup:
+	if (entries)
+		FreeVec(entries);
+	FreeVec(copy);
 
 	return rc;
 }
 
 
 //--------------------------------------------------------------------------------
-// Checks if the given command pattern matches the command name.
-// Returns TRUE if it matches, FALSE if it doesn't or if there's an error.
+//	Decodes the frame at fb->len into cur & moves fb->len on to the next frame.
+//	prev holds the previous frame's tasks. Returns FALSE if the frame is damaged.
 //--------------------------------------------------------------------------------
-BOOL CheckCommandMatch(const BSTR cmd_name, const char* cmd_pat)
+BOOL DecodeFrame(FrameBuf* fb, const HistEntry* prev, ULONG prevCount, HistEntry* cur, ULONG* count, ULONG* time)
 {
-	// ParsePatternNoCase() docs say to make pattern buffer at least double the
-	// length of the string to match + 2
-	char	pattern[258] = {0};
-	char 	cmd[128] = {0};
-	long	result;
+	HistEntry* entry;
+	ULONG	end = fb->len;
+	ULONG	flags;
+	ULONG	op;
+	ULONG	run;
+	ULONG	p = 0;
+	ULONG	i = 0;
 
-	// Validate parameters
-	if (cmd_name == NULL || cmd_pat == NULL || bstrlen(cmd_name) <= 0 || strlen(cmd_pat) <= 0)
-		return FALSE;
+	end += FrameGet(fb, 2);
+	flags = FrameGet(fb, 1);
+	*time = FrameGet(fb, 4);
+	*count = FrameGet(fb, 2);
 
-	// Convert the command name from a BSTR to a C string
-	if (bstr2cstr(cmd_name, cmd, sizeof(cmd)) < 0) {
-		Printf(" %s\n", STR_ERR_GET_CMD);
-		return FALSE;
-	}
+	// Key frames stand on their own
+	if (flags & HFRAME_KEY)
+		prevCount = 0;
 
-	// Check if the user-supplied command string contains any wildcards
-	result = ParsePatternNoCase(cmd_pat, pattern, sizeof(pattern));
+	while (fb->len < end)
+	{
+		op = FrameGet(fb, 1);
+		if (op < HOP_SKIP) {
+			run = op - HOP_COPY + 1;
+			if (p + run > prevCount || i + run > *count)
+				return FALSE;
+			while (run--)
+				cur[i++] = prev[p++];
+			continue;
+		}
+		if (op < HOP_CHANGE) {
+			p += op - HOP_SKIP + 1;
+			if (p > prevCount)
+				return FALSE;
+			continue;
+		}
 
-	// Invalid pattern
-	if (result == -1) {
-		Printf("%s\n", STR_INV_CMD_PAT);
-		return FALSE;
-	}
+		if (i >= *count)
+			return FALSE;
+		entry = &cur[i++];
 
-	// Wildcards found
-	if (result == 1)
-		return MatchPatternNoCase(pattern, cmd);
-	
-	// No wildcards, do a simple string compare
-	if (result == 0)
-		if (stricmp(cmd, cmd_pat) == 0)
-			return TRUE;
+		if (op < HOP_NEW) {
+			if (p >= prevCount)
+				return FALSE;
+			*entry = prev[p++];
+		}
+		else if (op == HOP_NEW) {
+			entry->hash = FrameGet(fb, 4);
+			op = HCH_ALL;
+		}
+		else
+			return FALSE;
 
-	// No match was found
-	return FALSE;
+		if (op & HCH_PRI)
+			entry->pri = (BYTE)FrameGet(fb, 1);
+		if (op & HCH_STATE)
+			entry->state = (UBYTE)FrameGet(fb, 1);
+		if (op & HCH_USED)
+			entry->stackUsed = FrameGetVar(fb);
+		if (op & HCH_SIZE)
+			entry->stackSize = FrameGetVar(fb);
+		if (op & HCH_CLI)
+			entry->cliNum = FrameGetVar(fb);
+	}
+
+	return fb->len == end && end <= fb->max && i == *count;
 }
 
 
 //--------------------------------------------------------------------------------
-//	Returns a string representation of the task/process state.
+//	Formats the time of day of a DateStamp time in seconds as HH:MM:SS.
 //--------------------------------------------------------------------------------
-char* GetStateName(UBYTE state)
+void FormatTime(char* buffer, ULONG secs)
 {
-	switch (state) {
-		case TS_INVALID:
-			return STR_STATE_INVALID;
-		case TS_ADDED:
-			return STR_STATE_ADDED;
-		case TS_RUN:
-			return STR_STATE_RUN;
-		case TS_READY:
-			return STR_STATE_READY;
-		case TS_WAIT:
-			return STR_STATE_WAIT;
-		case TS_EXCEPT:
-			return STR_STATE_EXCEPT;
-		case TS_REMOVED:
-			return STR_STATE_REMOVED;
-		default:
-			return STR_STATE_UNDEFINED;
+	ULONG	part;
+	int		i;
+
+	secs %= 86400;
+	for (i = 6; i >= 0; i -= 3) {
+		part = secs % 60;
+		buffer[i] = (char)('0' + part / 10);
+		buffer[i + 1] = (char)('0' + part % 10);
+		buffer[i + 2] = i == 6 ? '\0' : ':';
+		secs /= 60;
 	}
 }
 
 
 //--------------------------------------------------------------------------------
-//	Checks that the Kickstart and Workbench versions meet the minimum requirements.
-//	Returns TRUE if requirements are met, FALSE otherwise.
+//	Formats a library version & revision as "version.revision". The buffer must
+//	hold at least 12 characters.
 //--------------------------------------------------------------------------------
-BOOL CheckRequirements(void)
+void FormatVersion(char* buffer, UWORD version, UWORD revision)
 {
-	// Check Kickstart version
-	if (SysBase->LibNode.lib_Version < KICKSTART_MIN_VER) {
-		Printf("%s\n", STR_KS_TOO_OLD);
-		return FALSE;
-	}
+	char	digits[12];							// Enough for 65535.65535
+	int		pos = sizeof(digits) - 1;
+	ULONG	value = revision;
 
-	// Check Workbench version
-	if (WorkbenchBase->lib_Version < OS_MIN_VER) {
-		Printf("%s\n", STR_OS_TOO_OLD);
-		return FALSE;
-	}
+	digits[pos] = '\0';
+	do {
+		digits[--pos] = '0' + (char)(value % 10);
+		value /= 10;
+	} while (value != 0);
 
-	return TRUE;
+	digits[--pos] = '.';
+	value = version;
+	do {
+		digits[--pos] = '0' + (char)(value % 10);
+		value /= 10;
+	} while (value != 0);
+
+	strcpy(buffer, &digits[pos]);
 }
 
 
@@ -683,3 +6567,198 @@ size_t bstr2cstr(BSTR bstring, char* buffer, size_t bufsize)
 	// Return the length of the converted string
 	return len;
 }
+
+
+//--------------------------------------------------------------------------------
+//	Copies a C string into a buffer of the given size, truncating if needed.
+//	A NULL string is copied as an empty string.
+//	Returns the length of the copied string.
+//--------------------------------------------------------------------------------
+size_t strcpyn(char* buffer, const char* string, size_t bufsize)
+{
+	size_t	len = 0;
+
+	if (string != NULL)
+		while (len < bufsize - 1 && string[len] != '\0') {
+			buffer[len] = string[len];
+			len++;
+		}
+
+	buffer[len] = '\0';
+
+	return len;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Writes out the contents of the output buffer with a single Write().
+//--------------------------------------------------------------------------------
+void OutFlush(void)
+{
+	if (outBuf.len > 0) {
+		Write(Output(), outBuf.data, outBuf.len);
+		timing.writes++;
+		timing.bytes += outBuf.len;
+		outBuf.len = 0;
+	}
+}
+
+
+//--------------------------------------------------------------------------------
+//	Adds a character to the output buffer, writing the buffer out if it's full.
+//--------------------------------------------------------------------------------
+void OutChar(char c)
+{
+	if (outBuf.len >= OUTBUF_SIZE)
+		OutFlush();
+
+	outBuf.data[outBuf.len++] = c;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Adds a C string to the output buffer.
+//--------------------------------------------------------------------------------
+void OutStr(const char* str)
+{
+	while (*str != '\0')
+		OutChar(*str++);
+}
+
+
+//--------------------------------------------------------------------------------
+//	Ends the current line. Trailing padding still in the buffer is dropped, and
+//	the buffer is written out if FLUSH=LINE was given. In WATCH mode the rest of
+//	the line is cleared, as it may still show an older version of the row.
+//--------------------------------------------------------------------------------
+void OutNewline(void)
+{
+	while (outBuf.len > 0 && outBuf.data[outBuf.len - 1] == ' ')
+		outBuf.len--;
+
+	if (outBuf.eraseEol)
+		OutStr(ESC_ERASE_EOL);
+
+	OutChar('\n');
+	outBuf.lines++;
+
+	if (outBuf.lineFlush)
+		OutFlush();
+}
+
+
+//--------------------------------------------------------------------------------
+//	Adds a C string followed by a newline to the output buffer.
+//--------------------------------------------------------------------------------
+void OutMsg(const char* msg)
+{
+	OutStr(msg);
+	OutNewline();
+}
+
+
+//--------------------------------------------------------------------------------
+//	Adds a C string padded to the given width to the output buffer. Strings
+//	longer than the width are truncated.
+//--------------------------------------------------------------------------------
+void OutField(const char* str, int width, int align)
+{
+	int		len = 0;
+	int		pad;
+
+	while (len < width && str[len] != '\0')
+		len++;
+
+	pad = width - len;
+
+	if (align == ALIGN_RIGHT)
+		for (; pad > 0; pad--)
+			OutChar(' ');
+	else if (align == ALIGN_CENTER)
+		for (; pad > (width - len) / 2; pad--)
+			OutChar(' ');
+
+	while (len-- > 0)
+		OutChar(*str++);
+
+	for (; pad > 0; pad--)
+		OutChar(' ');
+}
+
+
+//--------------------------------------------------------------------------------
+//	Adds a decimal number padded to the given width to the output buffer.
+//	Numbers wider than the column are never truncated.
+//--------------------------------------------------------------------------------
+void OutNum(long num, int width, int align)
+{
+	char	digits[24];							// Enough for any long
+	int		pos = sizeof(digits) - 1;
+	unsigned long value = num < 0 ? -(unsigned long)num : num;
+
+	digits[pos] = '\0';
+	do {
+		digits[--pos] = '0' + (char)(value % 10);
+		value /= 10;
+	} while (value != 0);
+
+	if (num < 0)
+		digits[--pos] = '-';
+
+	if ((int)sizeof(digits) - 1 - pos > width)
+		width = sizeof(digits) - 1 - pos;
+
+	OutField(&digits[pos], width, align);
+}
+
+
+//--------------------------------------------------------------------------------
+//	Moves the cursor to the start of the given screen line (1 = top line).
+//--------------------------------------------------------------------------------
+void OutCursor(ULONG line)
+{
+	OutStr(CSI);
+	OutNum((long)line, 1, ALIGN_RIGHT);
+	OutStr(";1H");
+}
+
+
+//--------------------------------------------------------------------------------
+//	Adds raw bytes to the output buffer (BIN output).
+//--------------------------------------------------------------------------------
+void OutBytes(const void* data, ULONG len)
+{
+	const char* bytes = data;
+
+	while (len-- > 0)
+		OutChar(*bytes++);
+}
+
+
+//--------------------------------------------------------------------------------
+//	Adds a number given in tenths as a decimal with one fractional digit
+//	(e.g. 125 as "12.5"), padded to the given width.
+//--------------------------------------------------------------------------------
+void OutTenths(long num, int width, int align)
+{
+	char	digits[24];							// Enough for any long
+	int		pos = sizeof(digits) - 1;
+	unsigned long value = num < 0 ? -(unsigned long)num : num;
+
+	digits[pos] = '\0';
+	digits[--pos] = '0' + (char)(value % 10);
+	digits[--pos] = '.';
+	value /= 10;
+	do {
+		digits[--pos] = '0' + (char)(value % 10);
+		value /= 10;
+	} while (value != 0);
+
+	if (num < 0)
+		digits[--pos] = '-';
+
+	if ((int)sizeof(digits) - 1 - pos > width)
+		width = sizeof(digits) - 1 - pos;
+
+	OutField(&digits[pos], width, align);
+}
@@ -1,6 +1,58 @@
 #ifndef SHOWPROC_H
 #define SHOWPROC_H
 
+//--------------------------------------------------------------------------------
+// Constants
+//--------------------------------------------------------------------------------
+#define KICKSTART_MIN_VER	37		// Min Kickstart version required (37 = 2.04)
+#define OS_MIN_VER			37		// Min AmigaOS version required (37 = 2.04)
+
+#define PROGRAM_PRIORITY	11		// High enough to reduce risk of changes while 
+									// reading tasks, but not too high to
+									// interfere with system operation
+#define MAX_CMD_NAME_LEN	102		// Max command name length
+#define CMD_PAT_SIZE		(MAX_CMD_NAME_LEN * 2 + 2)	// ParsePatternNoCase() buffer size
+#define CMD_PAT_WILDCARDS	"#?*()|~[]%'"	// Characters that end a pattern's literal prefix
+#define SNAP_INITIAL_RECS	64		// Records allocated before the first walk
+#define SNAP_SLACK_RECS		16		// Extra records allocated when the arena grows
+#define SNAP_NAME_SIZE		104		// Name buffer size in each snapshot record
+#define SNAP_SIGTASK_SIZE	32		// Port signal task name buffer size in each record
+#define SNAP_MAX_MSGS		9999	// Messages counted at a port before giving up
+#define SNAP_WAITPORT_SIZE	32		// Waited-on port name buffer size in each record
+#define PLAN_MAX_COLS		24		// Most columns COLS can name
+#define PROC_MAX_NUM		99999	// Highest Shell/CLI number PROCESS can name
+#define CLI_LAST_NUM		0x7FFFFFFF	// Walks up to this number visit every Shell/CLI process
+#define MEMMAP_MAX_REGIONS	16		// MemHeaders shown by MEMMAP
+#define MEMMAP_NAME_SIZE	32		// Name buffer size of each MEMMAP region
+#define MEMMAP_CLASSES		32		// Free chunk size classes (powers of 2) of each region
+#define TRACE_EVENTS		256		// Events the TRACE ring buffer holds (must be a power of 2)
+#define TRACE_NAME_SIZE		32		// Name buffer size of each TRACE event
+#define TRACE_PERIOD_US		100000	// Time between TRACE drains of the ring buffer
+#define TRACE_RETRY_TICKS	50		// Delay() between tries to remove the TRACE patches
+#define OUTBUF_SIZE			2048	// Output buffer size, about one 80x25 screenful
+#define WATCH_MAX_SECS		3600	// Longest WATCH refresh interval
+#define SAMPLE_MIN_MS		10		// Shortest SAMPLE window
+#define SAMPLE_MAX_MS		3600000	// Longest SAMPLE window (1 hour)
+#define SAMPLE_PERIOD_US	5000	// Time between samples (200 per second)
+#define SAMPLE_SLOTS		128		// Tasks per sample bank (must be a power of 2)
+#define SAMPLE_PROBES		8		// Slots tried before a sample is dropped
+#define STACK_REC_ROUND		1024	// Recommended stack sizes are rounded up to this
+#define DAEMON_MAX_SECS		86400	// Longest DAEMON interval (1 day)
+#define DAEMON_STOP			-1		// Options->daemon value that stops a running daemon
+#define HISTORY_SIZE		16384	// Bytes of frames kept by the daemon's ring buffer
+#define HISTORY_NAMES		256		// Task names remembered by the daemon (must be a power of 2)
+#define HISTORY_NAME_SIZE	32		// Name buffer size of each remembered name
+#define HISTORY_NAME_PROBES	4		// Slots a name may be put in, from its hash on
+#define HISTORY_KEY_EVERY	64		// Frames between key frames
+#define HISTORY_RUN_MAX		64		// Most tasks covered by one COPY or SKIP op
+#define HISTORY_PORT		"ShowProc.history"	// Public port holding the ring buffer
+#define ALERT_MAX_VALUE		100000000	// ALERT thresholds must be below this
+#define ALERT_HYST_DIV		10		// WATCH alerts clear 1/n of the threshold past it
+
+#define LVO_ADDTASK			-282	// exec.library AddTask() vector offset
+#define LVO_REMTASK			-288	// exec.library RemTask() vector offset
+
+
 //--------------------------------------------------------------------------------
 // typedefs, enums & structs
 //--------------------------------------------------------------------------------
@@ -9,9 +61,19 @@
 typedef enum Mode { 
 	MODE_ALL,				// Show both system & Shell/CLI processes
 	MODE_CLI,				// Show Shell/CLI processes only
-	MODE_SYSTEM				// Show system tasks/processes
+	MODE_SYSTEM,			// Show system tasks/processes
+	MODE_LISTS				// Show the exec lists only
 } Mode;
 
+// exec lists that can be shown besides the tasks, in the order they're shown
+typedef enum ExecList {
+	LIST_LIBS,				// SysBase->LibList
+	LIST_DEVS,				// SysBase->DeviceList
+	LIST_PORTS,				// SysBase->PortList
+	LIST_RES,				// SysBase->ResourceList
+	LIST_COUNT
+} ExecList;
+
 // Output formats
 typedef enum OutFrmt { 
 	FORMAT_VERBOSE, 		// Show detailed info about each task/process
@@ -20,12 +82,508 @@ typedef enum OutFrmt {
 	FORMAT_COMMAND			// Show only the Shell/CLI process number
 } OutFrmt;
 
+// How the tables are written out
+typedef enum Encoding {
+	ENCODE_TEXT,			// Fixed-width text tables
+	ENCODE_CSV,				// Comma-separated values, one line per record
+	ENCODE_JSON,			// JSON object with an array of records per table
+	ENCODE_BIN				// BinHeader, then a BinTable and its BinRecs per table
+} Encoding;
+
+// Order the table rows are shown in
+typedef enum SortKey {
+	SORT_NONE,				// Task list order (system) or CLI number order (CLI)
+	SORT_PRI,				// Highest priority first
+	SORT_STACK,				// Most stack used first
+	SORT_STACKPCT,			// Largest share of the stack used first
+	SORT_NAME,				// Name in alphabetical order
+	SORT_STATE,				// Running first, then ready, waiting, etc.
+	SORT_MEM,				// Most memory held first
+	SORT_CPU,				// Most CPU used first (SAMPLE only)
+	SORT_TASK				// Task address, so DAEMON frames can be compared
+} SortKey;
+
+// Fields that can be shown in a table column
+typedef enum Field {
+	FIELD_END,				// Marks the end of a column table
+	FIELD_NUM,				// Row number (system) or Shell/CLI number (CLI)
+	FIELD_NAME,				// Task/process name or command name
+	FIELD_COMMAND,			// Command name of a Shell/CLI process
+	FIELD_PRI,				// Priority
+	FIELD_TYPE,				// Task or process
+	FIELD_CLI,				// Shell/CLI number, blank if not a CLI process
+	FIELD_STATE,			// Current state
+	FIELD_STACK_USED,		// Stack in use
+	FIELD_STACK_SIZE,		// Total stack size
+	FIELD_STACK_PEAK,		// Most stack ever used (HIGHWATER only)
+	FIELD_STACK_REC,		// Recommended stack size (HIGHWATER only)
+	FIELD_GLOBVEC,			// Global vector size
+	FIELD_FAILAT,			// Failat level
+	FIELD_RC,				// Last return code
+	FIELD_BG,				// Running in the background?
+	FIELD_CPU,				// Share of the CPU samples (SAMPLE only)
+	FIELD_TIME,				// Time of day a HISTORY frame was taken
+	FIELD_MEM,				// Memory held by the task (MEM only)
+	FIELD_ALERT,			// Highest ALERT level raised (ALERT only)
+	FIELD_VERSION,			// Library, device or resource version & revision
+	FIELD_OPEN,				// Library or device open count
+	FIELD_MSGS,				// Messages queued at a port
+	FIELD_SIG_TASK,			// Task a port signals
+	FIELD_EVENT,			// Task added or removed (TRACE only)
+	FIELD_MSECS,			// Milliseconds since TRACE started
+	FIELD_QUEUE,			// Messages queued at a process's pr_MsgPort (QUEUE only)
+	FIELD_WAIT_PORT,		// Port a waiting task is blocked on (QUEUE only)
+	FIELD_WAIT_MSGS			// Messages queued at that port (QUEUE only)
+} Field;
+
+#define FIELD_LAST			FIELD_WAIT_MSGS
+#define FIELD_BIT(field)	(1UL << (field))
+
+// Column alignment
+#define ALIGN_LEFT			0
+#define ALIGN_RIGHT			1
+#define ALIGN_CENTER		2
+
+// Output formats a column is shown in
+#define IN_FULL				(1 << FORMAT_VERBOSE)
+#define IN_TCB				(1 << FORMAT_TCB)
+#define IN_SHORT			(1 << FORMAT_SHORT)
+#define IN_ALL				(IN_FULL | IN_TCB | IN_SHORT)
+
+// Options a column needs before it is shown
+#define NEED_SAMPLE			0x0100	// SAMPLE was given
+#define NEED_HIGHWATER		0x0200	// HIGHWATER was given
+#define NEED_MEM			0x0400	// MEM was given
+#define NEED_ALERT			0x0800	// ALERT was given
+#define NEED_QUEUE			0x1000	// QUEUE was given
+
+// Table column descriptor
+typedef struct Column {
+	Field			field;					// Field shown in this column
+	UBYTE			width;					// Column width in characters
+	UBYTE			align;					// ALIGN_* value
+	UBYTE			formats;				// IN_* flags of formats showing the column
+	const char*		top;					// First heading line
+	const char*		bot;					// Second heading line
+	UWORD			needs;					// NEED_* flags of options the column needs
+} Column;
+
+// Table of one exec list
+typedef struct ListTable {
+	const char*		heading;				// Section heading
+	const char*		key;					// CSV/JSON table name
+	ULONG			tag;					// BIN table tag
+	const Column*	columns;				// Table layout
+} ListTable;
+
+// Buffered console output, written with a single Write() when full
+typedef struct OutBuf {
+	ULONG			len;					// Number of bytes in the buffer
+	BOOL			lineFlush;				// Write out after every line
+	BOOL			eraseEol;				// Clear the rest of each line (WATCH mode)
+	ULONG			lines;					// Number of lines written since the screen was cleared
+	char			data[OUTBUF_SIZE];
+} OutBuf;
+
+// COMMAND pattern, tokenized once when the arguments are parsed
+typedef struct CmdPattern {
+	char			text[MAX_CMD_NAME_LEN + 1];	// Pattern as given, minus any trailing colon
+	char			parsed[CMD_PAT_SIZE];	// Tokenized by ParsePatternNoCase()
+	UWORD			length;					// Length of text
+	UWORD			prefixLen;				// Length of the literal text before the first wildcard
+	BOOL			wild;					// Pattern has wildcards (else it's a plain name)
+} CmdPattern;
+
+// Values an ALERT rule can test
+typedef enum AlertField {
+	ALERT_STACK,			// Stack in use, or the peak with HIGHWATER
+	ALERT_STACKPCT,			// Share of the stack in use, in tenths of a percent
+	ALERT_PRI,				// Priority
+	ALERT_MEM				// Memory held (turns MEM on)
+} AlertField;
+
+// ALERT rule. > and < are turned into >= and <= when it's parsed, so both
+// thresholds are inclusive.
+typedef struct AlertRule {
+	AlertField		field;					// Value tested
+	BOOL			above;					// Raised by values >= raise (else <= raise)
+	LONG			raise;					// Value that raises the alert
+	LONG			clear;					// Value a raised alert stays up to (WATCH)
+	UBYTE			level;					// RETURN_WARN, RETURN_ERROR or RETURN_FAIL
+} AlertRule;
+
+// Non-zero if Shell/CLI number num is one of the PROCESS numbers in picks
+#define PICKED(picks, num)	((picks)[(num) >> 3] & (1 << ((num) & 7)))
+
+// Settings from the command line
+typedef struct Options {
+	Mode			mode;					// Which tables to show
+	OutFrmt			format;					// How much detail to show
+	Encoding		encoding;				// How the tables are written out
+	BOOL			noHead;					// Leave out the table headings
+	int				start;					// Process number to start with
+	int				finish;					// Process number to finish with
+	UBYTE*			picks;					// PROCESS numbers, one bit each (NULL = all)
+	ULONG			pickCount;				// Number of PROCESS numbers
+	CmdPattern*		patterns;				// Patterns of the COMMAND argument
+	ULONG			patCount;				// Number of COMMAND patterns
+	BOOL			allMatches;				// Show every matching CLI, not just the first
+	ULONG			breakSigs;				// Signals of the BREAK argument (0 = none)
+	BOOL			setPri;					// Set the priority of the tasks found
+	BYTE			newPri;					// Priority of the PRI argument
+	BOOL			dryRun;					// Only show what PRI would change
+	SortKey			sort;					// Order the rows are shown in
+	ULONG			top;					// Show only the first n rows of each table (0 = all)
+	ULONG			queueMax;				// Most nodes walked in any message or port list
+	BOOL			timing;					// Report how long startup & Forbid() took
+	long			daemon;					// Seconds between DAEMON frames (0 = off)
+	BOOL			history;				// Dump the running daemon's frames
+	long			watch;					// Seconds between WATCH refreshes (0 = off)
+	long			sample;					// Milliseconds to sample CPU usage for (0 = off)
+	AlertRule*		alerts;					// Rules of the ALERT argument
+	ULONG			alertCount;				// Number of ALERT rules
+	ULONG			lists;					// 1 << LIST_* flags of the exec lists to show
+	const Column*	sysCols;				// Column plan of the system table
+	const Column*	cliCols;				// Column plan of the Shell/CLI table
+	const Column*	listCols[LIST_COUNT];	// Column plans of the exec list tables
+	Column*			plans;					// COLS plans of all the tables (NULL = not given)
+	Column*			wideCols;				// sysCols & cliCols widened for big CLI numbers (NULL = not)
+	ULONG			skip;					// FIELD_BIT()s of the fields no column shows
+	ULONG			tables;					// Number of tables shown
+	ULONG			tablesStarted;			// Tables started so far in the CSV/JSON/BIN output
+	ULONG			show;					// IN_* and NEED_* flags selecting the columns
+	const char*		saveFile;				// File of the SAVE argument (NULL = not given)
+	UBYTE*			loaded;					// Contents of the LOAD or DIFF file (NULL = none)
+	ULONG			loadedSize;				// Size of the LOAD or DIFF file
+	BOOL			diff;					// The loaded file is a DIFF baseline
+	BOOL			memMap;					// Show the free memory fragmentation
+	BOOL			trace;					// Show tasks as they're added & removed
+} Options;
+
+// Record flags of WATCH mode screen slots, which never reach a BinRec
+#define REC_FREE			0x100	// WATCH mode screen slot isn't showing a task
+#define REC_SEEN			0x200	// WATCH mode record has been matched to a screen slot,
+									// or free slot whose line still has to be blanked
+
+// Snapshot of a single task/process, copied out while holding Forbid() so it can
+// be formatted after Permit(). The task pointer is kept for identification only
+// and must never be dereferenced once the snapshot has been taken. Nodes of the
+// other exec lists are kept in the same records, flagged REC_NODE.
+typedef struct TaskRec {
+	struct Task*	task;					// Address of the task or node (identity only)
+	LONG			cliNum;					// Shell/CLI number (0 if not a CLI process)
+	LONG			stackUsed;				// tc_SPUpper - tc_SPReg
+	LONG			stackSize;				// tc_SPUpper - tc_SPLower
+	LONG			stackPeak;				// Deepest stack use found (HIGHWATER only)
+	LONG			defaultStack;			// Shell/CLI default stack size in bytes
+	LONG			globVec;				// Global vector size (CLI processes only)
+	LONG			failLevel;				// Failat level (CLI processes only)
+	LONG			returnCode;				// Last return code (CLI processes only)
+	LONG			mem;					// tc_MemEntry allocations plus the loaded command (MEM only)
+	BYTE			pri;					// Priority
+	UBYTE			type;					// NT_TASK or NT_PROCESS
+	UBYTE			state;					// TS_* state
+	UBYTE			event;					// TRACE_* event (TRACE only)
+	UWORD			flags;					// REC_* flags
+	UWORD			cpu;					// CPU usage in tenths of a percent (SAMPLE only)
+	UBYTE			alert;					// Highest ALERT level shown (0 = none)
+	UBYTE			action;					// mp_Flags & PF_ACTION (PORTS only)
+	UWORD			pad;
+	UWORD			version;				// lib_Version (LIBS, DEVS & RES only)
+	UWORD			revision;				// lib_Revision (LIBS, DEVS & RES only)
+	UWORD			openCount;				// lib_OpenCnt (LIBS & DEVS only)
+	UWORD			msgCount;				// Messages queued (PORTS only)
+	UWORD			queueCount;				// Messages queued at pr_MsgPort (QUEUE only)
+	UWORD			waitCount;				// Messages queued at the port waited on (QUEUE only)
+	ULONG			seq;					// Position in the walk, so sorting is stable
+	char			name[SNAP_NAME_SIZE];	// Task name, command name or node name
+	char			sigTask[SNAP_SIGTASK_SIZE];	// Name of the task a port signals (PORTS only)
+	char			waitPort[SNAP_WAITPORT_SIZE];	// Name of the port waited on (QUEUE only)
+} TaskRec;
+
+// CPU usage samples of a single task
+typedef struct SampleHit {
+	struct Task*	task;					// Task that was running (NULL = unused entry)
+	ULONG			hits;					// Number of samples it was running in
+} SampleHit;
+
+// One bank of samples. The sampling interrupt fills one bank while the other is
+// being read, so neither has to be locked.
+typedef struct SampleBank {
+	ULONG			samples;				// Number of samples taken
+	ULONG			idle;					// Samples taken while no task was running
+	ULONG			lost;					// Samples that didn't fit in the hit table
+	ULONG			handlerTicks;			// E-clock ticks spent in the interrupt
+	SampleHit		hits[SAMPLE_SLOTS];		// Hash table of running tasks
+} SampleBank;
+
+// Statistical CPU usage sampler. A timer.device request replies to a software
+// interrupt port, and the interrupt notes SysBase->ThisTask and resends it.
+typedef struct Sampler {
+	struct Interrupt	interrupt;			// Software interrupt run by the reply port
+	struct MsgPort		port;				// PA_SOFTINT reply port
+	struct timerequest	timer;				// Request that paces the samples
+	struct EClockVal	lastRead;			// When the samples were last read
+	struct ExecBase*	sysBase;			// exec base for the interrupt
+	struct Task*		owner;				// Task to signal once sampling has stopped
+	BYTE				doneSig;			// Signal bit for the owner
+	volatile UBYTE		active;				// Bank being filled by the interrupt
+	volatile BOOL		running;			// Interrupt keeps resending the request
+	volatile BOOL		done;				// Interrupt has stopped resending the request
+	SampleBank			banks[2];
+} Sampler;
+
+// Summary of the samples behind the CPU% column
+typedef struct SampleStats {
+	ULONG			samples;				// Number of samples taken
+	ULONG			idle;					// Idle time in tenths of a percent
+	ULONG			lost;					// Samples that couldn't be recorded
+	ULONG			overhead;				// Sampler's own CPU usage in tenths of a percent
+} SampleStats;
+
+// Free memory shown above the tables with MEM
+typedef struct MemStats {
+	ULONG			chip;					// Free chip memory
+	ULONG			chipLargest;			// Largest free chip memory block
+	ULONG			fast;					// Free fast memory
+	ULONG			fastLargest;			// Largest free fast memory block
+} MemStats;
+
+// Free memory of one MemHeader, counted by MEMMAP while holding Forbid(). Free
+// chunks are counted in size classes: class n holds chunks of 2^n to 2^(n+1)-1
+// bytes.
+typedef struct MemRegion {
+	char			name[MEMMAP_NAME_SIZE];	// Name of the MemHeader
+	UWORD			attributes;				// MEMF_* flags of the memory
+	ULONG			size;					// mh_Upper - mh_Lower
+	ULONG			free;					// Bytes in the free chunks
+	ULONG			chunks;					// Number of free chunks
+	ULONG			largest;				// Largest free chunk
+	ULONG			classCount[MEMMAP_CLASSES];	// Free chunks of each size class
+	ULONG			classBytes[MEMMAP_CLASSES];	// Bytes in them
+} MemRegion;
+
+// TRACE events
+#define TRACE_ADDED			0		// AddTask() was called
+#define TRACE_REMOVED		1		// RemTask() was called
+
+// exec vectors patched by TRACE
+typedef APTR (* __asm AddTaskFunc)(register __a1 struct Task* task, register __a2 APTR initPC,
+								   register __a3 APTR finalPC, register __a6 struct ExecBase* base);
+typedef void (* __asm RemTaskFunc)(register __a1 struct Task* task, register __a6 struct ExecBase* base);
+
+// One task lifecycle event, copied by the TRACE patches in the task that called
+// AddTask() or RemTask()
+typedef struct TraceEvent {
+	struct EClockVal time;					// When it happened
+	struct Task*	task;					// Task added or removed (identity only)
+	LONG			cliNum;					// Shell/CLI number (0 if not a CLI process)
+	BYTE			pri;					// Priority
+	UBYTE			type;					// NT_TASK or NT_PROCESS
+	UBYTE			event;					// TRACE_* event
+	char			name[TRACE_NAME_SIZE];	// Task name
+} TraceEvent;
+
+// Entry stub SetFunction() puts in front of a TRACE patch. Its 68000 code
+// counts the caller in before it touches anything of ShowProc's, then calls
+// the patch with the tracer in a0, or goes straight to the old vector once
+// the patches are out. The patch runs in other tasks & can't rely on a4, so
+// everything it needs comes through a0 & a6:
+//
+//		addq.l	#1,users			; 52B9 <users>
+//		tst.w	active				; 4A79 <active>
+//		beq.s	.old				; 6714
+//		movea.l	tracer,a0			; 2079 <tracer>
+//		jsr		patch				; 4EB9 <patch's code>
+//		subq.l	#1,users			; 53B9 <users>
+//		rts							; 4E75
+//	.old:
+//		subq.l	#1,users			; 53B9 <users>
+//		movea.l	old,a0				; 2079 <old>
+//		jmp		(a0)				; 4ED0
+#define TRACE_STUB_WORDS	24		// Words of code in a TraceStub
+
+typedef struct TraceStub {
+	UWORD			code[TRACE_STUB_WORDS];	// Built by BuildTraceStub()
+	APTR			patch;					// ShowProc's patch, called by the code
+	APTR			old;					// Vector the stub replaced
+} TraceStub;
+
+// The TRACE entry stubs & the count of tasks inside them. A task can be
+// switched away from between jumping through the vector & being counted, &
+// nothing tells when it has gone on, so the gate is never freed. ShowProc
+// can only go once the patches are out, the gate is shut & nobody's counted.
+typedef struct TraceGate {
+	volatile ULONG	users;					// Tasks inside either stub
+	volatile UWORD	active;					// FALSE once the patches are out
+	struct Tracer*	tracer;					// Passed to the patches in a0
+	TraceStub		addTask;
+	TraceStub		remTask;
+} TraceGate;
+
+// TRACE ring buffer. The patches are the only writers of head, one at a time
+// under Forbid(), and the reader is the only writer of tail, so neither side
+// takes a lock. Nothing is allocated once the patches are in.
+typedef struct Tracer {
+	TraceGate*		gate;					// Stubs the patches are called through
+	struct Device*	timerBase;				// timer.device base for the patches
+	volatile ULONG	head;					// Events written, ever
+	volatile ULONG	tail;					// Events read, ever
+	volatile ULONG	dropped;				// Events lost because the ring was full
+	ULONG			shown;					// Dropped events reported so far
+	ULONG			lastTick;				// E-clock time the clock was last moved to
+	ULONG			spareTicks;				// Ticks not yet counted as a millisecond
+	ULONG			msTicks;				// E-clock ticks per millisecond
+	ULONG			msecs;					// Milliseconds since TRACE started
+	TraceEvent		events[TRACE_EVENTS];
+} Tracer;
+
+// Self-instrumentation for TIMING. Times are in E-clock ticks. The output
+// counters are kept whether or not TIMING is given.
+typedef struct Timing {
+	struct timerequest	timer;				// UNIT_ECLOCK request, only used to open the device
+	BOOL			open;					// timer.device is open and the E-clock can be read
+	ULONG			checkTicks;				// CheckRequirements()
+	ULONG			argsTicks;				// ReadArgs() in ParseCommandLineArgs()
+	ULONG			forbids;				// Number of Forbid()/Permit() sections
+	ULONG			forbidTicks;			// Total time spent in them
+	ULONG			forbidMaxTicks;			// Longest one
+	ULONG			rows;					// Table rows written
+	ULONG			bytes;					// Bytes passed to Write()
+	ULONG			writes;					// Number of Write() calls
+} Timing;
+
+// All records captured by one snapshot. System tasks/processes are stored first,
+// followed by the Shell/CLI processes, then each exec list, all in a single
+// allocation. With TOP, each
+// table is kept as a heap of its best top records while walking, with the worst
+// at the root, plus one scratch record after it for the record being copied.
+typedef struct Snapshot {
+	TaskRec*		recs;					// Record arena
+	ULONG			capacity;				// Number of records the arena can hold
+	ULONG			needed;					// Number of records the last walk found
+	ULONG			sysCount;				// Number of system task/process records
+	ULONG			cliCount;				// Number of Shell/CLI process records
+	ULONG			listFirst[LIST_COUNT];	// First record of each exec list
+	ULONG			listCount[LIST_COUNT];	// Number of records of each exec list
+	ULONG			lists;					// Options->lists of the walk
+	ULONG			skip;					// Options->skip of the walk (0 = copy every field)
+	const UBYTE*	picks;					// Options->picks of the walk
+	ULONG			missing;				// PROCESS numbers that weren't found
+	const CmdPattern* patterns;				// Options->patterns of the walk
+	ULONG			patCount;				// Options->patCount of the walk
+	BOOL			allMatches;				// Options->allMatches of the walk
+	ULONG			breakSigs;				// Options->breakSigs of the walk
+	ULONG			broken;					// Processes the BREAK signals were sent to
+	BOOL			setPri;					// Options->setPri of the walk
+	BYTE			newPri;					// Options->newPri of the walk
+	BOOL			dryRun;					// Options->dryRun of the walk
+	ULONG			repri;					// Tasks PRI was applied to
+	ULONG			show;					// Options->show of the walk, for optional fields
+	SortKey			sort;					// Options->sort of the walk
+	ULONG			top;					// Options->top of the walk
+	ULONG			queueMax;				// Options->queueMax of the walk
+	ULONG			base;					// First record of the table being walked
+	ULONG			kept;					// Records kept so far in the table being walked
+	ULONG			walked;					// Records walked so far, for TaskRec->seq
+	SampleStats		cpu;					// Samples behind the CPU% column (SAMPLE only)
+	MemStats		mem;					// Free memory when the snapshot was taken (MEM only)
+	const AlertRule* alerts;				// Options->alerts of the walk
+	ULONG			alertCount;				// Options->alertCount of the walk
+	struct Task**	alerting;				// Tasks shown by the previous ALERT snapshot
+	ULONG			alertingCount;			// Number of them
+	UBYTE			alertLevel;				// Highest ALERT level raised (0 = none)
+} Snapshot;
+
+// DAEMON history frames. Each frame starts with a HFRAME_HEAD byte header:
+// length (UWORD), HFRAME_* flags (UBYTE), time in seconds since 1978 (ULONG)
+// and number of tasks (UWORD). The tasks follow in address order as HOP_* ops
+// against the previous frame. Key frames only use HOP_NEW, so they can be
+// decoded on their own. Numbers are big-endian, and the LONG fields of HOP_NEW
+// and HOP_CHANGE are zigzag-encoded 7 bits per byte, low bits first.
+#define HFRAME_HEAD			9		// Bytes in a frame header
+#define HFRAME_KEY			0x01	// Key frame
+#define HOP_COPY			0x00	// + n-1: next n tasks are unchanged
+#define HOP_SKIP			0x40	// + n-1: next n tasks of the previous frame have gone
+#define HOP_CHANGE			0x80	// + HCH_* flags: next task changed, the new fields follow
+#define HOP_NEW				0xA0	// New task: name hash (ULONG) & all fields follow
+#define HCH_PRI				0x01	// Priority (BYTE)
+#define HCH_STATE			0x02	// State (UBYTE, HSTATE_PROCESS set for processes)
+#define HCH_USED			0x04	// Stack used (LONG)
+#define HCH_SIZE			0x08	// Stack size (LONG)
+#define HCH_CLI				0x10	// Shell/CLI number (LONG)
+#define HCH_ALL				0x1F
+#define HSTATE_PROCESS		0x80	// State byte flag for NT_PROCESS
+
+// One task of a decoded history frame
+typedef struct HistEntry {
+	ULONG			hash;					// Hash of the task name
+	LONG			stackUsed;				// tc_SPUpper - tc_SPReg
+	LONG			stackSize;				// tc_SPUpper - tc_SPLower
+	LONG			cliNum;					// Shell/CLI number (0 if not a CLI process)
+	BYTE			pri;					// Priority
+	UBYTE			state;					// TS_* state, HSTATE_PROCESS set for processes
+} HistEntry;
+
+// Task name remembered by the daemon, so HISTORY can show names, not hashes
+typedef struct HistName {
+	ULONG			hash;					// Hash of the name (0 = unused)
+	char			name[HISTORY_NAME_SIZE];
+} HistName;
+
+// Frame being encoded by the daemon. Bytes past max are counted but not stored.
+typedef struct FrameBuf {
+	UBYTE*			data;
+	ULONG			len;					// Bytes encoded so far
+	ULONG			max;					// Size of data
+	UBYTE			runOp;					// HOP_COPY or HOP_SKIP run not written yet
+	ULONG			runCount;				// Tasks in that run
+	BOOL			needKey;				// Last frame was dropped, so the next must be a key frame
+} FrameBuf;
+
+// Public port the daemon keeps its history in, allocated once and followed by
+// the HISTORY_SIZE byte ring buffer. Frames are only changed or read under
+// Forbid(). The oldest frame is always a key frame. Names are written without
+// Forbid(), with the hash set last, so a half-written name is never matched.
+typedef struct HistoryPort {
+	struct MsgPort	port;					// Named HISTORY_PORT, mp_SigTask is the daemon
+	ULONG			size;					// HISTORY_SIZE of the daemon
+	ULONG			interval;				// Seconds between frames
+	ULONG			head;					// Ring offset of the oldest frame
+	ULONG			tail;					// Ring offset the next frame is written at
+	ULONG			used;					// Bytes of frames in the ring
+	ULONG			frames;					// Number of frames in the ring
+	ULONG			groupBytes;				// Bytes from the newest key frame on
+	ULONG			recorded;				// Frames taken since the daemon started
+	ULONG			dropped;				// Frames too big for the ring
+	HistName		names[HISTORY_NAMES];	// Hash table of task names
+} HistoryPort;
+
+// Snapshot API in ShowProc.c, which showproc.library's SP_TakeSnapshot() &
+// SP_FindCli() pass their arguments on to. Neither does any dos.library I/O.
+LONG 	TakeBinSnapshot(APTR buffer, ULONG size, ULONG flags);
+LONG 	FindCommandCli(const char** patterns);
+
+// Rows of one table as currently shown on screen in WATCH mode. Each task keeps
+// its slot (and so its line) for as long as it exists.
+typedef struct WatchTable {
+	const Column*	columns;				// Table layout
+	TaskRec*		slots;					// Record shown on each line
+	ULONG			count;					// Number of slots on screen
+	ULONG			capacity;				// Number of slots allocated
+	ULONG			firstLine;				// Screen line of the first slot
+	BOOL			cliNums;				// Number column shows CLI numbers, not slots
+} WatchTable;
+
 //--------------------------------------------------------------------------------
 // Command line template for ReadArgs
 //--------------------------------------------------------------------------------
 #define TEMPLATE		"VER=VERSION/S,ALL/S,CLI=SHELL/S,SYS=SYSTEM/S," \
 						"F=FULL/S,TCB/S,S=SHORT/S," \
-						"P=PROCESS/N,COM=COMMAND/K"
+						"P=PROCESS,COM=COMMAND/K/M,FLUSH/K,WATCH/N,SAMPLE/N,HW=HIGHWATER/S," \
+						"FORMAT/K,NOHEAD/S,ALLMATCHES/S,SORT/K,TOP/N,TIMING/S,DAEMON/N,HISTORY/S," \
+						"MEM/S,ALERT/K,LIBS/S,DEVS/S,PORTS/S,RES=RESOURCES/S,COLS/K,BREAK/K," \
+						"SAVE/K,LOAD/K,DIFF/K,MEMMAP/S,TRACE/S,QUEUE/N,PRI/N,NAME/K/M,DRYRUN/S"
 
 #define OPT_VERSION			0			// Show program version and exit
 #define OPT_ALL				1			// Show both system & Shell/CLI processes
@@ -34,21 +592,38 @@ typedef enum OutFrmt {
 #define OPT_FULL			4			// Show full info (default)
 #define OPT_TCB				5			// Same as FULL minus name
 #define OPT_SHORT			6			// Just number & name
-#define OPT_PROCESS			7			// Display specific process number only
-#define OPT_COMMAND			8			// Searches for a process by command name
-#define OPT_COUNT 			9
-
-//--------------------------------------------------------------------------------
-// Constants
-//--------------------------------------------------------------------------------
-#define KICKSTART_MIN_VER	37		// Min Kickstart version required (37 = 2.04)
-#define OS_MIN_VER			37		// Min AmigaOS version required (37 = 2.04)
-
-#define PROGRAM_PRIORITY	11		// High enough to reduce risk of changes while 
-									// reading tasks, but not too high to
-									// interfere with system operation
-#define MAX_CMD_NAME_LEN	102		// Max command name length
-
+#define OPT_PROCESS			7			// Display these process numbers & ranges only
+#define OPT_COMMAND			8			// Searches for processes by command names/patterns
+#define OPT_FLUSH			9			// When to write output (LINE or FULL)
+#define OPT_WATCH			10			// Refresh the display every n seconds
+#define OPT_SAMPLE			11			// Sample CPU usage for n milliseconds
+#define OPT_HIGHWATER		12			// Scan stacks for their high-water mark
+#define OPT_FORMAT			13			// Write the tables as CSV, JSON or BIN
+#define OPT_NOHEAD			14			// Leave out the table headings
+#define OPT_ALLMATCHES		15			// Show every CLI matching COMMAND
+#define OPT_SORT			16			// Order the rows by priority, stack, name or state
+#define OPT_TOP				17			// Show only the first n rows of each table
+#define OPT_TIMING			18			// Report startup, Forbid() & output costs
+#define OPT_DAEMON			19			// Record history frames every n seconds (0 = stop)
+#define OPT_HISTORY			20			// Dump the daemon's history frames
+#define OPT_MEM				21			// Show the memory each task holds & free memory
+#define OPT_ALERT			22			// Only show the rows breaking these rules
+#define OPT_LIBS			23			// Show the exec library list
+#define OPT_DEVS			24			// Show the exec device list
+#define OPT_PORTS			25			// Show the exec public port list
+#define OPT_RES				26			// Show the exec resource list
+#define OPT_COLS			27			// Show these columns, in this order
+#define OPT_BREAK			28			// Send break signals to the processes found
+#define OPT_SAVE			29			// Write the snapshot to a file instead of showing it
+#define OPT_LOAD			30			// Show a snapshot written by SAVE
+#define OPT_DIFF			31			// Compare the tasks with a snapshot written by SAVE
+#define OPT_MEMMAP			32			// Show how fragmented the free memory is
+#define OPT_TRACE			33			// Show tasks as they're added & removed
+#define OPT_QUEUE			34			// Show message queue depths, counting up to n
+#define OPT_PRI				35			// Set the priority of the tasks found
+#define OPT_NAME			36			// Finds system tasks by names/patterns for PRI
+#define OPT_DRYRUN			37			// Show what PRI would change without changing it
+#define OPT_COUNT 			38
 
 //--------------------------------------------------------------------------------
 // String constants
@@ -59,10 +634,35 @@ typedef enum OutFrmt {
 // #define STR_TASK_HEADING	Bold "System Tasks & Processes\n========================" BoldEnd
 #define STR_CLI_HEADING		"Shell/CLI Processes\n==================="
 #define STR_SYS_HEADING		"System Tasks & Processes\n========================"
+#define STR_LIBS_HEADING	"Libraries\n========="
+#define STR_DEVS_HEADING	"Devices\n======="
+#define STR_PORTS_HEADING	"Message Ports\n============="
+#define STR_RES_HEADING		"Resources\n========="
+#define STR_MEMMAP_HEADING	"Free Memory\n==========="
+#define STR_PORT_SOFTINT	"(soft interrupt)"
+#define STR_PORT_IGNORE		"(ignored)"
+#define STR_WAIT_OWN_PORT	"(process port)"
 #define STR_NO				"No"
 #define STR_YES				"Yes"
 #define STR_NO_COMMAND 		"No command loaded"
 #define STR_NO_PROCESS		"No such process"
+#define STR_FLUSH_LINE		"LINE"
+#define STR_FLUSH_FULL		"FULL"
+#define STR_FORMAT_CSV		"CSV"
+#define STR_FORMAT_JSON		"JSON"
+#define STR_FORMAT_BIN		"BIN"
+#define STR_SORT_PRI		"PRI"
+#define STR_SORT_STACK		"STACK"
+#define STR_SORT_STACKPCT	"STACKPCT"
+#define STR_SORT_NAME		"NAME"
+#define STR_SORT_STATE		"STATE"
+#define STR_SORT_MEM		"MEM"
+#define STR_SORT_CPU		"CPU"
+#define STR_ALERT_WARN		"WARN"
+#define STR_ALERT_ERROR		"ERROR"
+#define STR_ALERT_FAIL		"FAIL"
+#define STR_BREAK_ALL		"ALL"
+#define STR_BREAK_KEYS		"CDEF"
 
 // State names
 #define STR_STATE_INVALID	"Invld"
@@ -79,80 +679,210 @@ typedef enum OutFrmt {
 #define STR_ERR_GET_CMD			"Error getting command name"
 #define STR_ERR_GET_OWN_PROC	"Error getting own process info"
 #define STR_ERR_INV_CMD_NAME	"Invalid command name"
-#define STR_ERR_INV_POINTER		"Invalid pointer"
-#define STR_INV_PROC_NUM		"Process number must be between 1 and 999"
+#define STR_INV_PROC_NUM		"Process number must be between 1 and 99999"
+#define STR_INV_PROC_LIST		"PROCESS must be numbers or ranges separated by commas, e.g. 2,5-8"
 #define STR_INV_TASK_FMT		"Invalid task output format"
 #define STR_INV_TASK_LIST		"Invalid task list"
 #define STR_INV_TASK_TYPE		"Invalid task type"
 #define STR_KS_TOO_OLD			"This program requires Kickstart 2.04 or higher"
 #define STR_OS_TOO_OLD			"This program requires AmigaOS 2.04 or higher"
 #define STR_INV_CMD_PAT			"Invalid command pattern"
+#define STR_INV_FLUSH			"FLUSH must be LINE or FULL"
+#define STR_INV_WATCH			"WATCH interval must be between 1 and 3600 seconds"
+#define STR_WATCH_COMMAND		"WATCH can't be used with COMMAND"
+#define STR_ERR_OPEN_TIMER		"Error opening timer.device"
+#define STR_INV_SAMPLE			"SAMPLE window must be between 10 and 3600000 milliseconds"
+#define STR_SAMPLE_COMMAND		"SAMPLE can't be used with COMMAND"
+#define STR_INV_FORMAT			"FORMAT must be CSV, JSON or BIN"
+#define STR_WATCH_FORMAT		"WATCH can't be used with FORMAT"
+#define STR_INV_SORT			"SORT must be PRI, STACK, STACKPCT, NAME, STATE, MEM or CPU"
+#define STR_SORT_CPU_SAMPLE		"SORT=CPU can only be used with SAMPLE or LOAD"
+#define STR_INV_TOP				"TOP must be at least 1"
+#define STR_INV_QUEUE			"QUEUE limit must be between 1 and 9999"
+#define STR_INV_PRI				"PRI must be between -128 and 127"
+#define STR_PRI_OPTS			"PRI needs one of COMMAND, PROCESS or NAME, and can only be used with ALLMATCHES, DRYRUN, NOHEAD, TIMING and FLUSH"
+#define STR_NAME_PRI			"NAME and DRYRUN can only be used with PRI"
+#define STR_TIMING_FORMAT		"TIMING can't be used with FORMAT CSV or BIN"
+#define STR_SAVE_OPTS			"SAVE can't be used with LOAD, DIFF, WATCH, COMMAND, DAEMON, HISTORY, BREAK, FORMAT or COLS"
+#define STR_LOAD_OPTS			"LOAD and DIFF take the tables from the file, and can't be used with each other, ALL, CLI, SYS, PROCESS, LIBS, DEVS, PORTS, RES, WATCH, SAMPLE, COMMAND, DAEMON, HISTORY, ALERT or BREAK"
+#define STR_MEMMAP_OPTS			"MEMMAP can only be used with NOHEAD, TIMING and FLUSH"
+#define STR_TRACE_OPTS			"TRACE can only be used with ALL, CLI, SYS, FULL, TCB, SHORT, FORMAT, NOHEAD, TIMING and FLUSH"
+#define STR_TRACE_FORMAT		"TRACE can only be written as text or CSV"
+#define STR_TRACE_PATCHED		"Another program has patched AddTask() or RemTask() too, waiting for it to go"
+#define STR_DIFF_FORMAT			"DIFF can't be used with FORMAT or COLS"
+#define STR_INV_SNAP_FILE		"isn't a snapshot file written by SAVE, or was written by another version"
+#define STR_ERR_OPEN_ECLOCK		"Error opening the E-clock for TIMING"
+#define STR_INV_DAEMON			"DAEMON interval must be between 0 and 86400 seconds"
+#define STR_DAEMON_OPTS			"DAEMON can't be used with WATCH, SAMPLE, COMMAND or HISTORY"
+#define STR_HISTORY_OPTS		"HISTORY can't be used with WATCH, SAMPLE or COMMAND"
+#define STR_HISTORY_FORMAT		"HISTORY can only be written as text or CSV"
+#define STR_INV_ALERT			"ALERT rules must be STACK, STACKPCT, PRI or MEM, then >, >=, <, <= or =, a number and optionally :WARN, :ERROR or :FAIL"
+#define STR_ALERT_OPTS			"ALERT can't be used with COMMAND, DAEMON or HISTORY"
+#define STR_INV_COLS			"COLS must be column names separated by commas, e.g. NUM,NAME,PRI,STACK_USED"
+#define STR_COLS_OPTS			"COLS can't be used with COMMAND, DAEMON, HISTORY or FORMAT BIN"
+#define STR_INV_BREAK			"BREAK must be C, D, E, F, a combination of them such as CE, or ALL"
+#define STR_BREAK_OPTS			"BREAK needs COMMAND or PROCESS and can't be used with WATCH, DAEMON or HISTORY"
+#define STR_LISTS_OPTS			"LIBS, DEVS, PORTS and RES can't be used with WATCH, COMMAND, DAEMON, HISTORY or ALERT"
+#define STR_DAEMON_RUNNING		"The ShowProc daemon is already running"
+#define STR_NO_DAEMON			"The ShowProc daemon isn't running"
+#define STR_ERR_HISTORY			"History frames are damaged"
+#define STR_HISTORY_FRAMES		"frames"
+#define STR_HISTORY_BYTES		"bytes"
+#define STR_HISTORY_EVERY		"every"
+#define STR_HISTORY_SECONDS		"seconds"
+#define STR_HISTORY_DROPPED		"dropped"
+#define STR_SAMPLE_SUMMARY		"CPU samples:"
+#define STR_SAMPLE_IDLE			"idle"
+#define STR_SAMPLE_LOST			"lost"
+#define STR_SAMPLE_OVERHEAD		"sampler overhead"
+#define STR_MEM_SUMMARY			"Free memory:"
+#define STR_PROC_SUMMARY		"Processes found:"
+#define STR_PROC_OF				"of"
+#define STR_BREAK_SUMMARY		"Break sent to:"
+#define STR_PRI_SUMMARY			"Priorities set:"
+#define STR_PRI_DRYRUN			"Priorities that would be set (DRYRUN):"
+#define STR_MEMMAP_SIZE			"size"
+#define STR_MEMMAP_FREE			"free"
+#define STR_MEMMAP_IN			"in"
+#define STR_MEMMAP_CHUNKS		"chunks"
+#define STR_MEMMAP_FRAG			"fragmentation"
+#define STR_MEMMAP_OTHER		"other"
+#define STR_MEMMAP_HEAD_TOP		"       Free Chunk Size   Chunks       Bytes"
+#define STR_MEMMAP_HEAD_LINE	" --------------------- -------- -----------"
+#define STR_TRACE_SUMMARY		"Events traced:"
+#define STR_TRACE_DROPPED		"dropped"
+#define STR_TRACE_LOST			"events dropped, the ring buffer was full"
+#define STR_EVENT_ADDED			"Added"
+#define STR_EVENT_REMOVED		"Removed"
+#define STR_DIFF_SUMMARY		"Differences:"
+#define STR_DIFF_ADDED			"added"
+#define STR_DIFF_REMOVED		"removed"
+#define STR_DIFF_CHANGED		"changed"
+#define STR_DIFF_PRI			"pri"
+#define STR_DIFF_STATE			"state"
+#define STR_DIFF_STACK			"stack used"
+#define STR_DIFF_STACK_SIZE		"stack size"
+#define STR_DIFF_TO				"->"
+#define STR_MEM_CHIP			"chip"
+#define STR_MEM_FAST			"fast"
+#define STR_MEM_LARGEST			"largest"
+#define STR_TIMING_STARTUP		"Startup:"
+#define STR_TIMING_CHECK		"CheckRequirements()"
+#define STR_TIMING_ARGS			"ReadArgs()"
+#define STR_TIMING_FORBID		"Forbid():"
+#define STR_TIMING_SECTIONS		"sections"
+#define STR_TIMING_TOTAL		"total"
+#define STR_TIMING_LONGEST		"longest"
+#define STR_TIMING_OUTPUT		"Output:"
+#define STR_TIMING_ROWS			"rows"
+#define STR_TIMING_BYTES		"bytes"
+#define STR_TIMING_WRITES		"Write() calls"
+#define STR_TIMING_US			"us"
 
 //--------------------------------------------------------------------------------
-// CLI table headings
+// Table headings (two lines per column, the divider is generated from the width)
 //--------------------------------------------------------------------------------
-#define NUM_TOP				""
-#define NUM_BOT				"Num"
-#define NUM_DIV				"---"
-
-#define NAME_TOP			""
-#define CLI_NAME   			"Command Name"
-#define NAME_DIV      		"---------------------------------"
-
-#define CLI_INFO_TOP		"           Stack  Stack Fail"
-#define CLI_INFO_BOT		" Pri   GV   Used   Size  Lvl  RC   BG"
-#define CLI_INFO_DIV		"---- ---- ------ ------ ---- --- ----"
-
-// CLI heading format strings
-#define CLI_VERBOSE			" %3s %-33s %-37s\n"
-#define CLI_TCB				" %3s %-38s\n"
-#define CLI_SHORT			" %3s %-33s\n"
+#define HEAD_NONE			""
+#define HEAD_NUM			"Num"
+#define HEAD_CLI_NAME		"Command Name"
+#define HEAD_SYS_NAME		"Task/Process Name"
+#define HEAD_PRI			"Pri"
+#define HEAD_TYPE			"T/P"
+#define HEAD_CLI			"CLI"
+#define HEAD_STATE			"State"
+#define HEAD_STACK			"Stack"
+#define HEAD_USED			"Used"
+#define HEAD_SIZE			"Size"
+#define HEAD_PEAK			"Peak"
+#define HEAD_REC			"Rec"
+#define HEAD_GV				"GV"
+#define HEAD_FAIL			"Fail"
+#define HEAD_LVL			"Lvl"
+#define HEAD_RC				"RC"
+#define HEAD_BG				"BG"
+#define HEAD_CPU			"CPU%"
+#define HEAD_TIME			"Time"
+#define HEAD_MEM			"Mem"
+#define HEAD_ALERT			"Alert"
+#define HEAD_NODE_NAME		"Name"
+#define HEAD_VERSION		"Version"
+#define HEAD_OPEN			"Open"
+#define HEAD_MSGS			"Msgs"
+#define HEAD_SIGNAL			"Signal"
+#define HEAD_TASK			"Task"
+#define HEAD_EVENT			"Event"
+#define HEAD_MSECS			"ms"
+#define HEAD_QUEUE			"Queue"
+#define HEAD_WAIT			"Wait"
+#define HEAD_PORT			"Port"
 
 //--------------------------------------------------------------------------------
-// System tasks/processes headings
+// Field names of the CSV header and JSON records
 //--------------------------------------------------------------------------------
+#define KEY_CLI_TABLE		"cli"
+#define KEY_SYS_TABLE		"system"
+#define KEY_LIBS_TABLE		"libraries"
+#define KEY_DEVS_TABLE		"devices"
+#define KEY_PORTS_TABLE		"ports"
+#define KEY_RES_TABLE		"resources"
+#define KEY_TRACE_TABLE		"trace"
+#define KEY_SAMPLE			"sample"
+#define KEY_TIMING			"timing"
+#define KEY_NUM				"num"
+#define KEY_NAME			"name"
+#define KEY_COMMAND			"command"
+#define KEY_PRI				"pri"
+#define KEY_TYPE			"type"
+#define KEY_CLI				"cli"
+#define KEY_STATE			"state"
+#define KEY_STACK_USED		"stack_used"
+#define KEY_STACK_SIZE		"stack_size"
+#define KEY_STACK_PEAK		"stack_peak"
+#define KEY_STACK_REC		"stack_rec"
+#define KEY_GLOBVEC			"globvec"
+#define KEY_FAILAT			"failat"
+#define KEY_RC				"rc"
+#define KEY_BG				"bg"
+#define KEY_CPU				"cpu"
+#define KEY_TIME			"time"
+#define KEY_MEM				"mem"
+#define KEY_ALERT			"alert"
+#define KEY_VERSION			"version"
+#define KEY_OPEN			"open"
+#define KEY_MSGS			"msgs"
+#define KEY_SIG_TASK		"sig_task"
+#define KEY_EVENT			"event"
+#define KEY_MSECS			"ms"
+#define KEY_QUEUE			"queue"
+#define KEY_WAIT_PORT		"wait_port"
+#define KEY_WAIT_MSGS		"wait_msgs"
+#define KEY_MEMORY			"memory"
+#define KEY_CHIP			"chip"
+#define KEY_CHIP_LARGEST	"chip_largest"
+#define KEY_FAST			"fast"
+#define KEY_FAST_LARGEST	"fast_largest"
+#define KEY_ERROR			"error"
+#define KEY_SAMPLES			"samples"
+#define KEY_IDLE			"idle"
+#define KEY_LOST			"lost"
+#define KEY_OVERHEAD		"overhead"
+#define KEY_CHECK_US		"check_us"
+#define KEY_READARGS_US		"readargs_us"
+#define KEY_FORBIDS			"forbids"
+#define KEY_FORBID_US		"forbid_us"
+#define KEY_FORBID_MAX_US	"forbid_max_us"
+#define KEY_ROWS			"rows"
+#define KEY_BYTES			"bytes"
+#define KEY_WRITES			"writes"
 
-// NUM NAME PRI USED SIZE STATE 
-#define SYS_NAME  			"Task/Process Name"
-
-#define SYS_INFO_TOP		"         CLI        Stack  Stack"
-#define SYS_INFO_BOT		" Pri T/P Num State   Used   Size"
-#define SYS_INFO_DIV		"---- --- --- ----- ------ ------"
-
-// Task heading format strings
-#define SYS_VERBOSE			" %3s %-33s %-29s\n"
-#define SYS_TCB				" %3s %-29s\n"
-#define SYS_SHORT			" %3s %-33s\n"
+#define STR_TYPE_TASK		"T"
+#define STR_TYPE_PROCESS	"P"
 
 //--------------------------------------------------------------------------------
-// Output formats
+// Console control sequences (WATCH mode)
 //--------------------------------------------------------------------------------
-// Verbose
-#define CLI_VERBOSE_TOP	    NUM_TOP, NAME_TOP, CLI_INFO_TOP
-#define CLI_VERBOSE_BOT		NUM_BOT, CLI_NAME, CLI_INFO_BOT
-#define CLI_VERBOSE_DIV		NUM_DIV, NAME_DIV, CLI_INFO_DIV
-
-#define SYS_VERBOSE_TOP		NUM_TOP, NAME_TOP, SYS_INFO_TOP
-#define SYS_VERBOSE_BOT		NUM_BOT, SYS_NAME, SYS_INFO_BOT
-#define SYS_VERBOSE_DIV		NUM_DIV, NAME_DIV, SYS_INFO_DIV
-
-// TCB
-#define CLI_TCB_TOP			NUM_TOP, CLI_INFO_TOP
-#define CLI_TCB_BOT			NUM_BOT, CLI_INFO_BOT
-#define CLI_TCB_DIV			NUM_DIV, CLI_INFO_DIV
-
-#define SYS_TCB_TOP			NUM_TOP, SYS_INFO_TOP
-#define SYS_TCB_BOT			NUM_BOT, SYS_INFO_BOT
-#define SYS_TCB_DIV			NUM_DIV, SYS_INFO_DIV
-
-// Short
-#define CLI_SHORT_TOP		NUM_TOP, NAME_TOP
-#define CLI_SHORT_BOT		NUM_BOT, CLI_NAME
-#define CLI_SHORT_DIV		NUM_DIV, NAME_DIV
-
-#define SYS_SHORT_TOP		NUM_TOP, NAME_TOP
-#define SYS_SHORT_BOT		NUM_BOT, SYS_NAME
-#define SYS_SHORT_DIV		NUM_DIV, NAME_DIV
-
+#define CSI					"\033["
+#define ESC_CLEAR_SCREEN	CSI "H" CSI "J"
+#define ESC_ERASE_EOL		CSI "K"
 
 #endif // SHOWPROC_H
@@ -0,0 +1,60 @@
+//--------------------------------------------------------------------------------
+//	showproc.library - ShowProc's snapshot API as a shared library
+//
+//	Copyright (C) 2025 Matthew Sawyer
+//
+//	Linked with ShowProc.c, SAS/C's libent.o & libinitr.o (see smakefile), so
+//	every opener gets its own copy of ShowProc.c's data and one program's
+//	calls can't upset another's. The entry points are named with LIBPREFIX
+//	_LIB & laid out by fd/showproc_lib.fd.
+//--------------------------------------------------------------------------------
+#include <proto/dos.h>
+#include <proto/exec.h>
+#include <proto/timer.h>
+#include <devices/timer.h>
+#include <libraries/showproc.h>
+
+#include "ShowProc.h"
+
+// There's no startup code to open dos.library for ShowProc.c
+struct DosLibrary* DOSBase = NULL;
+
+
+//--------------------------------------------------------------------------------
+//	Called by libinitr.o each time the library is opened. Returns 0 if the
+//	opener can go ahead.
+//--------------------------------------------------------------------------------
+int __asm __saveds __UserLibInit(register __a6 struct Library* libBase)
+{
+	DOSBase = (struct DosLibrary*)OpenLibrary("dos.library", OS_MIN_VER);
+
+	return DOSBase == NULL;
+}
+
+
+//--------------------------------------------------------------------------------
+//	Called by libinitr.o each time the library is closed.
+//--------------------------------------------------------------------------------
+void __asm __saveds __UserLibCleanup(register __a6 struct Library* libBase)
+{
+	CloseLibrary((struct Library*)DOSBase);
+}
+
+
+//--------------------------------------------------------------------------------
+//	SP_TakeSnapshot(buffer, size, flags)(a0,d0,d1), see TakeBinSnapshot().
+//--------------------------------------------------------------------------------
+LONG __asm __saveds LIBSP_TakeSnapshot(register __a0 APTR buffer, register __d0 ULONG size,
+									   register __d1 ULONG flags)
+{
+	return TakeBinSnapshot(buffer, size, flags);
+}
+
+
+//--------------------------------------------------------------------------------
+//	SP_FindCli(patterns)(a0), see FindCommandCli().
+//--------------------------------------------------------------------------------
+LONG __asm __saveds LIBSP_FindCli(register __a0 const char** patterns)
+{
+	return FindCommandCli(patterns);
+}
@@ -0,0 +1,12 @@
+#ifndef CLIB_SHOWPROC_PROTOS_H
+#define CLIB_SHOWPROC_PROTOS_H
+
+//--------------------------------------------------------------------------------
+//	showproc.library function prototypes
+//--------------------------------------------------------------------------------
+#include <libraries/showproc.h>
+
+LONG 	SP_TakeSnapshot(APTR buffer, ULONG size, ULONG flags);
+LONG 	SP_FindCli(const char** patterns);
+
+#endif /* CLIB_SHOWPROC_PROTOS_H */
@@ -0,0 +1,97 @@
+#ifndef LIBRARIES_SHOWPROC_H
+#define LIBRARIES_SHOWPROC_H
+
+//--------------------------------------------------------------------------------
+//	showproc.library - Task snapshots for programs that would otherwise run
+//	ShowProc & parse its output. The records are those of FORMAT=BIN & SAVE.
+//
+//	Copyright (C) 2025 Matthew Sawyer
+//--------------------------------------------------------------------------------
+#include <exec/types.h>
+
+#define SHOWPROC_NAME		"showproc.library"
+#define SHOWPROC_VERSION	37		// First version with SP_TakeSnapshot() & SP_FindCli()
+
+#define BIN_NAME_SIZE		104		// Name field size in a BIN record
+#define BIN_SIGTASK_SIZE	32		// Port signal task name field size in a BIN record
+#define BIN_WAITPORT_SIZE	32		// Waited-on port name field size in a BIN record
+
+// Record flags (TaskRec->flags & BinRec->flags)
+#define REC_BACKGROUND		0x01	// Shell/CLI process is running in the background
+#define REC_NO_COMMAND		0x02	// Shell/CLI process has no command loaded
+#define REC_NO_CLI			0x04	// Process claims a CLI number but has no CLI struct
+#define REC_MISSING			0x08	// Requested Shell/CLI process number doesn't exist
+#define REC_NODE			0x10	// exec list node, not a task
+#define REC_BROKEN			0x20	// BREAK signals were sent to the process
+#define REC_REPRI			0x40	// PRI was applied to the task
+
+// Start of the BIN output. All BIN values are big-endian, as on the 68k.
+typedef struct BinHeader {
+	ULONG			magic;					// BIN_MAGIC
+	UWORD			version;				// BIN_VERSION
+	UWORD			recSize;				// sizeof(BinRec)
+	ULONG			show;					// Options->show (NEED_* tells which fields are set)
+} BinHeader;
+
+// Start of each table in the BIN output, followed by count BinRecs
+typedef struct BinTable {
+	ULONG			tag;					// BIN_TAG_CLI or BIN_TAG_SYS
+	ULONG			count;					// Number of records in the table
+} BinTable;
+
+// Record of the BIN output. Fields are only ever added at the end, and
+// BIN_VERSION is bumped whenever the layout changes.
+typedef struct BinRec {
+	ULONG			task;					// Address of the task (identity only)
+	LONG			num;					// Row number (system) or Shell/CLI number (CLI)
+	LONG			cliNum;					// Shell/CLI number (0 if not a CLI process)
+	LONG			stackUsed;				// tc_SPUpper - tc_SPReg
+	LONG			stackSize;				// tc_SPUpper - tc_SPLower
+	LONG			stackPeak;				// Deepest stack use found (HIGHWATER only)
+	LONG			defaultStack;			// Shell/CLI default stack size in bytes
+	LONG			globVec;				// Global vector size (CLI processes only)
+	LONG			failLevel;				// Failat level (CLI processes only)
+	LONG			returnCode;				// Last return code (CLI processes only)
+	UWORD			cpu;					// CPU usage in tenths of a percent (SAMPLE only)
+	BYTE			pri;					// Priority
+	UBYTE			type;					// NT_TASK or NT_PROCESS
+	UBYTE			state;					// TS_* state
+	UBYTE			flags;					// REC_* flags
+	UBYTE			pad[2];
+	char			name[BIN_NAME_SIZE];	// Task or command name, NUL-terminated
+	LONG			mem;					// Memory held by the task (MEM only)
+	UWORD			version;				// lib_Version (LIBS, DEVS & RES only)
+	UWORD			revision;				// lib_Revision (LIBS, DEVS & RES only)
+	UWORD			openCount;				// lib_OpenCnt (LIBS & DEVS only)
+	UWORD			msgCount;				// Messages queued (PORTS only)
+	UBYTE			action;					// mp_Flags & PF_ACTION (PORTS only)
+	UBYTE			pad2[3];
+	char			sigTask[BIN_SIGTASK_SIZE];	// Task a port signals, NUL-terminated
+	UWORD			queueCount;				// Messages queued at pr_MsgPort (QUEUE only)
+	UWORD			waitCount;				// Messages queued at the port waited on (QUEUE only)
+	char			waitPort[BIN_WAITPORT_SIZE];	// Port waited on, NUL-terminated (QUEUE only)
+} BinRec;
+
+#define BIN_MAGIC			0x53505243	// 'SPRC'
+#define BIN_VERSION			5
+#define BIN_TAG_CLI			0x434C4920	// 'CLI '
+#define BIN_TAG_SYS			0x53595320	// 'SYS '
+#define BIN_TAG_LIBS		0x4C494253	// 'LIBS'
+#define BIN_TAG_DEVS		0x44455653	// 'DEVS'
+#define BIN_TAG_PORTS		0x504F5254	// 'PORT'
+#define BIN_TAG_RES			0x52455320	// 'RES '
+
+// SP_TakeSnapshot() flags. The buffer is filled with the tables in the BIN
+// layout, minus the BinHeader: each table is a BinTable followed by its
+// BinRecs, Shell/CLI table first, then the system one and the exec lists.
+#define SP_SYSTEM			0x01	// System task/process table
+#define SP_CLI				0x02	// Shell/CLI process table
+#define SP_HIGHWATER		0x04	// Fill in BinRec->stackPeak
+#define SP_MEM				0x08	// Fill in BinRec->mem
+#define SP_LIBS				0x10	// Library table
+#define SP_DEVS				0x20	// Device table
+#define SP_PORTS			0x40	// Message port table
+#define SP_RES				0x80	// Resource table
+#define SP_QUEUE			0x100	// Fill in BinRec->queueCount, waitCount & waitPort
+
+#endif /* LIBRARIES_SHOWPROC_H */
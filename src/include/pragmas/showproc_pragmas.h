@@ -0,0 +1,10 @@
+#ifndef PRAGMAS_SHOWPROC_PRAGMAS_H
+#define PRAGMAS_SHOWPROC_PRAGMAS_H
+
+//--------------------------------------------------------------------------------
+//	showproc.library SAS/C pragmas, from fd/showproc_lib.fd
+//--------------------------------------------------------------------------------
+#pragma libcall ShowProcBase SP_TakeSnapshot 1e 10803
+#pragma libcall ShowProcBase SP_FindCli 24 801
+
+#endif /* PRAGMAS_SHOWPROC_PRAGMAS_H */
@@ -0,0 +1,13 @@
+#ifndef PROTO_SHOWPROC_H
+#define PROTO_SHOWPROC_H
+
+//--------------------------------------------------------------------------------
+//	showproc.library calls through ShowProcBase
+//--------------------------------------------------------------------------------
+#include <clib/showproc_protos.h>
+
+extern struct Library*	ShowProcBase;
+
+#include <pragmas/showproc_pragmas.h>
+
+#endif /* PROTO_SHOWPROC_H */